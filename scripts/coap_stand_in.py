@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+#
+
+"""Local stand-in for the CoAP cloud, plain UDP without DTLS.
+
+Prints every request, acknowledges confirmable messages, answers pings and
+keeps observations. Lines typed on stdin are sent as notifications to the
+observers of a path:
+
+    <path> <json payload>
+
+for example
+
+    352656100000000/ack {"ack":{"gps":[[0,10]]}}
+
+Resources observed before a notification has been sent are answered with the
+content given with --state, keyed by path.
+"""
+
+import argparse
+import asyncio
+import json
+import random
+import struct
+import sys
+
+TYPE_CON, TYPE_NON, TYPE_ACK, TYPE_RST = range(4)
+CODE_EMPTY = 0x00
+CODE_GET = 0x01
+CODE_CHANGED = 0x44
+CODE_CONTENT = 0x45
+OPTION_OBSERVE = 6
+OPTION_URI_PATH = 11
+OPTION_CONTENT_FORMAT = 12
+CONTENT_FORMAT_JSON = 50
+
+
+def option_field(value):
+    if value < 13:
+        return value, b''
+    if value < 269:
+        return 13, bytes([value - 13])
+    return 14, struct.pack('!H', value - 269)
+
+
+def uint_encode(value):
+    return value.to_bytes((value.bit_length() + 7) // 8, 'big')
+
+
+def message_encode(msg_type, code, msg_id, token=b'', options=(),
+                   payload=b''):
+    out = bytearray([0x40 | (msg_type << 4) | len(token), code])
+    out += struct.pack('!H', msg_id) + token
+    last = 0
+    for number, value in sorted(options, key=lambda o: o[0]):
+        delta, delta_ext = option_field(number - last)
+        length, length_ext = option_field(len(value))
+        out += bytes([(delta << 4) | length]) + delta_ext + length_ext
+        out += value
+        last = number
+    if payload:
+        out += b'\xff' + payload
+    return bytes(out)
+
+
+def message_decode(data):
+    if len(data) < 4 or data[0] >> 6 != 1:
+        raise ValueError('not a CoAP message')
+    msg_type = (data[0] >> 4) & 0x3
+    token_len = data[0] & 0xF
+    code = data[1]
+    msg_id = struct.unpack('!H', data[2:4])[0]
+    token = data[4:4 + token_len]
+    pos = 4 + token_len
+    number = 0
+    options = []
+    payload = b''
+    while pos < len(data):
+        if data[pos] == 0xFF:
+            payload = data[pos + 1:]
+            break
+        delta, length = data[pos] >> 4, data[pos] & 0xF
+        pos += 1
+        fields = []
+        for field in (delta, length):
+            if field == 13:
+                field = data[pos] + 13
+                pos += 1
+            elif field == 14:
+                field = struct.unpack('!H', data[pos:pos + 2])[0] + 269
+                pos += 2
+            fields.append(field)
+        number += fields[0]
+        options.append((number, data[pos:pos + fields[1]]))
+        pos += fields[1]
+    return msg_type, code, msg_id, token, options, payload
+
+
+class StandIn(asyncio.DatagramProtocol):
+    def __init__(self, state):
+        self.state = state
+        self.observers = {}
+        self.observe_seq = 2
+        self.msg_id = random.randrange(0x10000)
+        self.transport = None
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def next_id(self):
+        self.msg_id = (self.msg_id + 1) & 0xFFFF
+        return self.msg_id
+
+    def datagram_received(self, data, addr):
+        try:
+            msg_type, code, msg_id, token, options, payload = \
+                message_decode(data)
+        except (ValueError, IndexError, struct.error) as err:
+            print('{}: dropped, {}'.format(addr, err))
+            return
+
+        if code == CODE_EMPTY:
+            if msg_type == TYPE_CON:
+                print('{}: ping'.format(addr))
+                self.transport.sendto(message_encode(TYPE_RST, CODE_EMPTY,
+                                                     msg_id), addr)
+            return
+
+        path = '/'.join(v.decode() for n, v in options
+                        if n == OPTION_URI_PATH)
+        observe = [v for n, v in options if n == OPTION_OBSERVE]
+        print('{}: {} {} {} {}'.format(
+            addr, 'CON' if msg_type == TYPE_CON else 'NON',
+            'GET' if code == CODE_GET else 'POST', path,
+            payload.decode(errors='replace')))
+
+        if code == CODE_GET:
+            if observe and int.from_bytes(observe[0], 'big') == 0:
+                self.observers.setdefault(path, {})[token] = addr
+            self.respond(addr, msg_type, msg_id, token, CODE_CONTENT,
+                         self.state.get(path, ''), observe=bool(observe))
+        else:
+            self.respond(addr, msg_type, msg_id, token, CODE_CHANGED)
+
+    def respond(self, addr, msg_type, msg_id, token, code, content='',
+                observe=False):
+        options = []
+        if observe:
+            options.append((OPTION_OBSERVE, uint_encode(self.observe_seq)))
+        if content:
+            options.append((OPTION_CONTENT_FORMAT,
+                            uint_encode(CONTENT_FORMAT_JSON)))
+        if msg_type == TYPE_CON:
+            reply_type, reply_id = TYPE_ACK, msg_id
+        else:
+            reply_type, reply_id = TYPE_NON, self.next_id()
+        self.transport.sendto(message_encode(reply_type, code, reply_id,
+                                             token, options,
+                                             content.encode()), addr)
+
+    def notify(self, path, content):
+        self.state[path] = content
+        self.observe_seq += 1
+        observers = self.observers.get(path, {})
+        for token, addr in observers.items():
+            self.transport.sendto(message_encode(
+                TYPE_CON, CODE_CONTENT, self.next_id(), token,
+                [(OPTION_OBSERVE, uint_encode(self.observe_seq)),
+                 (OPTION_CONTENT_FORMAT, uint_encode(CONTENT_FORMAT_JSON))],
+                content.encode()), addr)
+        print('Notified {} observers of {}'.format(len(observers), path))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--port', type=int, default=5683)
+    parser.add_argument('--state', help='JSON file, {path: content}')
+    args = parser.parse_args()
+
+    state = {}
+    if args.state:
+        with open(args.state) as f:
+            state = {k: json.dumps(v) for k, v in json.load(f).items()}
+
+    loop = asyncio.get_event_loop()
+    _, stand_in = loop.run_until_complete(loop.create_datagram_endpoint(
+        lambda: StandIn(state), local_addr=('0.0.0.0', args.port)))
+
+    def stdin_line():
+        line = sys.stdin.readline()
+        if not line:
+            loop.remove_reader(sys.stdin)
+            return
+        path, _, content = line.strip().partition(' ')
+        if not path:
+            return
+        stand_in.notify(path, content)
+
+    loop.add_reader(sys.stdin, stdin_line)
+    print('Listening on UDP port {}'.format(args.port))
+    loop.run_forever()
+
+
+if __name__ == '__main__':
+    main()
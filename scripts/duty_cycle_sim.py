@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+#
+
+"""Energy and data volume of a configuration, from an offline simulation.
+
+Builds the application for native_posix with overlay-duty-cycle.conf, runs
+it for the given number of days in virtual time and evaluates the last
+SIM:REPORT line of the run with an energy model of the network type:
+
+    scripts/duty_cycle_sim.py --cfg '{"act":false,"mvres":3600}' \\
+        --accel-trace my_walk.txt --network nbiot --days 7
+
+The main loop, sampling, buffering and publication logic are the ones of the
+firmware, driven by the GPS, accelerometer and environment traces. The
+currents of the model are typical nRF9160 figures at 3.7 V, not
+measurements, so compare configurations with it rather than trusting the
+absolute battery life. Calibrate them for a board with --model, a JSON file
+with the keys of MODELS to override.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+APP_DIR = os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
+REPORT_PREFIX = 'SIM:REPORT '
+# Uptime and state times are summed in milliseconds in 32 bits.
+DAYS_MAX = 45
+
+# Currents in mA, charges in mAs, sizes in bytes. The RRC connected current
+# is the average over a connection including connected mode DRX, the
+# transmission of the on-air bytes at tx_ma comes on top of it.
+MODELS = {
+    'ltem': {
+        'connected_ma': 20.0,
+        'idle_ma': 0.6,
+        'psm_ma': 0.0045,
+        'gps_ma': 40.0,
+        'base_ma': 0.01,
+        'connection_mas': 40.0,
+        'tx_ma': 120.0,
+        'uplink_kbps': 300.0,
+        'rrc_inactivity_sec': 10,
+        'msg_overhead': 120,
+        'ping_bytes': 60,
+        'handshake_bytes': 5000,
+    },
+    'nbiot': {
+        'connected_ma': 25.0,
+        'idle_ma': 0.5,
+        'psm_ma': 0.0045,
+        'gps_ma': 40.0,
+        'base_ma': 0.01,
+        'connection_mas': 80.0,
+        'tx_ma': 150.0,
+        'uplink_kbps': 25.0,
+        'rrc_inactivity_sec': 20,
+        'msg_overhead': 120,
+        'ping_bytes': 60,
+        'handshake_bytes': 5000,
+    },
+}
+
+
+def kconfig_str(value):
+    return '"{}"'.format(value.replace('\\', '\\\\').replace('"', '\\"'))
+
+
+def overlay_write(path, args, model):
+    lines = [
+        'CONFIG_SIMULATION_CLOUD_CFG=' + kconfig_str(args.cfg),
+        'CONFIG_SIMULATION_RRC_INACTIVITY_SEC={}'.format(
+            model['rrc_inactivity_sec']),
+    ]
+    for name, trace in (('GPS', args.gps_trace), ('ACCEL', args.accel_trace),
+                        ('ENV', args.env_trace)):
+        if trace:
+            lines.append('CONFIG_SIMULATION_{}_TRACE={}'.format(
+                name, kconfig_str(os.path.abspath(trace))))
+
+    with open(path, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+def build(build_dir, overlay):
+    overlays = '{};{}'.format(
+        os.path.join(APP_DIR, 'overlay-duty-cycle.conf'), overlay)
+    subprocess.run(['west', 'build', '-b', 'native_posix', '-d', build_dir,
+                    APP_DIR, '--', '-DOVERLAY_CONFIG=' + overlays],
+                   check=True)
+
+
+def run(build_dir, seconds):
+    exe = os.path.join(build_dir, 'zephyr', 'zephyr.exe')
+    out = subprocess.run([exe, '-stop_at={}'.format(seconds)],
+                         stdout=subprocess.PIPE, universal_newlines=True,
+                         check=True).stdout
+
+    reports = [line[line.index(REPORT_PREFIX) + len(REPORT_PREFIX):]
+               for line in out.splitlines() if REPORT_PREFIX in line]
+    if not reports:
+        sys.exit('No report in the output, run for at least '
+                 'CONFIG_SIMULATION_REPORT_INTERVAL_SEC')
+
+    return json.loads(reports[-1])
+
+
+def report_check(report):
+    # Each broker connection and message needs an RRC connection, a report
+    # without them would leave the connection setup charge out silently.
+    if report['connections'] == 0 and (report['connects'] > 0 or
+                                       report['txMsgs'] > 0):
+        sys.exit('The report counts {} broker connections and {} messages '
+                 'but no RRC connections, rebuild the firmware'.format(
+                     report['connects'], report['txMsgs']))
+    if report['connections'] < report['connects']:
+        print('Warning: fewer RRC connections ({}) than broker connections '
+              '({}) in the report'.format(report['connections'],
+                                          report['connects']),
+              file=sys.stderr)
+
+
+def evaluate(report, model, battery_mah):
+    uptime = report['uptime']
+    day = 86400.0 / uptime
+
+    on_air = (report['txBytes'] + report['rxBytes'] +
+              (report['txMsgs'] + report['rxMsgs']) * model['msg_overhead'] +
+              report['pings'] * model['ping_bytes'] +
+              report['connects'] * model['handshake_bytes'])
+    tx_time = on_air * 8 / (model['uplink_kbps'] * 1000)
+
+    charge = {
+        'connected': report['connected'] * model['connected_ma'],
+        'idle': report['idle'] * model['idle_ma'],
+        'psm': report['psm'] * model['psm_ma'],
+        'gps': report['gps'] * model['gps_ma'],
+        'connections': report['connections'] * model['connection_mas'],
+        'transmission': tx_time * model['tx_ma'],
+        'base': uptime * model['base_ma'],
+    }
+    avg_ma = sum(charge.values()) / uptime
+
+    return {
+        'days': uptime / 86400.0,
+        'connectedSecPerDay': report['connected'] * day,
+        'idleSecPerDay': report['idle'] * day,
+        'psmSecPerDay': report['psm'] * day,
+        'gpsSecPerDay': report['gps'] * day,
+        'connectionsPerDay': report['connections'] * day,
+        'messagesPerDay': report['txMsgs'] * day,
+        'payloadBytesPerDay': (report['txBytes'] + report['rxBytes']) * day,
+        'onAirBytesPerDay': on_air * day,
+        'averageMa': avg_ma,
+        'averageMaShare': {k: v / uptime for k, v in charge.items()},
+        'batteryDays': battery_mah / avg_ma / 24,
+    }
+
+
+def result_print(result, network):
+    print('Simulated {:.1f} days on {}'.format(result['days'], network))
+    print('Per day:')
+    print('  RRC connected  {:10.0f} s'.format(result['connectedSecPerDay']))
+    print('  RRC idle       {:10.0f} s'.format(result['idleSecPerDay']))
+    print('  PSM            {:10.0f} s'.format(result['psmSecPerDay']))
+    print('  GPS on         {:10.0f} s'.format(result['gpsSecPerDay']))
+    print('  Connections    {:10.1f}'.format(result['connectionsPerDay']))
+    print('  Messages       {:10.1f}'.format(result['messagesPerDay']))
+    print('  Payload        {:10.0f} bytes'.format(
+        result['payloadBytesPerDay']))
+    print('  On air, est.   {:10.0f} bytes'.format(
+        result['onAirBytesPerDay']))
+    print('Average current {:.3f} mA:'.format(result['averageMa']))
+    for name, ma in result['averageMaShare'].items():
+        print('  {:14} {:10.3f} mA'.format(name, ma))
+    print('Battery life {:.0f} days'.format(result['batteryDays']))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--cfg', default='{}',
+                        help='device configuration, the JSON "cfg" object '
+                        'of the shadow')
+    parser.add_argument('--gps-trace', help='NMEA trace')
+    parser.add_argument('--accel-trace', help='accelerometer trace')
+    parser.add_argument('--env-trace', help='temperature and humidity trace')
+    parser.add_argument('--network', choices=sorted(MODELS), default='ltem')
+    parser.add_argument('--model', help='JSON file overriding model values')
+    parser.add_argument('--days', type=float, default=7)
+    parser.add_argument('--battery-mah', type=float, default=1350,
+                        help='usable capacity, 1350 mAh on the Thingy:91')
+    parser.add_argument('--build-dir',
+                        default=os.path.join(APP_DIR, 'build_duty_cycle'))
+    parser.add_argument('--no-build', action='store_true',
+                        help='run the existing build')
+    parser.add_argument('--json', action='store_true',
+                        help='print the result as JSON')
+    args = parser.parse_args()
+
+    try:
+        json.loads(args.cfg)
+    except ValueError as e:
+        sys.exit('Invalid --cfg: {}'.format(e))
+
+    if not 0 < args.days <= DAYS_MAX:
+        sys.exit('--days must be within 0 and {}'.format(DAYS_MAX))
+
+    model = dict(MODELS[args.network])
+    if args.model:
+        with open(args.model) as f:
+            model.update(json.load(f))
+
+    build_dir = os.path.abspath(args.build_dir)
+    if not args.no_build:
+        os.makedirs(build_dir, exist_ok=True)
+        overlay = os.path.join(build_dir, 'duty_cycle_run.conf')
+        overlay_write(overlay, args, model)
+        build(build_dir, overlay)
+
+    report = run(build_dir, int(args.days * 86400))
+    report_check(report)
+    result = evaluate(report, model, args.battery_mah)
+
+    if args.json:
+        print(json.dumps(result, indent=2))
+    else:
+        result_print(result, args.network)
+
+
+if __name__ == '__main__':
+    main()
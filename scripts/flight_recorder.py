@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+#
+
+"""Decode a flight recorder dump into a timeline.
+
+Reads a console log, from a file or stdin, and decodes the lines the firmware
+prints with the "flight" shell command or before rebooting on an error:
+
+    FR:BEGIN <version> <cycles per second> <count>
+    FR:<record, hex>
+    FR:END
+
+Event names and arguments are read from flight_recorder_events.h, so the
+script decodes dumps of any build with the same event list. Times are in
+seconds since the oldest record in the dump.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+DUMP_VERSION = 1
+RECORD = struct.Struct('<IHHiii')
+EVENTS_DEFAULT = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                              '..', 'src', 'flight_recorder',
+                              'flight_recorder_events.h')
+EVENT_RE = re.compile(r'^FLIGHT_RECORDER_EVENT\((\w+),\s*(\w+),\s*(\w+),'
+                      r'\s*(\w+)\)', re.MULTILINE)
+LINE_RE = re.compile(r'FR:(\S+)(?: (\d+) (\d+) (\d+))?')
+
+
+def events_load(path):
+    with open(path) as f:
+        return [(m.group(1), m.groups()[1:])
+                for m in EVENT_RE.finditer(f.read())]
+
+
+def dumps_parse(lines):
+    """Yield (cycles per second, records) for each complete dump."""
+    records = None
+    hz = 0
+    for line in lines:
+        m = LINE_RE.search(line)
+        if not m:
+            continue
+        if m.group(1) == 'BEGIN':
+            if int(m.group(2)) != DUMP_VERSION:
+                sys.exit('Unsupported dump version {}'.format(m.group(2)))
+            hz = int(m.group(3))
+            records = []
+        elif m.group(1) == 'END':
+            if records is not None:
+                yield hz, records
+            records = None
+        elif records is not None:
+            try:
+                records.append(RECORD.unpack(bytes.fromhex(m.group(1))))
+            except (ValueError, struct.error):
+                print('Skipping malformed record: {}'.format(m.group(1)),
+                      file=sys.stderr)
+
+
+def timeline_print(hz, records, events):
+    if not records:
+        print('Empty dump')
+        return
+
+    # Records overwritten while the dump was printed are newer than the
+    # ones around them and break the sequence.
+    first_seq = records[0][2]
+    ts_base = records[0][0]
+    ts_prev = ts_base
+    elapsed = 0
+    dropped = 0
+
+    for i, (ts, event_id, seq, *args) in enumerate(records):
+        if seq != (first_seq + i) & 0xffff:
+            dropped += 1
+            continue
+
+        # The cycle counter wraps, the records are in order.
+        elapsed += (ts - ts_prev) & 0xffffffff
+        ts_prev = ts
+
+        if event_id < len(events):
+            name, arg_names = events[event_id]
+        else:
+            name, arg_names = 'UNKNOWN_{}'.format(event_id), ('?',) * 3
+
+        fields = ' '.join('{}={}'.format(arg_name, value)
+                          for arg_name, value in zip(arg_names, args)
+                          if arg_name != '_')
+        print('{:12.6f}  {:<12} {}'.format(elapsed / hz, name,
+                                           fields).rstrip())
+
+    if dropped:
+        print('{} records overwritten during the dump'.format(dropped))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('log', nargs='?', help='console log, default stdin')
+    parser.add_argument('--events', default=EVENTS_DEFAULT,
+                        help='flight_recorder_events.h of the build')
+    args = parser.parse_args()
+
+    events = events_load(args.events)
+
+    log = open(args.log, errors='replace') if args.log else sys.stdin
+    with log:
+        for n, (hz, records) in enumerate(dumps_parse(log)):
+            if n > 0:
+                print()
+            print('Dump {}, {} records'.format(n + 1, len(records)))
+            timeline_print(hz, records, events)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+#
+
+"""Local stand-in for the AWS IoT broker, for the native_posix build.
+
+Creates a CA, a broker certificate and a client certificate with openssl,
+unless they exist, and runs mosquitto with mutual TLS on them. The client
+credentials are written where the native_posix build picks them up, so
+generate them before building:
+
+    scripts/mqtt_stand_in.py
+    west build -b native_posix
+
+The broker only relays messages, it keeps no device shadow. A-GPS requests
+on <IMEI>/agps/get are answered on <IMEI>/agps with canned assistance data:
+ionospheric corrections, UTC parameters, the current GPS time and a coarse
+location, --agps-location, in the binary format of
+GPS_CONTROL_AGPS_FORMAT_VERSION. --agps-file serves a file in that format
+instead, for example one with ephemerides. Watch the messages of the device
+with
+
+    mosquitto_sub -h 192.0.2.2 -p 8883 --cafile certs/ca.crt \\
+        --cert certs/client.crt --key certs/client.key -v -t '#'
+
+and send it a configuration, as a shadow delta would, with mosquitto_pub on
+$aws/things/<IMEI>/shadow/update/delta and a payload like
+{"state":{"cfg":{"act":true,"actwt":60}}}.
+"""
+
+import argparse
+import os
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+APP_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+IMEI_DEFAULT = '352656100000000'
+BROKER_ADDR = '192.0.2.2'
+DAYS = 3650
+
+AGPS_REQUEST_SUFFIX = '/agps/get'
+AGPS_FORMAT_VERSION = 1
+# enum gps_agps_type
+AGPS_UTC_PARAMETERS = 1
+AGPS_KLOBUCHAR_CORRECTION = 4
+AGPS_GPS_SYSTEM_CLOCK_AND_TOWS = 6
+AGPS_LOCATION = 7
+# Broadcast values, good enough for a first fix.
+KLOBUCHAR = (0x0b, 0x00, 0xfa, 0x00, 0x4a, 0x00, 0xfd, 0x00)
+GPS_EPOCH_UNIX_SEC = 315964800
+GPS_UTC_LEAP_SEC = 18
+SEC_PER_DAY = 86400
+
+
+def openssl(*args, cwd):
+    subprocess.run(['openssl'] + list(args), cwd=cwd, check=True,
+                   stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+
+def cert_create(name, subject, cwd, ext=None):
+    openssl('ecparam', '-name', 'prime256v1', '-genkey', '-noout',
+            '-out', name + '.key', cwd=cwd)
+    openssl('req', '-new', '-key', name + '.key', '-subj', subject,
+            '-out', name + '.csr', cwd=cwd)
+    args = ['x509', '-req', '-in', name + '.csr', '-CA', 'ca.crt',
+            '-CAkey', 'ca.key', '-CAcreateserial', '-days', str(DAYS),
+            '-out', name + '.crt']
+    if ext:
+        with open(os.path.join(cwd, name + '.ext'), 'w') as f:
+            f.write(ext)
+        args += ['-extfile', name + '.ext']
+    openssl(*args, cwd=cwd)
+
+
+def certs_create(certs_dir, imei):
+    os.makedirs(certs_dir, exist_ok=True)
+    openssl('ecparam', '-name', 'prime256v1', '-genkey', '-noout',
+            '-out', 'ca.key', cwd=certs_dir)
+    openssl('req', '-x509', '-new', '-key', 'ca.key', '-days', str(DAYS),
+            '-subj', '/CN=Cat Tracker simulation CA', '-out', 'ca.crt',
+            cwd=certs_dir)
+    cert_create('broker', '/CN=' + BROKER_ADDR, certs_dir,
+                'subjectAltName=IP:{}\n'.format(BROKER_ADDR))
+    cert_create('client', '/CN=' + imei, certs_dir)
+
+
+def mosquitto_conf_write(certs_dir, port):
+    path = os.path.join(certs_dir, 'mosquitto.conf')
+    with open(path, 'w') as f:
+        f.write('listener {}\n'.format(port))
+        for key, name in (('cafile', 'ca.crt'), ('certfile', 'broker.crt'),
+                          ('keyfile', 'broker.key')):
+            f.write('{} {}\n'.format(key, os.path.join(certs_dir, name)))
+        f.write('require_certificate true\n')
+        f.write('use_identity_as_username true\n')
+    return path
+
+
+def agps_record(agps_type, data):
+    return struct.pack('<BH', agps_type, len(data)) + data
+
+
+def agps_canned(lat, lng):
+    """Assistance data in the layouts of nrf_gnss_agps_data_*_t."""
+    gps_sec = int(time.time()) - GPS_EPOCH_UNIX_SEC + GPS_UTC_LEAP_SEC
+    week = gps_sec // (7 * SEC_PER_DAY)
+
+    utc = struct.pack('<iiBBbBbbxx', 0, 0, 0, week % 256, GPS_UTC_LEAP_SEC,
+                      week % 256, 0, GPS_UTC_LEAP_SEC)
+    clock = struct.pack('<H2xIH2xI', gps_sec // SEC_PER_DAY,
+                        gps_sec % SEC_PER_DAY, 0, 0) + bytes(4 * 32)
+    # Latitude is N = 2^23 * lat / 90 and longitude N = 2^24 * lng / 360,
+    # with an uncertainty of about 50 km.
+    location = struct.pack('<iihBBBBBx', int(lat * (1 << 23) / 90),
+                           int(lng * (1 << 24) / 360), 0, 70, 70, 0, 127, 68)
+
+    return (bytes([AGPS_FORMAT_VERSION]) +
+            agps_record(AGPS_KLOBUCHAR_CORRECTION, bytes(KLOBUCHAR)) +
+            agps_record(AGPS_UTC_PARAMETERS, utc) +
+            agps_record(AGPS_GPS_SYSTEM_CLOCK_AND_TOWS, clock) +
+            agps_record(AGPS_LOCATION, location))
+
+
+def broker_wait(port, proc):
+    while proc.poll() is None:
+        try:
+            socket.create_connection(('127.0.0.1', port), timeout=1).close()
+            return
+        except OSError:
+            time.sleep(0.2)
+    sys.exit('mosquitto exited')
+
+
+def mosquitto_client(tool, certs_dir, port):
+    # The broker certificate is issued for BROKER_ADDR, --insecure only
+    # skips the host name check for the local connection.
+    return [tool, '-h', '127.0.0.1', '-p', str(port), '--insecure',
+            '--cafile', os.path.join(certs_dir, 'ca.crt'),
+            '--cert', os.path.join(certs_dir, 'client.crt'),
+            '--key', os.path.join(certs_dir, 'client.key')]
+
+
+def agps_serve(args, certs_dir):
+    """Answers A-GPS requests until the subscription ends."""
+    sub = subprocess.Popen(
+        mosquitto_client('mosquitto_sub', certs_dir, args.port) +
+        ['-v', '-t', '+' + AGPS_REQUEST_SUFFIX],
+        stdout=subprocess.PIPE, universal_newlines=True)
+
+    with tempfile.NamedTemporaryFile(suffix='.agps') as payload:
+        for line in sub.stdout:
+            topic = line.split(' ', 1)[0]
+            client_id = topic[:-len(AGPS_REQUEST_SUFFIX)]
+
+            if args.agps_file:
+                with open(args.agps_file, 'rb') as f:
+                    data = f.read()
+            else:
+                data = agps_canned(*args.agps_location)
+
+            payload.seek(0)
+            payload.truncate()
+            payload.write(data)
+            payload.flush()
+
+            subprocess.run(mosquitto_client('mosquitto_pub', certs_dir,
+                                            args.port) +
+                           ['-t', client_id + '/agps', '-f', payload.name],
+                           check=True)
+            print('A-GPS data, {} bytes, sent to {}'.format(len(data),
+                                                            client_id))
+
+
+def location_parse(value):
+    try:
+        lat, lng = (float(v) for v in value.split(','))
+    except ValueError:
+        raise argparse.ArgumentTypeError('expected LAT,LNG')
+    return lat, lng
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--port', type=int, default=8883)
+    parser.add_argument('--certs-dir', default=os.path.join(APP_DIR, 'certs'),
+                        help='CONFIG_SIMULATION_CERTS_DIR of the build')
+    parser.add_argument('--imei', default=IMEI_DEFAULT,
+                        help='CONFIG_SIMULATION_IMEI of the build')
+    parser.add_argument('--regenerate', action='store_true',
+                        help='create new certificates, rebuild afterwards')
+    parser.add_argument('--agps-location', type=location_parse,
+                        default=(63.42, 10.44), metavar='LAT,LNG',
+                        help='coarse location of the canned A-GPS data')
+    parser.add_argument('--agps-file',
+                        help='A-GPS data to serve instead of the canned set')
+    args = parser.parse_args()
+
+    certs_dir = os.path.abspath(args.certs_dir)
+    if args.regenerate or not os.path.exists(
+            os.path.join(certs_dir, 'client.key')):
+        certs_create(certs_dir, args.imei)
+        print('Credentials written to {}'.format(certs_dir))
+
+    conf = mosquitto_conf_write(certs_dir, args.port)
+    print('Broker on port {}, client ID {}'.format(args.port, args.imei))
+    try:
+        broker = subprocess.Popen(['mosquitto', '-v', '-c', conf])
+    except FileNotFoundError:
+        sys.exit('mosquitto not found')
+
+    try:
+        broker_wait(args.port, broker)
+        agps_serve(args, certs_dir)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        broker.terminate()
+        broker.wait()
+
+
+if __name__ == '__main__':
+    main()
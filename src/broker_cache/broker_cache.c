@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* The cloud backend resolves the broker and sets up TLS inside
+ * cloud_connect(), so the calls are wrapped at link time, see
+ * CMakeLists.txt. A lookup of CONFIG_BROKER_CACHE_HOST_NAME is answered from
+ * the cache while it is valid, all other lookups pass through. The first
+ * socket that the same thread gives security tags after that lookup is the
+ * broker socket, only it is asked to cache its TLS session.
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <net/socket.h>
+#include <settings/settings.h>
+#include <date_time.h>
+
+#include "broker_cache.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(broker_cache, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+#define BROKER_CACHE_SETTINGS_KEY "broker"
+#define BROKER_CACHE_ADDR_KEY "addr"
+
+struct broker_addr {
+	/** IPv4 address, network byte order. */
+	u32_t addr;
+	/** End of validity. UNIX milliseconds. */
+	s64_t expiry;
+};
+
+int __real_zsock_getaddrinfo(const char *host, const char *service,
+			     const struct zsock_addrinfo *hints,
+			     struct zsock_addrinfo **res);
+void __real_zsock_freeaddrinfo(struct zsock_addrinfo *ai);
+
+static struct broker_addr cache;
+static bool hit;
+K_MUTEX_DEFINE(cache_lock);
+
+#if defined(CONFIG_BROKER_CACHE_TLS_SESSION)
+/* Thread that looked up the broker and has not set up its socket yet. */
+static k_tid_t broker_thread;
+#endif
+
+/* Handed out as the lookup result on a hit, never freed. */
+static struct zsock_addrinfo cached_res;
+static struct sockaddr_in cached_sa;
+
+static int settings_set(const char *key, size_t len_rd,
+			settings_read_cb read_cb, void *cb_arg)
+{
+	ssize_t len;
+
+	if (strcmp(key, BROKER_CACHE_ADDR_KEY) != 0) {
+		return -ENOENT;
+	}
+
+	if (len_rd != sizeof(cache)) {
+		LOG_WRN("Cached broker address has unexpected size, ignoring");
+		return 0;
+	}
+
+	len = read_cb(cb_arg, &cache, sizeof(cache));
+	if (len != sizeof(cache)) {
+		LOG_ERR("Failed to read broker address, error: %d", (int)len);
+		memset(&cache, 0, sizeof(cache));
+	}
+
+	return 0;
+}
+
+static struct settings_handler settings_conf = {
+	.name = BROKER_CACHE_SETTINGS_KEY,
+	.h_set = settings_set,
+};
+
+static bool cache_valid(void)
+{
+	s64_t now;
+
+	return cache.addr != 0 && date_time_now(&now) == 0 &&
+	       now < cache.expiry;
+}
+
+static void cache_store(const struct sockaddr_in *addr)
+{
+	int err;
+	s64_t now;
+
+	/* Without the time the expiry cannot be set, nor checked later. */
+	if (date_time_now(&now)) {
+		return;
+	}
+
+	cache.addr = addr->sin_addr.s_addr;
+	cache.expiry = now + (s64_t)CONFIG_BROKER_CACHE_TTL_SEC * MSEC_PER_SEC;
+
+	err = settings_save_one(BROKER_CACHE_SETTINGS_KEY "/"
+				BROKER_CACHE_ADDR_KEY,
+				&cache, sizeof(cache));
+	if (err) {
+		LOG_ERR("Failed to store broker address, error: %d", err);
+	}
+}
+
+static bool broker_lookup(const char *host, const char *service,
+			  const struct zsock_addrinfo *hints)
+{
+	/* The backends set the port themselves. */
+	return host != NULL && service == NULL &&
+	       strcmp(host, CONFIG_BROKER_CACHE_HOST_NAME) == 0 &&
+	       (hints == NULL || hints->ai_family == AF_INET ||
+		hints->ai_family == AF_UNSPEC);
+}
+
+/* Marks the next socket the calling thread sets up as the broker socket,
+ * or, for another host, as not the broker socket.
+ */
+static void broker_socket_expect(bool broker)
+{
+#if defined(CONFIG_BROKER_CACHE_TLS_SESSION)
+	k_mutex_lock(&cache_lock, K_FOREVER);
+
+	if (broker) {
+		broker_thread = k_current_get();
+	} else if (broker_thread == k_current_get()) {
+		broker_thread = NULL;
+	}
+
+	k_mutex_unlock(&cache_lock);
+#endif
+}
+
+int __wrap_zsock_getaddrinfo(const char *host, const char *service,
+			     const struct zsock_addrinfo *hints,
+			     struct zsock_addrinfo **res)
+{
+	int err;
+
+	if (!broker_lookup(host, service, hints)) {
+		broker_socket_expect(false);
+		return __real_zsock_getaddrinfo(host, service, hints, res);
+	}
+
+	broker_socket_expect(true);
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+
+	hit = cache_valid();
+	if (hit) {
+		memset(&cached_sa, 0, sizeof(cached_sa));
+		cached_sa.sin_family = AF_INET;
+		cached_sa.sin_addr.s_addr = cache.addr;
+
+		memset(&cached_res, 0, sizeof(cached_res));
+		cached_res.ai_family = AF_INET;
+		cached_res.ai_socktype = hints ? hints->ai_socktype : 0;
+		cached_res.ai_protocol = hints ? hints->ai_protocol : 0;
+		cached_res.ai_addr = (struct sockaddr *)&cached_sa;
+		cached_res.ai_addrlen = sizeof(cached_sa);
+		*res = &cached_res;
+
+		k_mutex_unlock(&cache_lock);
+		LOG_DBG("Broker address from cache");
+
+		return 0;
+	}
+
+	k_mutex_unlock(&cache_lock);
+
+	err = __real_zsock_getaddrinfo(host, service, hints, res);
+	if (err == 0 && (*res)->ai_family == AF_INET) {
+		k_mutex_lock(&cache_lock, K_FOREVER);
+		cache_store((struct sockaddr_in *)(*res)->ai_addr);
+		k_mutex_unlock(&cache_lock);
+	}
+
+	return err;
+}
+
+void __wrap_zsock_freeaddrinfo(struct zsock_addrinfo *ai)
+{
+	if (ai != &cached_res) {
+		__real_zsock_freeaddrinfo(ai);
+	}
+}
+
+#if defined(CONFIG_BROKER_CACHE_TLS_SESSION)
+int __real_z_impl_zsock_setsockopt(int sock, int level, int optname,
+				   const void *optval, socklen_t optlen);
+
+/* Security tags are set on every TLS socket before its handshake. Returns
+ * true for the broker socket, once.
+ */
+static bool broker_socket_claim(int level, int optname)
+{
+	bool broker;
+
+	if (level != SOL_TLS || optname != TLS_SEC_TAG_LIST) {
+		return false;
+	}
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+
+	broker = broker_thread != NULL && broker_thread == k_current_get();
+	if (broker) {
+		broker_thread = NULL;
+	}
+
+	k_mutex_unlock(&cache_lock);
+
+	return broker;
+}
+
+int __wrap_z_impl_zsock_setsockopt(int sock, int level, int optname,
+				   const void *optval, socklen_t optlen)
+{
+	int err = __real_z_impl_zsock_setsockopt(sock, level, optname, optval,
+						 optlen);
+
+#if defined(TLS_SESSION_CACHE)
+	int session_cache = TLS_SESSION_CACHE_ENABLED;
+
+	if (err == 0 && broker_socket_claim(level, optname) &&
+	    __real_z_impl_zsock_setsockopt(sock, SOL_TLS, TLS_SESSION_CACHE,
+					   &session_cache,
+					   sizeof(session_cache))) {
+		LOG_WRN("TLS session cache not enabled, error: %d", errno);
+	}
+#endif
+
+	return err;
+}
+#endif
+
+int broker_cache_init(void)
+{
+	int err;
+
+#if defined(CONFIG_BROKER_CACHE_TLS_SESSION) && !defined(TLS_SESSION_CACHE)
+	LOG_WRN("The sockets have no TLS session cache, full handshakes");
+#endif
+
+	err = settings_subsys_init();
+	if (err) {
+		LOG_ERR("settings_subsys_init, error: %d", err);
+		return err;
+	}
+
+	err = settings_register(&settings_conf);
+	if (err) {
+		LOG_ERR("settings_register, error: %d", err);
+		return err;
+	}
+
+	err = settings_load_subtree(BROKER_CACHE_SETTINGS_KEY);
+	if (err) {
+		LOG_ERR("settings_load_subtree, error: %d", err);
+		return err;
+	}
+
+	return 0;
+}
+
+void broker_cache_invalidate(void)
+{
+	int err;
+
+	k_mutex_lock(&cache_lock, K_FOREVER);
+
+	if (cache.addr == 0) {
+		k_mutex_unlock(&cache_lock);
+		return;
+	}
+
+	memset(&cache, 0, sizeof(cache));
+	err = settings_delete(BROKER_CACHE_SETTINGS_KEY "/"
+			      BROKER_CACHE_ADDR_KEY);
+
+	k_mutex_unlock(&cache_lock);
+
+	if (err) {
+		LOG_ERR("Failed to delete broker address, error: %d", err);
+	}
+
+	LOG_INF("Cached broker address dropped");
+}
+
+bool broker_cache_hit(void)
+{
+	return hit;
+}
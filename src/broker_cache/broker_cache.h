@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   Cache of the broker address, kept in settings, and TLS session
+ *	    resumption, so that a reconnect skips the DNS lookup and the
+ *	    full handshake.
+ */
+
+#ifndef BROKER_CACHE_H__
+#define BROKER_CACHE_H__
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_BROKER_CACHE)
+/**
+ * @brief Load the cached broker address from settings.
+ *
+ * @return 0 on success or negative error value on failure.
+ */
+int broker_cache_init(void);
+
+/** @brief Forget the cached address, the next connection looks it up. Call
+ *	   when a connection to the cached address failed.
+ */
+void broker_cache_invalidate(void);
+
+/** @brief Check if the last lookup of the broker was served from the cache.
+ */
+bool broker_cache_hit(void);
+#else
+static inline int broker_cache_init(void)
+{
+	return 0;
+}
+
+static inline void broker_cache_invalidate(void)
+{
+}
+
+static inline bool broker_cache_hit(void)
+{
+	return false;
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BROKER_CACHE_H__ */
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include "buffer_select.h"
+
+int buffer_select(const bool *queued, const s64_t *ts, size_t size,
+		  size_t count, int *idx, size_t idx_max, bool newest_first)
+{
+	const u8_t *queued_base = (const u8_t *)queued;
+	const u8_t *ts_base = (const u8_t *)ts;
+	int n = 0;
+
+	for (int i = 0; i < count; i++) {
+		s64_t entry_ts = *(const s64_t *)(ts_base + i * size);
+		int j;
+
+		if (!*(const bool *)(queued_base + i * size)) {
+			continue;
+		}
+
+		/* Insertion into the sorted selection, the buffers are
+		 * small.
+		 */
+		for (j = n; j > 0; j--) {
+			s64_t other_ts =
+				*(const s64_t *)(ts_base + idx[j - 1] * size);
+			bool before = newest_first ? entry_ts > other_ts :
+						     entry_ts < other_ts;
+
+			if (!before) {
+				break;
+			}
+
+			if (j < idx_max) {
+				idx[j] = idx[j - 1];
+			}
+		}
+
+		if (j < idx_max) {
+			idx[j] = i;
+			n = MIN(n + 1, idx_max);
+		}
+	}
+
+	return n;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *@brief Selection of the buffered entries to encode.
+ */
+
+#ifndef BUFFER_SELECT_H__
+#define BUFFER_SELECT_H__
+
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Pick the indexes of queued entries of a data buffer, ordered by
+ *        timestamp.
+ *
+ * The members are given by their address in the first entry and the entry
+ * size. Entries with equal timestamps keep their buffer order.
+ *
+ * @param queued Queued flag of the first entry.
+ * @param ts Timestamp of the first entry.
+ * @param size Size of an entry.
+ * @param count Number of entries.
+ * @param idx Selected indexes.
+ * @param idx_max Size of idx, at most this many entries are selected.
+ * @param newest_first Select the newest entries, newest first, instead of
+ *		       the oldest entries, oldest first.
+ *
+ * @return Number of selected entries.
+ */
+int buffer_select(const bool *queued, const s64_t *ts, size_t size,
+		  size_t count, int *idx, size_t idx_max, bool newest_first);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BUFFER_SELECT_H__ */
@@ -6,8 +6,17 @@
 #include <modem/modem_info.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include "cJSON.h"
 #include "cJSON_os.h"
+#include "number_format.h"
+#include "buffer_select.h"
+#include "heap_monitor.h"
+#include "flight_recorder.h"
+
+#if defined(CONFIG_STACK_MONITOR)
+#include "stack_monitor.h"
+#endif
 #include <net/cloud.h>
 #include <date_time.h>
 
@@ -20,6 +29,34 @@ static bool change_active_wait = true;
 static bool change_passive_wait = true;
 static bool change_movt = true;
 static bool change_acc_thres = true;
+static bool change_trkt = true;
+static bool change_prec = true;
+
+/* Precision of encoded data, follows the decoded configuration. */
+static struct cloud_data_prec enc_prec = CLOUD_DATA_PREC_DEFAULT;
+
+/* Largest GPS track tolerance accepted from the cloud, in meters. */
+#define TRKT_MAX_M 1000
+
+static const struct {
+	const char *key;
+	size_t offset;
+} prec_fields[] = {
+	{ "coord", offsetof(struct cloud_data_prec, coord) },
+	{ "alt", offsetof(struct cloud_data_prec, alt) },
+	{ "acc", offsetof(struct cloud_data_prec, acc) },
+	{ "spd", offsetof(struct cloud_data_prec, spd) },
+	{ "hdg", offsetof(struct cloud_data_prec, hdg) },
+	{ "temp", offsetof(struct cloud_data_prec, temp) },
+	{ "hum", offsetof(struct cloud_data_prec, hum) },
+	{ "accel", offsetof(struct cloud_data_prec, accel) },
+};
+#if defined(CONFIG_GEOFENCE)
+static bool change_geo = true;
+
+/* Decimals of zone coordinates, about 0.1 m. */
+#define GEOFENCE_COORD_DECIMALS 6
+#endif
 
 static int json_add_obj(cJSON *parent, const char *str, cJSON *item)
 {
@@ -35,11 +72,38 @@ static int json_add_obj_array(cJSON *parent, cJSON *item)
 	return 0;
 }
 
-static int json_add_number(cJSON *parent, const char *str, double item)
+/* Numbers are formatted here and added raw, cJSON would go through float
+ * printf for each of them.
+ */
+static cJSON *json_fixed_create(s64_t scaled, int decimals)
+{
+	char buf[NUMBER_FORMAT_LEN_MAX];
+
+	if (number_format_fixed(buf, sizeof(buf), scaled, decimals) < 0) {
+		return NULL;
+	}
+
+	return cJSON_CreateRaw(buf);
+}
+
+static int json_add_int(cJSON *parent, const char *str, s64_t item)
+{
+	cJSON *json_num;
+
+	json_num = json_fixed_create(item, 0);
+	if (json_num == NULL) {
+		return -ENOMEM;
+	}
+
+	return json_add_obj(parent, str, json_num);
+}
+
+static int json_add_fixed(cJSON *parent, const char *str, double item,
+			  int decimals)
 {
 	cJSON *json_num;
 
-	json_num = cJSON_CreateNumber(item);
+	json_num = json_fixed_create(number_scale(item, decimals), decimals);
 	if (json_num == NULL) {
 		return -ENOMEM;
 	}
@@ -76,9 +140,212 @@ static int json_add_str(cJSON *parent, const char *str, const char *item)
 	return json_add_obj(parent, str, json_str);
 }
 
-int cloud_codec_decode_response(char *input, struct cloud_data_cfg *data)
+#if defined(CONFIG_GEOFENCE)
+static int geofence_decode(cJSON *obj, struct cloud_data_geofence *zone)
+{
+	cJSON *id = cJSON_GetObjectItem(obj, "id");
+	cJSON *radius = cJSON_GetObjectItem(obj, "r");
+	cJSON *lat = cJSON_GetObjectItem(obj, "lat");
+	cJSON *lng = cJSON_GetObjectItem(obj, "lng");
+	cJSON *poly = cJSON_GetObjectItem(obj, "poly");
+
+	if (id == NULL) {
+		return -EINVAL;
+	}
+
+	memset(zone, 0, sizeof(*zone));
+	zone->id = id->valueint;
+
+	if (poly != NULL) {
+		int vertex_cnt = cJSON_GetArraySize(poly);
+
+		if (vertex_cnt < 3) {
+			return -EINVAL;
+		}
+
+		if (vertex_cnt > CONFIG_GEOFENCE_VERTICES_MAX) {
+			return -ENOMEM;
+		}
+
+		for (int i = 0; i < vertex_cnt; i++) {
+			cJSON *vertex = cJSON_GetArrayItem(poly, i);
+
+			if (cJSON_GetArraySize(vertex) != 2) {
+				return -EINVAL;
+			}
+
+			zone->lat[i] =
+				cJSON_GetArrayItem(vertex, 0)->valuedouble;
+			zone->lng[i] =
+				cJSON_GetArrayItem(vertex, 1)->valuedouble;
+		}
+
+		zone->vertex_cnt = vertex_cnt;
+
+		return 0;
+	}
+
+	if (radius == NULL || lat == NULL || lng == NULL ||
+	    radius->valueint <= 0) {
+		return -EINVAL;
+	}
+
+	zone->lat[0] = lat->valuedouble;
+	zone->lng[0] = lng->valuedouble;
+	zone->radius = radius->valueint;
+
+	return 0;
+}
+
+static int geofences_decode(cJSON *geo, struct cloud_data_cfg *data)
+{
+	/* Zones are decoded aside so that a bad entry keeps the old set. */
+	static struct cloud_data_geofence zones[CONFIG_GEOFENCE_MAX];
+	int err;
+	int zone_cnt = cJSON_GetArraySize(geo);
+
+	if (zone_cnt > CONFIG_GEOFENCE_MAX) {
+		LOG_ERR("Too many geofence zones: %d", zone_cnt);
+		return -ENOMEM;
+	}
+
+	for (int i = 0; i < zone_cnt; i++) {
+		err = geofence_decode(cJSON_GetArrayItem(geo, i), &zones[i]);
+		if (err) {
+			LOG_ERR("Geofence zone %d not decoded, error: %d", i,
+				err);
+			return err;
+		}
+	}
+
+	memcpy(data->geo, zones, sizeof(zones));
+	data->geo_cnt = zone_cnt;
+
+	return 0;
+}
+
+static int json_add_fixed_array(cJSON *parent, double item, int decimals)
+{
+	cJSON *json_num;
+
+	json_num = json_fixed_create(number_scale(item, decimals), decimals);
+	if (json_num == NULL) {
+		return -ENOMEM;
+	}
+
+	return json_add_obj_array(parent, json_num);
+}
+
+static int geofences_encode(cJSON *parent, struct cloud_data_cfg *data)
+{
+	int err = 0;
+	cJSON *geo = cJSON_CreateArray();
+
+	if (geo == NULL) {
+		return -ENOMEM;
+	}
+
+	for (int i = 0; i < data->geo_cnt; i++) {
+		struct cloud_data_geofence *zone = &data->geo[i];
+		cJSON *zone_obj = cJSON_CreateObject();
+
+		if (zone_obj == NULL) {
+			cJSON_Delete(geo);
+			return -ENOMEM;
+		}
+
+		err += json_add_obj_array(geo, zone_obj);
+		err += json_add_int(zone_obj, "id", zone->id);
+
+		if (zone->vertex_cnt == 0) {
+			err += json_add_fixed(zone_obj, "lat", zone->lat[0],
+					      GEOFENCE_COORD_DECIMALS);
+			err += json_add_fixed(zone_obj, "lng", zone->lng[0],
+					      GEOFENCE_COORD_DECIMALS);
+			err += json_add_int(zone_obj, "r", zone->radius);
+			continue;
+		}
+
+		cJSON *poly = cJSON_CreateArray();
+
+		if (poly == NULL) {
+			cJSON_Delete(geo);
+			return -ENOMEM;
+		}
+
+		err += json_add_obj(zone_obj, "poly", poly);
+
+		for (int j = 0; j < zone->vertex_cnt; j++) {
+			cJSON *vertex = cJSON_CreateArray();
+
+			if (vertex == NULL) {
+				cJSON_Delete(geo);
+				return -ENOMEM;
+			}
+
+			err += json_add_obj_array(poly, vertex);
+			err += json_add_fixed_array(vertex, zone->lat[j],
+						    GEOFENCE_COORD_DECIMALS);
+			err += json_add_fixed_array(vertex, zone->lng[j],
+						    GEOFENCE_COORD_DECIMALS);
+		}
+	}
+
+	return err + json_add_obj(parent, "geo", geo);
+}
+#endif /* CONFIG_GEOFENCE */
+
+/* Returns true if any of the decimals changed, out of range values are
+ * ignored.
+ */
+static bool prec_decode(cJSON *obj, struct cloud_data_prec *data)
+{
+	bool changed = false;
+
+	for (int i = 0; i < ARRAY_SIZE(prec_fields); i++) {
+		cJSON *item = cJSON_GetObjectItem(obj, prec_fields[i].key);
+		u8_t *field = (u8_t *)data + prec_fields[i].offset;
+
+		if (item == NULL || !cJSON_IsNumber(item)) {
+			continue;
+		}
+
+		if (item->valueint < 0 ||
+		    item->valueint > NUMBER_FORMAT_DECIMALS_MAX) {
+			LOG_WRN("Precision of %s out of range: %d",
+				prec_fields[i].key, item->valueint);
+			continue;
+		}
+
+		if (*field != item->valueint) {
+			*field = item->valueint;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+static int prec_encode(cJSON *parent, const struct cloud_data_prec *data)
+{
+	int err = 0;
+	cJSON *prec_obj = cJSON_CreateObject();
+
+	if (prec_obj == NULL) {
+		return -ENOMEM;
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(prec_fields); i++) {
+		const u8_t *field = (const u8_t *)data + prec_fields[i].offset;
+
+		err += json_add_int(prec_obj, prec_fields[i].key, *field);
+	}
+
+	return err + json_add_obj(parent, "prec", prec_obj);
+}
+
+static int response_decode(char *input, struct cloud_data_cfg *data)
 {
-	char *string = NULL;
 	cJSON *root_obj = NULL;
 	cJSON *group_obj = NULL;
 	cJSON *subgroup_obj = NULL;
@@ -88,24 +355,24 @@ int cloud_codec_decode_response(char *input, struct cloud_data_cfg *data)
 	cJSON *passive_wait = NULL;
 	cJSON *movt = NULL;
 	cJSON *acc_thres = NULL;
+	cJSON *trkt = NULL;
+	cJSON *prec = NULL;
+	cJSON *geo = NULL;
 
 	if (input == NULL) {
 		return -EINVAL;
 	}
 
+	/* As received, printing the parsed message would reformat numbers. */
+	if (IS_ENABLED(CONFIG_CLOUD_CODEC_PAYLOAD_PRINT)) {
+		printk("Decoded message: %s\n", input);
+	}
+
 	root_obj = cJSON_Parse(input);
 	if (root_obj == NULL) {
 		return -ENOENT;
 	}
 
-	string = cJSON_Print(root_obj);
-	if (string == NULL) {
-		LOG_ERR("Failed to print message.");
-		goto exit;
-	}
-
-	printk("Decoded message: %s\n", string);
-
 	group_obj = json_object_decode(root_obj, "cfg");
 	if (group_obj != NULL) {
 		goto get_data;
@@ -129,6 +396,9 @@ get_data:
 	passive_wait = cJSON_GetObjectItem(subgroup_obj, "mvres");
 	movt = cJSON_GetObjectItem(subgroup_obj, "mvt");
 	acc_thres = cJSON_GetObjectItem(subgroup_obj, "acct");
+	trkt = cJSON_GetObjectItem(subgroup_obj, "trkt");
+	prec = cJSON_GetObjectItem(subgroup_obj, "prec");
+	geo = cJSON_GetObjectItem(subgroup_obj, "geo");
 
 	if (gpst != NULL && data->gpst != gpst->valueint) {
 		data->gpst = gpst->valueint;
@@ -166,356 +436,226 @@ get_data:
 			acc_thres->valueint);
 		change_acc_thres = true;
 	}
-exit:
-	cJSON_Delete(root_obj);
-	return 0;
-}
-
-static int cloud_codec_static_modem_data_add(cJSON *parent,
-					     struct cloud_data_modem *data)
-{
-	int err = 0;
-	char nw_mode[50];
-
-	const char lte_string[]   = "LTE-M";
-	const char nbiot_string[] = "NB-IoT";
-	const char gps_string[]   = " GPS";
-
-	if (!data->queued) {
-		LOG_INF("Head of modem buffer not indexing a queued entry");
-		goto exit;
-	}
-
-	err = date_time_uptime_to_unix_time_ms(&data->mod_ts_static);
-	if (err) {
-		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
-		return err;
-	}
 
-	cJSON *static_m = cJSON_CreateObject();
-	cJSON *static_m_v = cJSON_CreateObject();
-
-	if (static_m  == NULL || static_m_v  == NULL) {
-		cJSON_Delete(static_m);
-		cJSON_Delete(static_m_v);
-		return -ENOMEM;
+	if (trkt != NULL && (!cJSON_IsNumber(trkt) || trkt->valueint < 0 ||
+			     trkt->valueint > TRKT_MAX_M)) {
+		LOG_WRN("Invalid track tolerance ignored");
+	} else if (trkt != NULL && data->trkt != trkt->valueint) {
+		data->trkt = trkt->valueint;
+		LOG_INF("SETTING TRACK TOLERANCE TO: %d", trkt->valueint);
+		change_trkt = true;
 	}
 
-	if (data->nw_lte_m) {
-		strcpy(nw_mode, lte_string);
-	} else if (data->nw_nb_iot) {
-		strcpy(nw_mode, nbiot_string);
+	if (prec != NULL && prec_decode(prec, &data->prec)) {
+		enc_prec = data->prec;
+		LOG_INF("SETTING ENCODED PRECISION");
+		change_prec = true;
 	}
 
-	if (data->nw_gps) {
-		strcat(nw_mode, gps_string);
+#if defined(CONFIG_GEOFENCE)
+	if (geo != NULL && cJSON_IsArray(geo) &&
+	    geofences_decode(geo, data) == 0) {
+		LOG_INF("SETTING %d GEOFENCE ZONES", data->geo_cnt);
+		change_geo = true;
 	}
-
-	err = json_add_number(static_m_v, "band", data->bnd);
-	err += json_add_str(static_m_v, "nw", nw_mode);
-	err += json_add_str(static_m_v, "iccid", data->iccid);
-	err += json_add_str(static_m_v, "modV", data->fw);
-	err += json_add_str(static_m_v, "brdV", data->brdv);
-	err += json_add_str(static_m_v, "appV", data->appv);
-
-	err += json_add_obj(static_m, "v", static_m_v);
-	err += json_add_number(static_m, "ts", data->mod_ts_static);
-	err += json_add_obj(parent, "dev", static_m);
-
+#endif
 exit:
-	return err;
+	cJSON_Delete(root_obj);
+	return 0;
 }
 
-static int cloud_codec_dynamic_modem_data_add(cJSON *parent,
-					      struct cloud_data_modem *data,
-					      bool buffered_entry)
+/* Sequence numbers let the cloud acknowledge entries and report gaps. */
+static int seq_add(cJSON *parent, const char *key, u32_t seq)
 {
-	int err = 0;
-	long mccmnc;
-
-	if (!data->queued) {
-		LOG_INF("Head of modem buffer not indexing a queued entry");
-		goto exit;
-	}
-
-	err = date_time_uptime_to_unix_time_ms(&data->mod_ts);
-	if (err) {
-		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
-		return err;
+	if (!IS_ENABLED(CONFIG_CLOUD_CODEC_SEQ)) {
+		return 0;
 	}
 
-	cJSON *dynamic_m = cJSON_CreateObject();
-	cJSON *dynamic_m_v = cJSON_CreateObject();
-
-	if (dynamic_m  == NULL || dynamic_m_v  == NULL) {
-		cJSON_Delete(dynamic_m);
-		cJSON_Delete(dynamic_m_v);
-		return -ENOMEM;
-	}
-
-	mccmnc = strtol(data->mccmnc, NULL, 10);
+	return json_add_int(parent, key, seq);
+}
 
+/* Entries of batch messages go into an array, entries of data messages
+ * under their stream key.
+ */
+static int entry_attach(cJSON *parent, const char *key, cJSON *entry,
+			bool buffered_entry)
+{
 	if (buffered_entry) {
-		err =  json_add_number(dynamic_m_v, "rsrp", data->rsrp);
-		err += json_add_number(dynamic_m_v, "area", data->area);
-		err += json_add_number(dynamic_m_v, "mccmnc", mccmnc);
-		err += json_add_number(dynamic_m_v, "cell", data->cell);
-		err += json_add_str(dynamic_m_v, "ip", data->ip);
-
-		err += json_add_obj(dynamic_m, "v", dynamic_m_v);
-		err += json_add_number(dynamic_m, "ts", data->mod_ts);
-		err += json_add_obj_array(parent, dynamic_m);
-	} else {
-		err =  json_add_number(dynamic_m_v, "rsrp", data->rsrp);
-		err += json_add_number(dynamic_m_v, "area", data->area);
-		err += json_add_number(dynamic_m_v, "mccmnc", mccmnc);
-		err += json_add_number(dynamic_m_v, "cell", data->cell);
-		err += json_add_str(dynamic_m_v, "ip", data->ip);
-
-		err += json_add_obj(dynamic_m, "v", dynamic_m_v);
-		err += json_add_number(dynamic_m, "ts", data->mod_ts);
-		err += json_add_obj(parent, "roam", dynamic_m);
+		return json_add_obj_array(parent, entry);
 	}
 
-	data->queued = false;
-
-exit:
-	return err;
+	return json_add_obj(parent, key, entry);
 }
 
-static int cloud_codec_sensor_data_add(cJSON *parent,
-					struct cloud_data_sensors *data,
-					bool buffered_entry)
+/* Attaches the reported state to the message, unless nothing was
+ * reported.
+ */
+static int reported_attach(cJSON *root_obj, cJSON *state_obj,
+			   cJSON *rep_obj)
 {
-	int err = 0;
-
-	if (!data->queued) {
-		LOG_INF("Head of sensor buffer not indexing a queued entry");
-		goto exit;
-	}
-
-	err = date_time_uptime_to_unix_time_ms(&data->env_ts);
-	if (err) {
-		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
-		return err;
-	}
-
-	cJSON *sensor_obj = cJSON_CreateObject();
-	cJSON *sensor_val_obj = cJSON_CreateObject();
-
-	if (sensor_obj  == NULL || sensor_val_obj  == NULL) {
-		cJSON_Delete(sensor_obj);
-		cJSON_Delete(sensor_val_obj);
-		return -ENOMEM;
-	}
-
-	if (buffered_entry) {
-		err = json_add_number(sensor_val_obj, "temp", data->temp);
-		err += json_add_number(sensor_val_obj, "hum", data->hum);
-		err += json_add_obj(sensor_obj, "v", sensor_val_obj);
-		err += json_add_number(sensor_obj, "ts", data->env_ts);
-		err += json_add_obj_array(parent, sensor_obj);
-	} else {
-		err = json_add_number(sensor_val_obj, "temp", data->temp);
-		err += json_add_number(sensor_val_obj, "hum", data->hum);
-		err += json_add_obj(sensor_obj, "v", sensor_val_obj);
-		err += json_add_number(sensor_obj, "ts", data->env_ts);
-		err += json_add_obj(parent, "env", sensor_obj);
+	if (rep_obj->child == NULL) {
+		cJSON_Delete(state_obj);
+		cJSON_Delete(rep_obj);
+		return 0;
 	}
 
-
-	data->queued = false;
-
-exit:
-	return err;
+	return json_add_obj(state_obj, "reported", rep_obj) +
+	       json_add_obj(root_obj, "state", state_obj);
 }
 
-static int cloud_codec_gps_data_add(cJSON *parent,
-				    struct cloud_data_gps *data,
-				    bool buffered_entry)
+/* Prints and releases the message object, err being the accumulated error
+ * of encoding it.
+ */
+static int message_print(cJSON *root_obj, struct cloud_msg *output, int err)
 {
-	int err = 0;
+	char *buffer;
 
-	if (!data->queued) {
-		LOG_INF("Head of gps buffer not indexing a queued entry");
+	if (err) {
 		goto exit;
 	}
 
-	err = date_time_uptime_to_unix_time_ms(&data->gps_ts);
-	if (err) {
-		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
-		return err;
+	buffer = cJSON_PrintUnformatted(root_obj);
+	if (buffer == NULL) {
+		err = -ENOMEM;
+		goto exit;
 	}
 
-	cJSON *gps_obj = cJSON_CreateObject();
-	cJSON *gps_val_obj = cJSON_CreateObject();
+	output->buf = buffer;
+	output->len = strlen(buffer);
 
-	if (gps_obj  == NULL || gps_val_obj == NULL) {
-		cJSON_Delete(gps_obj);
-		cJSON_Delete(gps_val_obj);
-		return -ENOMEM;
+	if (IS_ENABLED(CONFIG_CLOUD_CODEC_PAYLOAD_PRINT)) {
+		printk("Encoded message: %s\n", buffer);
 	}
 
-	if (buffered_entry) {
-		err = json_add_number(gps_val_obj, "lng", data->longi);
-		err += json_add_number(gps_val_obj, "lat", data->lat);
-		err += json_add_number(gps_val_obj, "acc", data->acc);
-		err += json_add_number(gps_val_obj, "alt", data->alt);
-		err += json_add_number(gps_val_obj, "spd", data->spd);
-		err += json_add_number(gps_val_obj, "hdg", data->hdg);
-		err += json_add_obj(gps_obj, "v", gps_val_obj);
-		err += json_add_number(gps_obj, "ts", data->gps_ts);
-		err += json_add_obj_array(parent, gps_obj);
-	} else {
-		err = json_add_number(gps_val_obj, "lng", data->longi);
-		err += json_add_number(gps_val_obj, "lat", data->lat);
-		err += json_add_number(gps_val_obj, "acc", data->acc);
-		err += json_add_number(gps_val_obj, "alt", data->alt);
-		err += json_add_number(gps_val_obj, "spd", data->spd);
-		err += json_add_number(gps_val_obj, "hdg", data->hdg);
-
-		err += json_add_obj(gps_obj, "v", gps_val_obj);
-		err += json_add_number(gps_obj, "ts", data->gps_ts);
-		err += json_add_obj(parent, "gps", gps_obj);
-	}
-
-
-	data->queued = false;
-
 exit:
+	flight_recorder_log(FLIGHT_RECORDER_ENCODE, err ? 0 : output->len, err,
+			    0);
+	cJSON_Delete(root_obj);
+
 	return err;
 }
 
-static int cloud_codec_accel_data_add(cJSON *parent,
-				      struct cloud_data_accelerometer *data,
-				      bool buffered_entry)
+static const char *modem_nw_mode(const struct cloud_data_modem *data)
 {
-	int err = 0;
-
-	if (!data->queued) {
-		LOG_INF("Head of accel buffer not indexing a queued entry");
-		goto exit;
-	}
-
-	err = date_time_uptime_to_unix_time_ms(&data->ts);
-	if (err) {
-		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
-		return err;
-	}
-
-	cJSON *acc_obj = cJSON_CreateObject();
-	cJSON *acc_v_obj = cJSON_CreateObject();
-
-	if (acc_obj  == NULL || acc_v_obj == NULL) {
-		cJSON_Delete(acc_obj);
-		cJSON_Delete(acc_v_obj);
-		return -ENOMEM;
+	if (data->nw_lte_m) {
+		return data->nw_gps ? "LTE-M GPS" : "LTE-M";
+	} else if (data->nw_nb_iot) {
+		return data->nw_gps ? "NB-IoT GPS" : "NB-IoT";
 	}
 
-	err = json_add_number(acc_v_obj, "x", data->values[0]);
-	err += json_add_number(acc_v_obj, "y", data->values[1]);
-	err += json_add_number(acc_v_obj, "z", data->values[2]);
+	return data->nw_gps ? "GPS" : "";
+}
 
-	if (buffered_entry) {
-		err += json_add_obj(acc_obj, "v", acc_v_obj);
-		err += json_add_number(acc_obj, "ts", data->ts);
-		err += json_add_obj_array(parent, acc_obj);
-	} else {
-		err += json_add_obj(acc_obj, "v", acc_v_obj);
-		err += json_add_number(acc_obj, "ts", data->ts);
-		err += json_add_obj(parent, "acc", acc_obj);
+#if defined(CONFIG_CLOUD_CODEC_SEQ)
+/* Keys of the streams, same as in the batch messages. */
+static const char *const stream_keys[CLOUD_DATA_STREAM_COUNT] = {
+	[CLOUD_DATA_STREAM_GPS] = "gps",
+	[CLOUD_DATA_STREAM_SENSORS] = "env",
+	[CLOUD_DATA_STREAM_MODEM] = "roam",
+	[CLOUD_DATA_STREAM_UI] = "btn",
+	[CLOUD_DATA_STREAM_ACCEL] = "acc",
+	[CLOUD_DATA_STREAM_BAT] = "bat",
+};
+
+/* Sequence numbers are non-negative integers that fit in 32 bits. */
+static int seq_decode(const cJSON *item, u32_t *seq)
+{
+	if (!cJSON_IsNumber(item) || item->valuedouble < 0 ||
+	    item->valuedouble > UINT32_MAX ||
+	    item->valuedouble != (u32_t)item->valuedouble) {
+		return -EINVAL;
 	}
 
-	data->queued = false;
+	*seq = item->valuedouble;
 
-exit:
-	return err;
+	return 0;
 }
 
-static int cloud_codec_ui_data_add(cJSON *parent,
-				   struct cloud_data_ui *data,
-				   bool buffered_entry)
+/** Decode {"gps": [[first, last], seq, ...], ...} into ranges per stream. */
+static int seq_ranges_decode(cJSON *obj,
+			     struct cloud_data_seq_range
+				     ranges[][CONFIG_CLOUD_CODEC_SEQ_RANGES_MAX],
+			     int *range_cnt)
 {
-	int err = 0;
+	for (int i = 0; i < CLOUD_DATA_STREAM_COUNT; i++) {
+		cJSON *stream = cJSON_GetObjectItem(obj, stream_keys[i]);
+		int cnt;
 
-	if (!data->queued) {
-		LOG_INF("Head of UI buffer not indexing a queued entry");
-		goto exit;
-	}
-
-	err = date_time_uptime_to_unix_time_ms(&data->btn_ts);
-	if (err) {
-		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
-		return err;
-	}
+		if (stream == NULL) {
+			continue;
+		}
 
-	cJSON *btn_obj = cJSON_CreateObject();
+		cnt = cJSON_GetArraySize(stream);
+		if (!cJSON_IsArray(stream) ||
+		    cnt > CONFIG_CLOUD_CODEC_SEQ_RANGES_MAX) {
+			return -EINVAL;
+		}
 
-	if (btn_obj == NULL) {
-		cJSON_Delete(btn_obj);
-		return -ENOMEM;
-	}
+		for (int j = 0; j < cnt; j++) {
+			cJSON *item = cJSON_GetArrayItem(stream, j);
+			struct cloud_data_seq_range *range = &ranges[i][j];
+			cJSON *first = item;
+			cJSON *last = item;
+
+			if (cJSON_IsArray(item) &&
+			    cJSON_GetArraySize(item) == 2) {
+				first = cJSON_GetArrayItem(item, 0);
+				last = cJSON_GetArrayItem(item, 1);
+			}
+
+			if (seq_decode(first, &range->first) ||
+			    seq_decode(last, &range->last) ||
+			    range->last < range->first) {
+				return -EINVAL;
+			}
+		}
 
-	if (buffered_entry) {
-		err = json_add_number(btn_obj, "v", data->btn);
-		err += json_add_number(btn_obj, "ts", data->btn_ts);
-		err += json_add_obj_array(parent, btn_obj);
-	} else {
-		err = json_add_number(btn_obj, "v", data->btn);
-		err += json_add_number(btn_obj, "ts", data->btn_ts);
-		err += json_add_obj(parent, "btn", btn_obj);
+		range_cnt[i] = cnt;
 	}
 
-	data->queued = false;
-
-exit:
-	return err;
+	return 0;
 }
 
-static int cloud_codec_bat_data_add(cJSON *parent,
-				   struct cloud_data_battery *data,
-				   bool buffered_entry)
+static int ack_decode(char *input, struct cloud_data_ack *ack)
 {
 	int err = 0;
+	cJSON *root_obj = NULL;
+	cJSON *ack_obj = NULL;
+	cJSON *nack_obj = NULL;
 
-	if (!data->queued) {
-		LOG_INF("Head of battery buffer not indexing a queued entry");
-		goto exit;
+	if (input == NULL) {
+		return -EINVAL;
 	}
 
-	err = date_time_uptime_to_unix_time_ms(&data->bat_ts);
-	if (err) {
-		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
-		return err;
+	root_obj = cJSON_Parse(input);
+	if (root_obj == NULL) {
+		return -ENOENT;
 	}
 
-	cJSON *bat_obj = cJSON_CreateObject();
+	memset(ack, 0, sizeof(*ack));
 
-	if (bat_obj == NULL) {
-		cJSON_Delete(bat_obj);
-		return -ENOMEM;
+	ack_obj = cJSON_GetObjectItem(root_obj, "ack");
+	if (ack_obj != NULL) {
+		err = seq_ranges_decode(ack_obj, ack->ack, ack->ack_cnt);
+		if (err) {
+			goto exit;
+		}
 	}
 
-	if (buffered_entry) {
-		err = json_add_number(bat_obj, "v", data->bat);
-		err += json_add_number(bat_obj, "ts", data->bat_ts);
-		err += json_add_obj_array(parent, bat_obj);
-	} else {
-		err = json_add_number(bat_obj, "v", data->bat);
-		err += json_add_number(bat_obj, "ts", data->bat_ts);
-		err += json_add_obj(parent, "bat", bat_obj);
+	nack_obj = cJSON_GetObjectItem(root_obj, "nack");
+	if (nack_obj != NULL) {
+		err = seq_ranges_decode(nack_obj, ack->nack, ack->nack_cnt);
 	}
 
-	data->queued = false;
-
 exit:
+	cJSON_Delete(root_obj);
+
 	return err;
 }
+#endif /* CONFIG_CLOUD_CODEC_SEQ */
 
-int cloud_codec_encode_cfg_data(struct cloud_msg *output,
-				struct cloud_data_cfg *data)
+static int cfg_encode(struct cloud_msg *output, struct cloud_data_cfg *data)
 {
-	char *buffer;
 	int err = 0;
 	int change_cnt = 0;
 
@@ -534,7 +674,7 @@ int cloud_codec_encode_cfg_data(struct cloud_msg *output,
 	}
 
 	if (change_gpst) {
-		err += json_add_number(cfg_obj, "gpst", data->gpst);
+		err += json_add_int(cfg_obj, "gpst", data->gpst);
 		change_cnt++;
 	}
 
@@ -544,25 +684,42 @@ int cloud_codec_encode_cfg_data(struct cloud_msg *output,
 	}
 
 	if (change_active_wait) {
-		err += json_add_number(cfg_obj, "actwt", data->actw);
+		err += json_add_int(cfg_obj, "actwt", data->actw);
 		change_cnt++;
 	}
 
 	if (change_passive_wait) {
-		err += json_add_number(cfg_obj, "mvres", data->pasw);
+		err += json_add_int(cfg_obj, "mvres", data->pasw);
 		change_cnt++;
 	}
 
 	if (change_movt) {
-		err += json_add_number(cfg_obj, "mvt", data->movt);
+		err += json_add_int(cfg_obj, "mvt", data->movt);
 		change_cnt++;
 	}
 
 	if (change_acc_thres) {
-		err += json_add_number(cfg_obj, "acct", data->acct);
+		err += json_add_int(cfg_obj, "acct", data->acct);
+		change_cnt++;
+	}
+
+	if (change_trkt) {
+		err += json_add_int(cfg_obj, "trkt", data->trkt);
 		change_cnt++;
 	}
 
+	if (change_prec) {
+		err += prec_encode(cfg_obj, &data->prec);
+		change_cnt++;
+	}
+
+#if defined(CONFIG_GEOFENCE)
+	if (change_geo) {
+		err += geofences_encode(cfg_obj, data);
+		change_cnt++;
+	}
+#endif
+
 	if (change_cnt == 0) {
 		cJSON_Delete(root_obj);
 		cJSON_Delete(state_obj);
@@ -575,423 +732,425 @@ int cloud_codec_encode_cfg_data(struct cloud_msg *output,
 	err += json_add_obj(state_obj, "reported", rep_obj);
 	err += json_add_obj(root_obj, "state", state_obj);
 
+	err = message_print(root_obj, output, err);
 	if (err) {
-		goto exit;
+		return err;
 	}
 
-	buffer = cJSON_Print(root_obj);
-
-	printk("Encoded message: %s\n", buffer);
-
-	output->buf = buffer;
-	output->len = strlen(buffer);
-
 	change_gpst = false;
 	change_active = false;
 	change_active_wait = false;
 	change_passive_wait = false;
 	change_movt = false;
 	change_acc_thres = false;
+	change_trkt = false;
+	change_prec = false;
+#if defined(CONFIG_GEOFENCE)
+	change_geo = false;
+#endif
 
-exit:
-	cJSON_Delete(root_obj);
-	return err;
+	return 0;
 }
 
-int cloud_codec_encode_data(struct cloud_msg *output,
-			    struct cloud_data_gps *gps_buf,
-			    struct cloud_data_sensors *sensor_buf,
-			    struct cloud_data_modem *modem_buf,
-			    struct cloud_data_ui *ui_buf,
-			    struct cloud_data_accelerometer *accel_buf,
-			    struct cloud_data_battery *bat_buf,
-			    enum cloud_data_encode_schema encode_schema)
+static int agps_request_encode(struct cloud_msg *output,
+			       struct gps_agps_request *request)
 {
 	int err = 0;
-	char *buffer;
 
-	cJSON *root_obj  = cJSON_CreateObject();
-	cJSON *state_obj = cJSON_CreateObject();
-	cJSON *rep_obj   = cJSON_CreateObject();
+	cJSON *root_obj = cJSON_CreateObject();
 
-	if (root_obj == NULL || state_obj == NULL || rep_obj == NULL) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(rep_obj);
+	if (root_obj == NULL) {
 		return -ENOMEM;
 	}
 
-	switch (encode_schema) {
-	case CLOUD_DATA_ENCODE_MSTAT_MDYN_SENS_BAT:
-		err = cloud_codec_bat_data_add(rep_obj, bat_buf, false);
-		err += cloud_codec_static_modem_data_add(rep_obj, modem_buf);
-		err += cloud_codec_dynamic_modem_data_add(rep_obj, modem_buf,
-							  false);
-		err += cloud_codec_sensor_data_add(rep_obj, sensor_buf, false);
-		err += json_add_obj(state_obj, "reported", rep_obj);
-		err += json_add_obj(root_obj, "state", state_obj);
-		break;
-	case CLOUD_DATA_ENCODE_MSTAT_MDYN_SENS_BAT_GPS:
-		err = cloud_codec_bat_data_add(rep_obj, bat_buf, false);
-		err += cloud_codec_static_modem_data_add(rep_obj, modem_buf);
-		err += cloud_codec_dynamic_modem_data_add(rep_obj, modem_buf,
-							  false);
-		err += cloud_codec_sensor_data_add(rep_obj, sensor_buf, false);
-		err += cloud_codec_gps_data_add(rep_obj, gps_buf, false);
-		err += json_add_obj(state_obj, "reported", rep_obj);
-		err += json_add_obj(root_obj, "state", state_obj);
-		break;
-	case CLOUD_DATA_ENCODE_MSTAT_MDYN_SENS_BAT_GPS_ACCEL:
-		err = cloud_codec_bat_data_add(rep_obj, bat_buf, false);
-		err += cloud_codec_static_modem_data_add(rep_obj, modem_buf);
-		err += cloud_codec_dynamic_modem_data_add(rep_obj, modem_buf,
-							  false);
-		err += cloud_codec_sensor_data_add(rep_obj, sensor_buf, false);
-		err += cloud_codec_gps_data_add(rep_obj, gps_buf, false);
-		err += cloud_codec_accel_data_add(rep_obj, accel_buf, false);
-		err += json_add_obj(state_obj, "reported", rep_obj);
-		err += json_add_obj(root_obj, "state", state_obj);
-		break;
-	case CLOUD_DATA_ENCODE_MSTAT_MDYN_SENS_BAT_ACCEL:
-		err = cloud_codec_bat_data_add(rep_obj, bat_buf, false);
-		err += cloud_codec_static_modem_data_add(rep_obj, modem_buf);
-		err += cloud_codec_dynamic_modem_data_add(rep_obj, modem_buf,
-							  false);
-		err += cloud_codec_sensor_data_add(rep_obj, sensor_buf, false);
-		err += cloud_codec_accel_data_add(rep_obj, accel_buf, false);
-		err += json_add_obj(state_obj, "reported", rep_obj);
-		err += json_add_obj(root_obj, "state", state_obj);
-		break;
-	case CLOUD_DATA_ENCODE_MDYN_SENS_BAT:
-		err = cloud_codec_bat_data_add(rep_obj, bat_buf, false);
-		err += cloud_codec_dynamic_modem_data_add(rep_obj, modem_buf,
-							  false);
-		err += cloud_codec_sensor_data_add(rep_obj, sensor_buf, false);
-		err += json_add_obj(state_obj, "reported", rep_obj);
-		err += json_add_obj(root_obj, "state", state_obj);
-		break;
-	case CLOUD_DATA_ENCODE_MDYN_SENS_BAT_GPS:
-		err = cloud_codec_bat_data_add(rep_obj, bat_buf, false);
-		err += cloud_codec_dynamic_modem_data_add(rep_obj, modem_buf,
-							  false);
-		err += cloud_codec_sensor_data_add(rep_obj, sensor_buf, false);
-		err += cloud_codec_gps_data_add(rep_obj, gps_buf, false);
-		err += json_add_obj(state_obj, "reported", rep_obj);
-		err += json_add_obj(root_obj, "state", state_obj);
-		break;
-	case CLOUD_DATA_ENCODE_MDYN_SENS_BAT_GPS_ACCEL:
-		err = cloud_codec_bat_data_add(rep_obj, bat_buf, false);
-		err += cloud_codec_dynamic_modem_data_add(rep_obj, modem_buf,
-							  false);
-		err += cloud_codec_sensor_data_add(rep_obj, sensor_buf, false);
-		err += cloud_codec_gps_data_add(rep_obj, gps_buf, false);
-		err += cloud_codec_accel_data_add(rep_obj, accel_buf, false);
-		err += json_add_obj(state_obj, "reported", rep_obj);
-		err += json_add_obj(root_obj, "state", state_obj);
-		break;
-	case CLOUD_DATA_ENCODE_MDYN_SENS_BAT_ACCEL:
-		err = cloud_codec_bat_data_add(rep_obj, bat_buf, false);
-		err += cloud_codec_dynamic_modem_data_add(rep_obj, modem_buf,
-							 false);
-		err += cloud_codec_sensor_data_add(rep_obj, sensor_buf, false);
-		err += cloud_codec_accel_data_add(rep_obj, accel_buf, false);
-		err += json_add_obj(state_obj, "reported", rep_obj);
-		err += json_add_obj(root_obj, "state", state_obj);
-		break;
-	case CLOUD_DATA_ENCODE_UI:
-		err = cloud_codec_ui_data_add(root_obj, ui_buf, false);
-		cJSON_Delete(state_obj);
-		cJSON_Delete(rep_obj);
-		break;
-	default:
-		LOG_ERR("Unknown encoding schema");
-		break;
+	if (request->sv_mask_ephe) {
+		err += json_add_int(root_obj, "eph", request->sv_mask_ephe);
 	}
 
-	if (err) {
-		goto exit;
+	if (request->sv_mask_alm) {
+		err += json_add_int(root_obj, "alm", request->sv_mask_alm);
 	}
 
-	buffer = cJSON_Print(root_obj);
-
-	printk("Encoded message: %s\n", buffer);
-
-	output->buf = buffer;
-	output->len = strlen(buffer);
-
-exit:
-	cJSON_Delete(root_obj);
-
-	return err;
-}
-
-int cloud_codec_encode_gps_buffer(struct cloud_msg *output,
-				  struct cloud_data_gps *data)
-{
-	int err = 0;
-	int encoded_counter = 0;
-	char *buffer;
-
-	cJSON *root_obj  = cJSON_CreateObject();
-	cJSON *gps_obj = cJSON_CreateArray();
-
-	if (root_obj == NULL || gps_obj == NULL) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(gps_obj);
-		return -ENOMEM;
+	if (request->utc) {
+		err += json_add_bool(root_obj, "utc", true);
 	}
 
-	for (int i = 0; i < CONFIG_GPS_BUFFER_MAX; i++) {
-		if (data[i].queued &&
-		    (encoded_counter < CONFIG_ENCODED_BUFFER_ENTRIES_MAX)) {
-			err += cloud_codec_gps_data_add(gps_obj, &data[i],
-							true);
-			encoded_counter++;
-		}
+	if (request->klobuchar) {
+		err += json_add_bool(root_obj, "klob", true);
 	}
 
-	err += json_add_obj(root_obj, "gps", gps_obj);
-
-	if (err) {
-		goto exit;
+	if (request->nequick) {
+		err += json_add_bool(root_obj, "neq", true);
 	}
 
-	buffer = cJSON_Print(root_obj);
-
-	printk("Encoded message: %s\n", buffer);
-
-	output->buf = buffer;
-	output->len = strlen(buffer);
+	if (request->system_time_tow) {
+		err += json_add_bool(root_obj, "time", true);
+	}
 
-exit:
+	if (request->position) {
+		err += json_add_bool(root_obj, "pos", true);
+	}
 
-	cJSON_Delete(root_obj);
+	if (request->integrity) {
+		err += json_add_bool(root_obj, "int", true);
+	}
 
-	return 0;
+	return message_print(root_obj, output, err);
 }
 
-int cloud_codec_encode_modem_buffer(struct cloud_msg *output,
-				    struct cloud_data_modem *data)
+#if defined(CONFIG_STACK_MONITOR)
+/* Stacks are added as "name": [used, size]. */
+static int stacks_add(cJSON *parent, const struct stack_monitor_thread *stacks,
+		      int cnt)
 {
 	int err = 0;
-	int encoded_counter = 0;
-	char *buffer;
+	cJSON *stack_obj = cJSON_CreateObject();
 
-	cJSON *root_obj  = cJSON_CreateObject();
-	cJSON *modem_obj = cJSON_CreateArray();
-
-	if (root_obj == NULL || modem_obj == NULL) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(modem_obj);
+	if (stack_obj == NULL) {
 		return -ENOMEM;
 	}
 
-	for (int i = 0; i < CONFIG_MODEM_BUFFER_MAX; i++) {
-		if (data[i].queued &&
-		    (encoded_counter < CONFIG_ENCODED_BUFFER_ENTRIES_MAX)) {
-			err += cloud_codec_dynamic_modem_data_add(modem_obj,
-								  &data[i],
-								  true);
-			encoded_counter++;
+	for (int i = 0; i < cnt; i++) {
+		cJSON *array_obj = cJSON_CreateArray();
+		cJSON *used = json_fixed_create(stacks[i].used, 0);
+		cJSON *size = json_fixed_create(stacks[i].size, 0);
+
+		if (array_obj == NULL || used == NULL || size == NULL) {
+			cJSON_Delete(array_obj);
+			cJSON_Delete(used);
+			cJSON_Delete(size);
+			err = -ENOMEM;
+			break;
 		}
-	}
 
-	err += json_add_obj(root_obj, "roam", modem_obj);
+		json_add_obj_array(array_obj, used);
+		json_add_obj_array(array_obj, size);
+		json_add_obj(stack_obj, stacks[i].name, array_obj);
+	}
 
 	if (err) {
-		goto exit;
+		cJSON_Delete(stack_obj);
+		return err;
 	}
 
-	buffer = cJSON_Print(root_obj);
-
-	printk("Encoded message: %s\n", buffer);
-
-	output->buf = buffer;
-	output->len = strlen(buffer);
+	return json_add_obj(parent, "stack", stack_obj);
+}
+#endif /* CONFIG_STACK_MONITOR */
 
-exit:
+static int health_encode(struct cloud_msg *output,
+			 struct cloud_data_health *data)
+{
+	int err;
+	s64_t ts = data->ts;
+	cJSON *root_obj;
+	cJSON *health_obj;
+	cJSON *val_obj;
+	cJSON *heap_obj;
+	cJSON *fail_obj;
+
+	err = date_time_uptime_to_unix_time_ms(&ts);
+	if (err) {
+		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
+		return err;
+	}
 
-	cJSON_Delete(root_obj);
+	root_obj = cJSON_CreateObject();
+	health_obj = cJSON_CreateObject();
+	val_obj = cJSON_CreateObject();
+	heap_obj = cJSON_CreateObject();
+	fail_obj = cJSON_CreateObject();
+	if (root_obj == NULL || health_obj == NULL || val_obj == NULL ||
+	    heap_obj == NULL || fail_obj == NULL) {
+		cJSON_Delete(root_obj);
+		cJSON_Delete(health_obj);
+		cJSON_Delete(val_obj);
+		cJSON_Delete(heap_obj);
+		cJSON_Delete(fail_obj);
+		return -ENOMEM;
+	}
 
-	return 0;
+	err += json_add_int(fail_obj, "codec", data->fail_codec);
+	err += json_add_int(fail_obj, "fota", data->fail_fota);
+	err += json_add_int(fail_obj, "other", data->fail_other);
+	err += json_add_int(fail_obj, "size", data->fail_size);
+	err += json_add_int(fail_obj, "used", data->fail_used);
+	err += json_add_int(heap_obj, "used", data->heap_used);
+	err += json_add_int(heap_obj, "peak", data->heap_peak);
+	err += json_add_obj(heap_obj, "fail", fail_obj);
+	err += json_add_obj(val_obj, "heap", heap_obj);
+#if defined(CONFIG_STACK_MONITOR)
+	if (data->stack_cnt > 0) {
+		err += stacks_add(val_obj, data->stacks, data->stack_cnt);
+	}
+#endif
+	err += json_add_obj(health_obj, "v", val_obj);
+	err += json_add_int(health_obj, "ts", ts);
+	err += json_add_obj(root_obj, "health", health_obj);
+
+	return message_print(root_obj, output, err);
 }
 
-int cloud_codec_encode_sensor_buffer(struct cloud_msg *output,
-				     struct cloud_data_sensors *data)
+#if defined(CONFIG_POWER_TIMELINE)
+static int power_encode(struct cloud_msg *output,
+			const struct power_timeline_summary *summary,
+			bool daily)
 {
-	int err = 0;
-	int encoded_counter = 0;
-	char *buffer;
-
-	cJSON *root_obj  = cJSON_CreateObject();
-	cJSON *sensor_obj = cJSON_CreateArray();
+	int err;
+	s64_t ts = summary->start_ts;
+	cJSON *root_obj;
+	cJSON *power_obj;
+	cJSON *val_obj;
+	cJSON *act_obj;
+
+	err = date_time_uptime_to_unix_time_ms(&ts);
+	if (err) {
+		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
+		return err;
+	}
 
-	if (root_obj == NULL || sensor_obj == NULL) {
+	root_obj = cJSON_CreateObject();
+	power_obj = cJSON_CreateObject();
+	val_obj = cJSON_CreateObject();
+	act_obj = cJSON_CreateObject();
+	if (root_obj == NULL || power_obj == NULL || val_obj == NULL ||
+	    act_obj == NULL) {
 		cJSON_Delete(root_obj);
-		cJSON_Delete(sensor_obj);
+		cJSON_Delete(power_obj);
+		cJSON_Delete(val_obj);
+		cJSON_Delete(act_obj);
 		return -ENOMEM;
 	}
 
-	for (int i = 0; i < CONFIG_SENSOR_BUFFER_MAX; i++) {
-		if (data[i].queued &&
-		    (encoded_counter < CONFIG_ENCODED_BUFFER_ENTRIES_MAX)) {
-			err += cloud_codec_sensor_data_add(sensor_obj,
-							   &data[i],
-							   true);
-			encoded_counter++;
+	for (int i = 0; i < POWER_TIMELINE_ACTIVITY_COUNT; i++) {
+		if (summary->activity[i] > 0) {
+			err += json_add_int(act_obj,
+					    power_timeline_activity_name(i),
+					    summary->activity[i]);
 		}
 	}
 
-	err += json_add_obj(root_obj, "env", sensor_obj);
+	/* Durations are in milliseconds, ts is the start of the period. */
+	err += json_add_int(val_obj, "per", summary->period);
+	err += json_add_int(val_obj, "conn", summary->connected);
+	err += json_add_int(val_obj, "idle", summary->idle);
+	err += json_add_int(val_obj, "psm", summary->psm);
+	err += json_add_int(val_obj, "gps", summary->gps);
+	err += json_add_int(val_obj, "rrc", summary->connections);
+	err += json_add_obj(val_obj, "act", act_obj);
+	err += json_add_obj(power_obj, "v", val_obj);
+	err += json_add_int(power_obj, "ts", ts);
+	err += json_add_obj(root_obj, daily ? "pwrDay" : "pwr", power_obj);
 
-	if (err) {
-		goto exit;
-	}
+	return message_print(root_obj, output, err);
+}
+#endif /* CONFIG_POWER_TIMELINE */
 
-	buffer = cJSON_Print(root_obj);
+#if defined(CONFIG_METRICS)
+static int metrics_hist_add(cJSON *parent, const char *str,
+			    const u32_t *buckets)
+{
+	cJSON *array_obj = cJSON_CreateArray();
 
-	printk("Encoded message: %s\n", buffer);
+	if (array_obj == NULL) {
+		return -ENOMEM;
+	}
 
-	output->buf = buffer;
-	output->len = strlen(buffer);
+	for (int i = 0; i < METRICS_HIST_BUCKETS; i++) {
+		cJSON *json_num = json_fixed_create(buckets[i], 0);
 
-exit:
+		if (json_num == NULL) {
+			cJSON_Delete(array_obj);
+			return -ENOMEM;
+		}
 
-	cJSON_Delete(root_obj);
+		json_add_obj_array(array_obj, json_num);
+	}
 
-	return 0;
+	return json_add_obj(parent, str, array_obj);
 }
 
-int cloud_codec_encode_ui_buffer(struct cloud_msg *output,
-				 struct cloud_data_ui *data)
+static int metrics_encode(struct cloud_msg *output,
+			  const struct metrics_snapshot *snapshot)
 {
 	int err = 0;
-	int encoded_counter = 0;
-	char *buffer;
-
-	cJSON *root_obj  = cJSON_CreateObject();
-	cJSON *ui_obj = cJSON_CreateArray();
+	bool empty = true;
+	s64_t ts = snapshot->ts;
+	cJSON *root_obj;
+	cJSON *metrics_obj;
+	cJSON *val_obj;
+	cJSON *cnt_obj;
+	cJSON *hist_obj;
+
+	err = date_time_uptime_to_unix_time_ms(&ts);
+	if (err) {
+		LOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", err);
+		return err;
+	}
 
-	if (root_obj == NULL || ui_obj == NULL) {
+	root_obj = cJSON_CreateObject();
+	metrics_obj = cJSON_CreateObject();
+	val_obj = cJSON_CreateObject();
+	cnt_obj = cJSON_CreateObject();
+	hist_obj = cJSON_CreateObject();
+	if (root_obj == NULL || metrics_obj == NULL || val_obj == NULL ||
+	    cnt_obj == NULL || hist_obj == NULL) {
 		cJSON_Delete(root_obj);
-		cJSON_Delete(ui_obj);
+		cJSON_Delete(metrics_obj);
+		cJSON_Delete(val_obj);
+		cJSON_Delete(cnt_obj);
+		cJSON_Delete(hist_obj);
 		return -ENOMEM;
 	}
 
-	for (int i = 0; i < CONFIG_UI_BUFFER_MAX; i++) {
-		if (data[i].queued &&
-		    (encoded_counter < CONFIG_ENCODED_BUFFER_ENTRIES_MAX)) {
-			err += cloud_codec_ui_data_add(ui_obj, &data[i], true);
-			encoded_counter++;
+	for (int i = 0; i < METRICS_COUNTER_COUNT; i++) {
+		if (snapshot->counter[i] == 0) {
+			continue;
 		}
-	}
-
-	err += json_add_obj(root_obj, "btn", ui_obj);
 
-	if (err) {
-		goto exit;
+		empty = false;
+		err += json_add_int(cnt_obj, metrics_counter_name(i),
+				    snapshot->counter[i]);
 	}
 
-	buffer = cJSON_Print(root_obj);
+	for (int i = 0; i < METRICS_HIST_COUNT; i++) {
+		u32_t total = 0;
 
-	printk("Encoded message: %s\n", buffer);
+		for (int j = 0; j < METRICS_HIST_BUCKETS; j++) {
+			total += snapshot->hist[i][j];
+		}
 
-	output->buf = buffer;
-	output->len = strlen(buffer);
+		if (total == 0) {
+			continue;
+		}
 
-exit:
+		empty = false;
+		err += metrics_hist_add(hist_obj, metrics_hist_name(i),
+					snapshot->hist[i]);
+	}
 
-	cJSON_Delete(root_obj);
+	/* Length of the counting period, in seconds. */
+	err += json_add_int(val_obj, "per",
+			    (snapshot->ts - snapshot->start_ts) / MSEC_PER_SEC);
+	err += json_add_obj(val_obj, "c", cnt_obj);
+	err += json_add_obj(val_obj, "h", hist_obj);
+	err += json_add_obj(metrics_obj, "v", val_obj);
+	err += json_add_int(metrics_obj, "ts", ts);
+	err += json_add_obj(root_obj, "metrics", metrics_obj);
 
-	return 0;
+	if (empty && !err) {
+		err = -EAGAIN;
+	}
+
+	return message_print(root_obj, output, err);
 }
+#endif /* CONFIG_METRICS */
 
-int cloud_codec_encode_accel_buffer(struct cloud_msg *output,
-				    struct cloud_data_accelerometer *data)
-{
-	int err = 0;
-	int encoded_counter = 0;
-	char *buffer;
+/* Selects queued entries of a data buffer, ordered by the timestamp
+ * member ts.
+ */
+#define BUFFER_SELECT(data, count, ts, idx)                                   \
+	buffer_select(&(data)[0].queued, &(data)[0].ts, sizeof((data)[0]),    \
+		      count, idx, CONFIG_ENCODED_BUFFER_ENTRIES_MAX,          \
+		      IS_ENABLED(CONFIG_CLOUD_CODEC_BACKLOG_NEWEST_FIRST))
 
-	cJSON *root_obj  = cJSON_CreateObject();
-	cJSON *acc_obj = cJSON_CreateArray();
+/* The entry points account their allocations to the codec. */
+int cloud_codec_decode_response(char *input, struct cloud_data_cfg *data)
+{
+	int err;
 
-	if (root_obj == NULL || acc_obj == NULL) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(acc_obj);
-		return -ENOMEM;
-	}
+	heap_monitor_site_enter(HEAP_MONITOR_SITE_CODEC);
+	err = response_decode(input, data);
+	heap_monitor_site_exit();
 
-	for (int i = 0; i < CONFIG_ACCEL_BUFFER_MAX; i++) {
-		if (data[i].queued &&
-		    (encoded_counter < CONFIG_ENCODED_BUFFER_ENTRIES_MAX)) {
-			err += cloud_codec_accel_data_add(acc_obj, &data[i],
-							  true);
-			encoded_counter++;
-		}
+	if (IS_ENABLED(CONFIG_FLIGHT_RECORDER)) {
+		flight_recorder_log(FLIGHT_RECORDER_DECODE,
+				    (input != NULL) ? strlen(input) : 0, err, 0);
 	}
 
-	err += json_add_obj(root_obj, "acc", acc_obj);
-
-	if (err) {
-		goto exit;
-	}
+	return err;
+}
 
-	buffer = cJSON_Print(root_obj);
+#if defined(CONFIG_CLOUD_CODEC_SEQ)
+int cloud_codec_decode_ack(char *input, struct cloud_data_ack *ack)
+{
+	int err;
 
-	printk("Encoded message: %s\n", buffer);
+	heap_monitor_site_enter(HEAP_MONITOR_SITE_CODEC);
+	err = ack_decode(input, ack);
+	heap_monitor_site_exit();
 
-	output->buf = buffer;
-	output->len = strlen(buffer);
+	return err;
+}
+#endif
 
-exit:
+int cloud_codec_encode_cfg_data(struct cloud_msg *output,
+				struct cloud_data_cfg *data)
+{
+	int err;
 
-	cJSON_Delete(root_obj);
+	heap_monitor_site_enter(HEAP_MONITOR_SITE_CODEC);
+	err = cfg_encode(output, data);
+	heap_monitor_site_exit();
 
-	return 0;
+	return err;
 }
 
-int cloud_codec_encode_bat_buffer(struct cloud_msg *output,
-				    struct cloud_data_battery *data)
+int cloud_codec_encode_agps_request(struct cloud_msg *output,
+				    struct gps_agps_request *request)
 {
-	int err = 0;
-	int encoded_counter = 0;
-	char *buffer;
+	int err;
 
-	cJSON *root_obj  = cJSON_CreateObject();
-	cJSON *bat_obj = cJSON_CreateArray();
+	heap_monitor_site_enter(HEAP_MONITOR_SITE_CODEC);
+	err = agps_request_encode(output, request);
+	heap_monitor_site_exit();
 
-	if (root_obj == NULL || bat_obj) {
-		cJSON_Delete(root_obj);
-		cJSON_Delete(bat_obj);
-		return -ENOMEM;
-	}
+	return err;
+}
 
-	for (int i = 0; i < CONFIG_BAT_BUFFER_MAX; i++) {
-		if (data[i].queued &&
-		    (encoded_counter < CONFIG_ENCODED_BUFFER_ENTRIES_MAX)) {
-			err += cloud_codec_bat_data_add(root_obj, &data[i],
-							true);
-			encoded_counter++;
-		}
-	}
+int cloud_codec_encode_health(struct cloud_msg *output,
+			      struct cloud_data_health *data)
+{
+	int err;
 
-	err += json_add_obj(root_obj, "bat", bat_obj);
+	heap_monitor_site_enter(HEAP_MONITOR_SITE_CODEC);
+	err = health_encode(output, data);
+	heap_monitor_site_exit();
 
-	if (err) {
-		goto exit;
-	}
+	return err;
+}
 
-	buffer = cJSON_Print(root_obj);
+#if defined(CONFIG_POWER_TIMELINE)
+int cloud_codec_encode_power(struct cloud_msg *output,
+			     const struct power_timeline_summary *summary,
+			     bool daily)
+{
+	int err;
 
-	printk("Encoded message: %s\n", buffer);
+	heap_monitor_site_enter(HEAP_MONITOR_SITE_CODEC);
+	err = power_encode(output, summary, daily);
+	heap_monitor_site_exit();
 
-	output->buf = buffer;
-	output->len = strlen(buffer);
+	return err;
+}
+#endif
 
-exit:
+#if defined(CONFIG_METRICS)
+int cloud_codec_encode_metrics(struct cloud_msg *output,
+			       const struct metrics_snapshot *snapshot)
+{
+	int err;
 
-	cJSON_Delete(root_obj);
+	heap_monitor_site_enter(HEAP_MONITOR_SITE_CODEC);
+	err = metrics_encode(output, snapshot);
+	heap_monitor_site_exit();
 
-	return 0;
+	return err;
+}
+#endif
+
+void cloud_codec_release_data(struct cloud_msg *output)
+{
+	cJSON_free(output->buf);
 }
+
+#include "cloud_codec_encoders.inc"
@@ -15,7 +15,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <net/cloud.h>
+#include <drivers/gps.h>
 #include <modem/modem_info.h>
+#include <metrics.h>
+#include <power_timeline.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -30,18 +33,40 @@
 extern "C" {
 #endif
 
-/** @brief Combinations of data entries to be encoded. */
-enum cloud_data_encode_schema {
-	CLOUD_DATA_ENCODE_MSTAT_MDYN_SENS_BAT,
-	CLOUD_DATA_ENCODE_MSTAT_MDYN_SENS_BAT_GPS,
-	CLOUD_DATA_ENCODE_MSTAT_MDYN_SENS_BAT_GPS_ACCEL,
-	CLOUD_DATA_ENCODE_MSTAT_MDYN_SENS_BAT_ACCEL,
-	CLOUD_DATA_ENCODE_MDYN_SENS_BAT,
-	CLOUD_DATA_ENCODE_MDYN_SENS_BAT_GPS,
-	CLOUD_DATA_ENCODE_MDYN_SENS_BAT_GPS_ACCEL,
-	CLOUD_DATA_ENCODE_MDYN_SENS_BAT_ACCEL,
-	CLOUD_DATA_ENCODE_UI
+/** @brief Streams of buffered entries, numbered separately. */
+enum cloud_data_stream {
+	CLOUD_DATA_STREAM_GPS,
+	CLOUD_DATA_STREAM_SENSORS,
+	CLOUD_DATA_STREAM_MODEM,
+	CLOUD_DATA_STREAM_UI,
+	CLOUD_DATA_STREAM_ACCEL,
+	CLOUD_DATA_STREAM_BAT,
+
+	CLOUD_DATA_STREAM_COUNT
+};
+
+/** Sequence number of a GPS entry that has not been numbered yet. */
+#define CLOUD_DATA_SEQ_NONE UINT32_MAX
+
+#if defined(CONFIG_CLOUD_CODEC_SEQ)
+/** @brief Inclusive range of sequence numbers. */
+struct cloud_data_seq_range {
+	u32_t first;
+	u32_t last;
+};
+
+/** @brief Acknowledged and missing sequence numbers reported by the cloud,
+ *  per stream.
+ */
+struct cloud_data_ack {
+	struct cloud_data_seq_range ack[CLOUD_DATA_STREAM_COUNT]
+				       [CONFIG_CLOUD_CODEC_SEQ_RANGES_MAX];
+	int ack_cnt[CLOUD_DATA_STREAM_COUNT];
+	struct cloud_data_seq_range nack[CLOUD_DATA_STREAM_COUNT]
+					[CONFIG_CLOUD_CODEC_SEQ_RANGES_MAX];
+	int nack_cnt[CLOUD_DATA_STREAM_COUNT];
 };
+#endif
 
 /** @brief Structure containing battery data published to cloud. */
 struct cloud_data_battery {
@@ -49,8 +74,14 @@ struct cloud_data_battery {
 	u16_t bat;
 
 	s64_t bat_ts;
+	/** Sequence number within the stream of the entry type. */
+	u32_t seq;
+	/** Published, but not yet acknowledged by the cloud. */
+	bool unacked;
 
 	bool queued;
+	/** Encoded in a message that is not queued for publication yet. */
+	bool encoded;
 };
 
 /** @brief Structure containing GPS data published to cloud. */
@@ -69,9 +100,78 @@ struct cloud_data_gps {
 	float spd;
 	/** Heading of movement in degrees. */
 	float hdg;
-	/** Flag signifying if the GPS fix is to be published, aux variable. */
+	/** Seconds the device stayed at this position, 0 if not known. */
+	u32_t dur;
+	/** Sequence number within the stream of the entry type, given when
+	 *  the entry is first encoded, after track simplification.
+	 */
+	u32_t seq;
+	/** Published, but not yet acknowledged by the cloud. */
+	bool unacked;
+	bool queued;
+	/** Encoded in a message that is not queued for publication yet. */
+	bool encoded;
+};
+
+#if defined(CONFIG_GEOFENCE)
+/** @brief Structure containing a geofence zone, a circle or a polygon. */
+struct cloud_data_geofence {
+	/** Zone identifier. */
+	int id;
+	/** Number of polygon vertices, 0 for a circle. */
+	int vertex_cnt;
+	/** Latitude of the circle center or of the polygon vertices. */
+	double lat[CONFIG_GEOFENCE_VERTICES_MAX];
+	/** Longitude of the circle center or of the polygon vertices. */
+	double lng[CONFIG_GEOFENCE_VERTICES_MAX];
+	/** Circle radius in meters. */
+	u32_t radius;
+};
+
+/** @brief Structure containing a geofence event published to cloud. */
+struct cloud_data_geofence_evt {
+	/** Event timestamp. UNIX milliseconds. */
+	s64_t ts;
+	/** Identifier of the zone that was entered or left. */
+	int id;
+	/** True if the zone was entered, false if it was left. */
+	bool enter;
+
 	bool queued;
+	bool encoded;
 };
+#endif
+
+/** @brief Decimals of encoded values. */
+struct cloud_data_prec {
+	/** GPS latitude and longitude. */
+	u8_t coord;
+	/** GPS altitude. */
+	u8_t alt;
+	/** GPS accuracy. */
+	u8_t acc;
+	/** GPS speed. */
+	u8_t spd;
+	/** GPS heading. */
+	u8_t hdg;
+	/** Temperature. */
+	u8_t temp;
+	/** Humidity. */
+	u8_t hum;
+	/** Accelerometer readings. */
+	u8_t accel;
+};
+
+#define CLOUD_DATA_PREC_DEFAULT {                                              \
+	.coord = CONFIG_CLOUD_CODEC_PREC_COORD,                                \
+	.alt = CONFIG_CLOUD_CODEC_PREC_ALT,                                    \
+	.acc = CONFIG_CLOUD_CODEC_PREC_ACC,                                    \
+	.spd = CONFIG_CLOUD_CODEC_PREC_SPD,                                    \
+	.hdg = CONFIG_CLOUD_CODEC_PREC_HDG,                                    \
+	.temp = CONFIG_CLOUD_CODEC_PREC_TEMP,                                  \
+	.hum = CONFIG_CLOUD_CODEC_PREC_HUM,                                    \
+	.accel = CONFIG_CLOUD_CODEC_PREC_ACCEL,                                \
+}
 
 struct cloud_data_cfg {
 	/** Device mode configurations. */
@@ -86,6 +186,16 @@ struct cloud_data_cfg {
 	int movt;
 	/** Accelerometer trigger threshold value. */
 	int acct;
+	/** GPS track simplification tolerance in meters, 0 disables. */
+	int trkt;
+	/** Decimals of encoded values. */
+	struct cloud_data_prec prec;
+#if defined(CONFIG_GEOFENCE)
+	/** Geofence zones. */
+	struct cloud_data_geofence geo[CONFIG_GEOFENCE_MAX];
+	/** Number of geofence zones. */
+	int geo_cnt;
+#endif
 };
 
 struct cloud_data_accelerometer {
@@ -93,8 +203,13 @@ struct cloud_data_accelerometer {
 	s64_t ts;
 	/** Accelerometer readings. */
 	double values[3];
+	/** Sequence number within the stream of the entry type. */
+	u32_t seq;
+	/** Published, but not yet acknowledged by the cloud. */
+	bool unacked;
 
 	bool queued;
+	bool encoded;
 };
 
 struct cloud_data_sensors {
@@ -104,8 +219,13 @@ struct cloud_data_sensors {
 	double temp;
 	/** Humidity level in percentage */
 	double hum;
+	/** Sequence number within the stream of the entry type. */
+	u32_t seq;
+	/** Published, but not yet acknowledged by the cloud. */
+	bool unacked;
 
 	bool queued;
+	bool encoded;
 };
 
 struct cloud_data_modem {
@@ -125,51 +245,95 @@ struct cloud_data_modem {
 	const char *brdv;
 	char *fw;
 	char *iccid;
+	/** Sequence number within the stream of the entry type. */
+	u32_t seq;
+	/** Published, but not yet acknowledged by the cloud. */
+	bool unacked;
 	bool queued;
+	bool encoded;
 };
 
 struct cloud_data_ui {
 	s64_t btn_ts;
 	int btn;
+	/** Sequence number within the stream of the entry type. */
+	u32_t seq;
+	/** Published, but not yet acknowledged by the cloud. */
+	bool unacked;
 	bool queued;
+	bool encoded;
+};
+
+struct stack_monitor_thread;
+
+/** @brief Structure containing the device health published to cloud. */
+struct cloud_data_health {
+	/** Bytes allocated from the system heap, currently and at most. */
+	u32_t heap_used;
+	u32_t heap_peak;
+	/** Failed allocations of the codec, of FOTA and of the rest. */
+	u32_t fail_codec;
+	u32_t fail_fota;
+	u32_t fail_other;
+	/** Size of the last failed allocation and bytes allocated then. */
+	u32_t fail_size;
+	u32_t fail_used;
+	/** Stack usage of the threads, if measured. */
+	const struct stack_monitor_thread *stacks;
+	int stack_cnt;
+
+	s64_t ts;
 };
 
 int cloud_codec_decode_response(char *input, struct cloud_data_cfg *cfg);
 
+#if defined(CONFIG_CLOUD_CODEC_SEQ)
+int cloud_codec_decode_ack(char *input, struct cloud_data_ack *ack);
+#endif
+
 int cloud_codec_encode_cfg_data(struct cloud_msg *output,
 				struct cloud_data_cfg *cfg_buffer);
 
-int cloud_codec_encode_data(struct cloud_msg *output,
-			    struct cloud_data_gps *gps_buf,
-			    struct cloud_data_sensors *sensor_buf,
-			    struct cloud_data_modem *modem_buf,
-			    struct cloud_data_ui *ui_buf,
-			    struct cloud_data_accelerometer *accel_buf,
-			    struct cloud_data_battery *bat_buf,
-			    enum cloud_data_encode_schema encode_schema);
-
-int cloud_codec_encode_gps_buffer(struct cloud_msg *output,
-				  struct cloud_data_gps *data);
+int cloud_codec_encode_agps_request(struct cloud_msg *output,
+				    struct gps_agps_request *request);
 
-int cloud_codec_encode_modem_buffer(struct cloud_msg *output,
-				    struct cloud_data_modem *data);
+int cloud_codec_encode_health(struct cloud_msg *output,
+			      struct cloud_data_health *data);
 
-int cloud_codec_encode_sensor_buffer(struct cloud_msg *output,
-				     struct cloud_data_sensors *data);
-
-int cloud_codec_encode_ui_buffer(struct cloud_msg *output,
-				 struct cloud_data_ui *data);
+#if defined(CONFIG_POWER_TIMELINE)
+/**
+ * @brief Encode a modem power summary.
+ *
+ * @param output Encoded message.
+ * @param summary Summary of a cycle or a day.
+ * @param daily True for a daily summary.
+ */
+int cloud_codec_encode_power(struct cloud_msg *output,
+			     const struct power_timeline_summary *summary,
+			     bool daily);
+#endif
 
-int cloud_codec_encode_accel_buffer(struct cloud_msg *output,
-				    struct cloud_data_accelerometer *data);
+#if defined(CONFIG_METRICS)
+/**
+ * @brief Encode the non-zero counters and histograms of a metrics snapshot.
+ *
+ * @return 0 on success, -EAGAIN if there is nothing to report.
+ */
+int cloud_codec_encode_metrics(struct cloud_msg *output,
+			       const struct metrics_snapshot *snapshot);
+#endif
 
-int cloud_codec_encode_bat_buffer(struct cloud_msg *output,
-				    struct cloud_data_battery *data);
+/* cloud_codec_encode_data(), the batch encoders and the encode schema bits
+ * are generated from schema.yaml, as well as the
+ * cloud_codec_<name>_buffer_commit() functions. An encoder only marks the
+ * entries it encodes, the commit function of each buffer has to be called
+ * with the outcome of queueing the message: the marked entries are then
+ * dequeued, or left queued for the next attempt.
+ */
+#include "cloud_codec_schema.h"
 
-static inline void cloud_codec_release_data(struct cloud_msg *output)
-{
-	free(output->buf);
-}
+/** @brief Free the buffer of an encoded message. */
+void cloud_codec_release_data(struct cloud_msg *output);
 
 #ifdef __cplusplus
 }
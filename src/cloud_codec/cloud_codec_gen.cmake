@@ -0,0 +1,28 @@
+#
+# Copyright (c) 2020 Nordic Semiconductor
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+#
+
+# Generates the schema header and encoders from schema.yaml, also used by
+# the tests that include cloud_codec.h.
+
+set(CLOUD_CODEC_DIR ${CMAKE_CURRENT_LIST_DIR})
+set(CLOUD_CODEC_GEN_DIR ${CMAKE_CURRENT_BINARY_DIR}/generated)
+set(CLOUD_CODEC_GEN_OUTPUTS
+    ${CLOUD_CODEC_GEN_DIR}/cloud_codec_schema.h
+    ${CLOUD_CODEC_GEN_DIR}/cloud_codec_encoders.inc)
+
+add_custom_command(
+  OUTPUT ${CLOUD_CODEC_GEN_OUTPUTS}
+  COMMAND ${PYTHON_EXECUTABLE} ${CLOUD_CODEC_DIR}/gen_encoders.py
+          --schema ${CLOUD_CODEC_DIR}/schema.yaml
+          --output-dir ${CLOUD_CODEC_GEN_DIR}
+  DEPENDS ${CLOUD_CODEC_DIR}/gen_encoders.py
+          ${CLOUD_CODEC_DIR}/schema.yaml
+  COMMENT "Generating cloud codec encoders"
+)
+add_custom_target(cloud_codec_gen DEPENDS ${CLOUD_CODEC_GEN_OUTPUTS})
+add_dependencies(app cloud_codec_gen)
+
+zephyr_include_directories(${CLOUD_CODEC_DIR} ${CLOUD_CODEC_GEN_DIR})
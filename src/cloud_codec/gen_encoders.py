@@ -0,0 +1,448 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2020 Nordic Semiconductor ASA
+#
+# SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+#
+
+"""Generate the telemetry encoders of the cloud codec from schema.yaml.
+
+Writes cloud_codec_schema.h, with the encode schema bits and the encoder
+prototypes, and cloud_codec_encoders.inc, with the encoders. The latter is
+included by cloud_codec.c and uses its JSON helpers.
+"""
+
+import argparse
+import os
+import sys
+
+import yaml
+
+HEADER = '''/*
+ * Generated by gen_encoders.py from {schema}, do not edit.
+ */
+'''
+
+FIELD_TYPES = {
+    'int': 'json_add_int',
+    'fixed': 'json_add_fixed',
+    'string': 'json_add_str',
+    'bool': 'json_add_bool',
+}
+
+
+# NUMBER_FORMAT_DECIMALS_MAX of number_format.h.
+DECIMALS_MAX = 9
+
+
+# Keys that stay as they are with the key dictionary, the backend finds the
+# dictionary version through them.
+DICT_ANCHORS = ('dev', 'dict')
+
+# Full key to short key, from the dictionary of the schema.
+short_keys = {}
+
+
+class SchemaError(Exception):
+    pass
+
+
+def dictionary_parse(schema):
+    dictionary = schema.get('dictionary')
+    if dictionary is None:
+        return 0, {}
+    keys = {str(k): str(v) for k, v in dictionary['keys'].items()}
+    for anchor in DICT_ANCHORS:
+        if anchor in keys:
+            raise SchemaError('dictionary: {} can not be shortened'.format(
+                anchor))
+    shorts = list(keys.values())
+    for short in shorts:
+        if shorts.count(short) > 1:
+            raise SchemaError('dictionary: {} used twice'.format(short))
+    return int(dictionary['version']), keys
+
+
+def key(full):
+    """C expression of a key, shortened with the key dictionary."""
+    if full in short_keys:
+        return 'SCHEMA_KEY("{}", "{}")'.format(full, short_keys[full])
+    return '"{}"'.format(full)
+
+
+def field_parse(stream, key, field):
+    if isinstance(field, str):
+        field = {'expr': field}
+    if 'expr' not in field:
+        raise SchemaError('{}.{}: no expr'.format(stream, key))
+    field.setdefault('type', 'int')
+    if field['type'] not in FIELD_TYPES:
+        raise SchemaError('{}.{}: unknown type {}'.format(
+            stream, key, field['type']))
+    if (field['type'] == 'fixed') != ('decimals' in field):
+        raise SchemaError('{}.{}: decimals go with type fixed'.format(
+            stream, key))
+    decimals = field.get('decimals', 0)
+    if isinstance(decimals, int) and not 0 <= decimals <= DECIMALS_MAX:
+        raise SchemaError('{}.{}: at most {} decimals'.format(
+            stream, key, DECIMALS_MAX))
+    return field
+
+
+def streams_parse(schema):
+    streams = []
+    for key, stream in schema['streams'].items():
+        for required in ('struct', 'ts'):
+            if required not in stream:
+                raise SchemaError('{}: no {}'.format(key, required))
+        if ('value' in stream) == ('values' in stream):
+            raise SchemaError('{}: needs either value or values'.format(key))
+        stream['key'] = key
+        stream.setdefault('name', key)
+        stream.setdefault('seq', True)
+        stream.setdefault('consume', True)
+        stream.setdefault('root', False)
+        if stream['consume'] and 'buffer' not in stream:
+            raise SchemaError('{}: consumed entries need a buffer'.format(
+                key))
+        if 'value' in stream:
+            stream['value'] = field_parse(key, 'v', stream['value'])
+        else:
+            stream['values'] = {k: field_parse(key, k, v)
+                                for k, v in stream['values'].items()}
+        streams.append(stream)
+    return streams
+
+
+def guard_open(out, stream):
+    if 'depends' in stream:
+        out.append('#if defined({})'.format(stream['depends']))
+
+
+def guard_close(out, stream):
+    if 'depends' in stream:
+        out.append('#endif')
+
+
+def field_add(out, parent, name, field):
+    args = [parent, key(name), field['expr']]
+    if field['type'] == 'fixed':
+        args.append(str(field['decimals']))
+    call = '\terr += {}({});'.format(FIELD_TYPES[field['type']],
+                                    ', '.join(args))
+    if 'if' in field:
+        out.append('\tif ({}) {{'.format(field['if']))
+        out.append('\t' + call)
+        out.append('\t}')
+    else:
+        out.append(call)
+
+
+def entry_add_gen(out, s):
+    scalar = 'value' in s
+    out.append('static int {}_entry_add(cJSON *parent, bool buffered_entry,'
+               .format(s['key']))
+    out.append('\t\t\tstruct {} *data)'.format(s['struct']))
+    out.append('{')
+    out.append('\tint err;')
+    out.append('\ts64_t ts = data->{};'.format(s['ts']))
+    out.append('\tcJSON *entry_obj;')
+    if not scalar:
+        out.append('\tcJSON *val_obj;')
+    out.append('')
+    out.append('\tif (!data->queued) {')
+    out.append('\t\tLOG_INF("Head of {} buffer not indexing a queued entry");'
+               .format(s['key']))
+    out.append('\t\treturn 0;')
+    out.append('\t}')
+    out.append('')
+    out.append('\terr = date_time_uptime_to_unix_time_ms(&ts);')
+    out.append('\tif (err) {')
+    out.append('\t\tLOG_ERR("date_time_uptime_to_unix_time_ms, error: %d", '
+               'err);')
+    out.append('\t\treturn err;')
+    out.append('\t}')
+    out.append('')
+    out.append('\tentry_obj = cJSON_CreateObject();')
+    if scalar:
+        out.append('\tif (entry_obj == NULL) {')
+    else:
+        out.append('\tval_obj = cJSON_CreateObject();')
+        out.append('\tif (entry_obj == NULL || val_obj == NULL) {')
+        out.append('\t\tcJSON_Delete(val_obj);')
+    out.append('\t\tcJSON_Delete(entry_obj);')
+    out.append('\t\treturn -ENOMEM;')
+    out.append('\t}')
+    out.append('')
+    if scalar:
+        field_add(out, 'entry_obj', 'v', s['value'])
+    else:
+        for name, field in s['values'].items():
+            field_add(out, 'val_obj', name, field)
+        out.append('\terr += json_add_obj(entry_obj, {}, val_obj);'.format(
+            key('v')))
+    out.append('\terr += json_add_int(entry_obj, {}, ts);'.format(key('ts')))
+    if s['seq']:
+        out.append('\terr += seq_add(entry_obj, {}, data->seq);'.format(
+            key('seq')))
+    out.append('\terr += entry_attach(parent, {}, entry_obj, '
+               'buffered_entry);'.format(key(s['key'])))
+    if s['consume']:
+        out.append('\tdata->encoded = true;')
+    out.append('')
+    out.append('\treturn err;')
+    out.append('}')
+
+
+def buffer_encoder_proto(s):
+    return ('int cloud_codec_encode_{}_buffer(struct cloud_msg *output,\n'
+            '\t\t\tstruct {} *data)'.format(s['name'], s['struct']))
+
+
+def buffer_commit_proto(s):
+    return ('void cloud_codec_{}_buffer_commit(struct {} *data,\n'
+            '\t\t\tbool queued)'.format(s['name'], s['struct']))
+
+
+def buffer_commit_gen(out, s):
+    out.append(buffer_commit_proto(s))
+    out.append('{')
+    out.append('\tfor (int i = 0; i < {}; i++) {{'.format(s['buffer']))
+    out.append('\t\tif (!data[i].encoded) {')
+    out.append('\t\t\tcontinue;')
+    out.append('\t\t}')
+    out.append('')
+    out.append('\t\tdata[i].encoded = false;')
+    out.append('')
+    out.append('\t\tif (queued) {')
+    out.append('\t\t\tdata[i].queued = false;')
+    if s['seq']:
+        out.append('\t\t\tdata[i].unacked = '
+                   'IS_ENABLED(CONFIG_CLOUD_CODEC_SEQ);')
+    out.append('\t\t}')
+    out.append('\t}')
+    out.append('}')
+
+
+def site_wrapper_gen(out, proto, impl, args, hist):
+    # Public encoders account their allocations to the codec and record
+    # how long they take.
+    out.append(proto)
+    out.append('{')
+    out.append('\tint err;')
+    out.append('\tu32_t start = k_uptime_get_32();')
+    out.append('')
+    out.append('\theap_monitor_site_enter(HEAP_MONITOR_SITE_CODEC);')
+    line = '\terr = {}('.format(impl)
+    for i, arg in enumerate(args):
+        arg += ');' if i == len(args) - 1 else ','
+        if len(line.expandtabs()) + len(arg) + 1 > 80:
+            out.append(line)
+            line = '\t\t' + arg
+        else:
+            line += (' ' if i > 0 else '') + arg
+    out.append(line)
+    out.append('\theap_monitor_site_exit();')
+    out.append('')
+    out.append('\tmetrics_record({}, k_uptime_get_32() - start);'.format(
+        hist))
+    out.append('')
+    out.append('\treturn err;')
+    out.append('}')
+
+
+def buffer_encoder_gen(out, s):
+    out.append('static int {}_buffer_encode(struct cloud_msg *output,\n'
+               '\t\t\t\tstruct {} *data)'.format(s['key'], s['struct']))
+    out.append('{')
+    out.append('\tint err = 0;')
+    out.append('\tint idx[CONFIG_ENCODED_BUFFER_ENTRIES_MAX];')
+    out.append('\tint idx_cnt;')
+    out.append('\tcJSON *root_obj = cJSON_CreateObject();')
+    out.append('\tcJSON *array_obj = cJSON_CreateArray();')
+    out.append('')
+    out.append('\tif (root_obj == NULL || array_obj == NULL) {')
+    out.append('\t\tcJSON_Delete(root_obj);')
+    out.append('\t\tcJSON_Delete(array_obj);')
+    out.append('\t\treturn -ENOMEM;')
+    out.append('\t}')
+    out.append('')
+    out.append('\tidx_cnt = BUFFER_SELECT(data, {}, {}, idx);'.format(
+        s['buffer'], s['ts']))
+    out.append('')
+    out.append('\tfor (int i = 0; i < idx_cnt; i++) {')
+    out.append('\t\terr += {}_entry_add(array_obj, true, &data[idx[i]]);'
+               .format(s['key']))
+    out.append('\t}')
+    out.append('')
+    out.append('\terr += json_add_obj(root_obj, {}, array_obj);'.format(
+        key(s['key'])))
+    out.append('')
+    out.append('\treturn message_print(root_obj, output, err);')
+    out.append('}')
+    out.append('')
+    site_wrapper_gen(out, buffer_encoder_proto(s),
+                     '{}_buffer_encode'.format(s['key']), ['output', 'data'],
+                     'METRICS_HIST_ENCODE_BATCH')
+
+
+def data_args(streams):
+    args = []
+    for s in streams:
+        if 'arg' in s and (s['arg'], s['struct']) not in args:
+            args.append((s['arg'], s['struct']))
+    return args
+
+
+def data_encoder_proto(streams, name='int cloud_codec_encode_data',
+                       indent='\t\t\t'):
+    params = ['struct cloud_msg *output']
+    params += ['struct {} *{}'.format(struct, arg)
+               for arg, struct in data_args(streams)]
+    params.append('u32_t encode_schema')
+    return '{}({})'.format(name, (',\n' + indent).join(params))
+
+
+def data_encoder_gen(out, streams):
+    out.append(data_encoder_proto(streams, 'static int data_encode',
+                                  '\t\t       '))
+    out.append('{')
+    out.append('\tint err = 0;')
+    out.append('\tcJSON *root_obj = cJSON_CreateObject();')
+    out.append('\tcJSON *state_obj = cJSON_CreateObject();')
+    out.append('\tcJSON *rep_obj = cJSON_CreateObject();')
+    out.append('')
+    out.append('\tif (root_obj == NULL || state_obj == NULL || '
+               'rep_obj == NULL) {')
+    out.append('\t\tcJSON_Delete(root_obj);')
+    out.append('\t\tcJSON_Delete(state_obj);')
+    out.append('\t\tcJSON_Delete(rep_obj);')
+    out.append('\t\treturn -ENOMEM;')
+    out.append('\t}')
+
+    # Arguments whose streams are all compiled out by the same option are
+    # marked unused after the last of them.
+    users_of = {}
+    for s in streams:
+        if 'arg' in s:
+            users_of.setdefault(s['arg'], []).append(s)
+
+    for s in streams:
+        if 'arg' not in s:
+            continue
+        out.append('')
+        guard_open(out, s)
+        out.append('\tif (encode_schema & CLOUD_DATA_ENCODE_{}) {{'.format(
+            s['key'].upper()))
+        out.append('\t\terr += {}_entry_add({}, false, {});'.format(
+            s['key'], 'root_obj' if s['root'] else 'rep_obj', s['arg']))
+        out.append('\t}')
+        users = users_of[s['arg']]
+        if 'depends' in s and s is users[-1] and \
+                all(u.get('depends') == s['depends'] for u in users):
+            out.append('#else')
+            out.append('\tARG_UNUSED({});'.format(s['arg']))
+        guard_close(out, s)
+
+    out.append('')
+    out.append('\terr += reported_attach(root_obj, state_obj, rep_obj);')
+    out.append('')
+    out.append('\treturn message_print(root_obj, output, err);')
+    out.append('}')
+    out.append('')
+    site_wrapper_gen(out, data_encoder_proto(streams), 'data_encode',
+                     ['output'] + [arg for arg, _ in data_args(streams)] +
+                     ['encode_schema'], 'METRICS_HIST_ENCODE_DATA')
+
+
+def header_gen(streams, dict_version, schema_name):
+    out = [HEADER.format(schema=schema_name)]
+    out.append('#ifndef CLOUD_CODEC_SCHEMA_H__')
+    out.append('#define CLOUD_CODEC_SCHEMA_H__')
+    out.append('')
+    out.append('/** Version of the key dictionary, reported in the dev entry. */')
+    out.append('#define CLOUD_CODEC_KEY_DICT_VERSION {}'.format(dict_version))
+    out.append('')
+    out.append('/** Streams encoded by cloud_codec_encode_data(), combined '
+               'as a bitmask. */')
+    bit = 0
+    for s in streams:
+        if 'arg' in s:
+            out.append('#define CLOUD_DATA_ENCODE_{} BIT({})'.format(
+                s['key'].upper(), bit))
+            bit += 1
+    out.append('')
+    out.append(data_encoder_proto(streams) + ';')
+    for s in streams:
+        if 'buffer' not in s:
+            continue
+        out.append('')
+        guard_open(out, s)
+        out.append(buffer_encoder_proto(s) + ';')
+        if s['consume']:
+            out.append(buffer_commit_proto(s) + ';')
+        guard_close(out, s)
+    out.append('')
+    out.append('#endif /* CLOUD_CODEC_SCHEMA_H__ */')
+    return '\n'.join(out) + '\n'
+
+
+def encoders_gen(streams, schema_name):
+    out = [HEADER.format(schema=schema_name)]
+    out.append('#if defined(CONFIG_CLOUD_CODEC_KEY_DICT)')
+    out.append('#define SCHEMA_KEY(full, short) short')
+    out.append('#else')
+    out.append('#define SCHEMA_KEY(full, short) full')
+    out.append('#endif')
+    out.append('')
+    for s in streams:
+        guard_open(out, s)
+        entry_add_gen(out, s)
+        if 'buffer' in s:
+            out.append('')
+            buffer_encoder_gen(out, s)
+        if s['consume']:
+            out.append('')
+            buffer_commit_gen(out, s)
+        guard_close(out, s)
+        out.append('')
+    data_encoder_gen(out, streams)
+    return '\n'.join(out) + '\n'
+
+
+def file_write(path, content):
+    # Unchanged outputs are left alone so that dependents are not rebuilt.
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.read() == content:
+                return
+    with open(path, 'w') as f:
+        f.write(content)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--schema', required=True)
+    parser.add_argument('--output-dir', required=True)
+    args = parser.parse_args()
+
+    with open(args.schema) as f:
+        schema = yaml.safe_load(f)
+
+    try:
+        dict_version, keys = dictionary_parse(schema)
+        streams = streams_parse(schema)
+    except SchemaError as err:
+        sys.exit('{}: {}'.format(args.schema, err))
+
+    short_keys.update(keys)
+    schema_name = os.path.basename(args.schema)
+    os.makedirs(args.output_dir, exist_ok=True)
+    file_write(os.path.join(args.output_dir, 'cloud_codec_schema.h'),
+               header_gen(streams, dict_version, schema_name))
+    file_write(os.path.join(args.output_dir, 'cloud_codec_encoders.inc'),
+               encoders_gen(streams, schema_name))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <errno.h>
+#include "number_format.h"
+
+static const u32_t pow10[NUMBER_FORMAT_DECIMALS_MAX + 1] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+	1000000000
+};
+
+/* Writes the digits of value, least significant first, and returns their
+ * count. 64-bit division is a library call on the target, so it is only
+ * used until the value fits 32 bits.
+ */
+static int digits_reversed(char *out, u64_t value)
+{
+	u32_t value32;
+	int n = 0;
+
+	while (value > UINT32_MAX) {
+		out[n++] = '0' + (char)(value % 10);
+		value /= 10;
+	}
+
+	value32 = (u32_t)value;
+
+	do {
+		out[n++] = '0' + (char)(value32 % 10);
+		value32 /= 10;
+	} while (value32 != 0);
+
+	return n;
+}
+
+int number_format_fixed(char *buf, size_t size, s64_t scaled, int decimals)
+{
+	char digits[20];
+	u64_t magnitude;
+	int first = 0;
+	int last;
+	int len = 0;
+
+	if (decimals < 0 || decimals > NUMBER_FORMAT_DECIMALS_MAX) {
+		return -EINVAL;
+	}
+
+	/* Negated unsigned, INT64_MIN has no positive counterpart. */
+	magnitude = scaled < 0 ? 0 - (u64_t)scaled : (u64_t)scaled;
+	last = digits_reversed(digits, magnitude) - 1;
+
+	if (magnitude == 0) {
+		decimals = 0;
+	}
+
+	/* Fraction digits that are trailing zeros are not printed. */
+	while (decimals > 0 && digits[first] == '0') {
+		first++;
+		decimals--;
+	}
+
+	/* Zeros between the point and the first significant digit. */
+	while (last - first < decimals) {
+		digits[++last] = '0';
+	}
+
+	if (size < (size_t)(last - first + 2 + (decimals > 0) + (scaled < 0))) {
+		return -ENOMEM;
+	}
+
+	if (scaled < 0) {
+		buf[len++] = '-';
+	}
+
+	for (int i = last; i >= first; i--) {
+		buf[len++] = digits[i];
+
+		if (i - first == decimals && decimals > 0) {
+			buf[len++] = '.';
+		}
+	}
+
+	buf[len] = '\0';
+
+	return len;
+}
+
+int number_format_int(char *buf, size_t size, s64_t value)
+{
+	return number_format_fixed(buf, size, value, 0);
+}
+
+s64_t number_scale(double value, int decimals)
+{
+	double scaled;
+
+	decimals = MAX(MIN(decimals, NUMBER_FORMAT_DECIMALS_MAX), 0);
+	scaled = value * pow10[decimals];
+
+	return (s64_t)(scaled < 0 ? scaled - 0.5 : scaled + 0.5);
+}
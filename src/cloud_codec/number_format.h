@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *@brief Decimal number formatting for the cloud codec.
+ */
+
+#ifndef NUMBER_FORMAT_H__
+#define NUMBER_FORMAT_H__
+
+#include <zephyr/types.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Largest number of decimals of a fixed-decimal number. */
+#define NUMBER_FORMAT_DECIMALS_MAX 9
+
+/** Buffer size fitting any formatted number, sign, point and NUL
+ *  included.
+ */
+#define NUMBER_FORMAT_LEN_MAX 22
+
+/**
+ * @brief Format an integer in decimal.
+ *
+ * @param buf Output buffer, NUL-terminated on success.
+ * @param size Size of the output buffer.
+ * @param value Value to format.
+ *
+ * @return Length of the formatted number, or -ENOMEM if it does not fit.
+ */
+int number_format_int(char *buf, size_t size, s64_t value);
+
+/**
+ * @brief Format a fixed-decimal number, scaled / 10^decimals.
+ *
+ * Trailing zeros of the fraction are left out, as is the point when the
+ * fraction is zero.
+ *
+ * @param buf Output buffer, NUL-terminated on success.
+ * @param size Size of the output buffer.
+ * @param scaled Value multiplied by 10^decimals.
+ * @param decimals Number of decimals, at most NUMBER_FORMAT_DECIMALS_MAX.
+ *
+ * @return Length of the formatted number, -ENOMEM if it does not fit or
+ *	   -EINVAL if decimals is out of range.
+ */
+int number_format_fixed(char *buf, size_t size, s64_t scaled, int decimals);
+
+/**
+ * @brief Scale a value by 10^decimals, rounded to the nearest integer.
+ *
+ * @param value Value to scale.
+ * @param decimals Number of decimals, clamped to
+ *		   [0, NUMBER_FORMAT_DECIMALS_MAX].
+ *
+ * @return Scaled value.
+ */
+s64_t number_scale(double value, int decimals);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* NUMBER_FORMAT_H__ */
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include "seq_ranges.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(seq_ranges, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+static bool seq_in_ranges(u32_t seq,
+			  const struct cloud_data_seq_range *ranges, int cnt)
+{
+	for (int i = 0; i < cnt; i++) {
+		if (seq >= ranges[i].first && seq <= ranges[i].last) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int seq_ranges_apply(u32_t *seq, bool *unacked, bool *queued, size_t size,
+		     size_t count, const struct cloud_data_ack *ack,
+		     enum cloud_data_stream stream)
+{
+	int resend_cnt = 0;
+	/* A single range may span all 2^32 sequence numbers. */
+	u64_t nack_cnt = 0;
+
+	for (int i = 0; i < ack->nack_cnt[stream]; i++) {
+		nack_cnt += (u64_t)ack->nack[stream][i].last -
+			    ack->nack[stream][i].first + 1;
+	}
+
+	for (int i = 0; i < count; i++) {
+		u32_t entry_seq = *(u32_t *)((u8_t *)seq + i * size);
+		bool *entry_unacked = (bool *)((u8_t *)unacked + i * size);
+		bool *entry_queued = (bool *)((u8_t *)queued + i * size);
+
+		if (!*entry_unacked) {
+			continue;
+		}
+
+		if (seq_in_ranges(entry_seq, ack->nack[stream],
+				  ack->nack_cnt[stream])) {
+			*entry_unacked = false;
+			*entry_queued = true;
+			resend_cnt++;
+		} else if (seq_in_ranges(entry_seq, ack->ack[stream],
+					 ack->ack_cnt[stream])) {
+			*entry_unacked = false;
+		}
+	}
+
+	if (nack_cnt > resend_cnt) {
+		LOG_WRN("%u missing entries of stream %d are no longer buffered",
+			(u32_t)MIN(nack_cnt - resend_cnt, UINT32_MAX), stream);
+	}
+
+	return resend_cnt;
+}
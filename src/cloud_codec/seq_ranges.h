@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *@brief Application of acknowledged and missing sequence number ranges.
+ */
+
+#ifndef SEQ_RANGES_H__
+#define SEQ_RANGES_H__
+
+#include <zephyr.h>
+#include "cloud_codec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_CLOUD_CODEC_SEQ)
+/** Applies the ranges reported for a stream to the entries of its buffer. */
+#define SEQ_RANGES_APPLY(buf, ack, stream)                                     \
+	seq_ranges_apply(&(buf)[0].seq, &(buf)[0].unacked, &(buf)[0].queued,   \
+			 sizeof((buf)[0]), ARRAY_SIZE(buf), ack, stream)
+
+/**
+ * @brief Forget acknowledged entries and queue missing entries again.
+ *
+ * Only entries waiting for an acknowledgment are looked at. The members
+ * are given by their address in the first entry and the entry size.
+ *
+ * @param seq Sequence number of the first entry.
+ * @param unacked Unacknowledged flag of the first entry.
+ * @param queued Queued flag of the first entry.
+ * @param size Size of an entry.
+ * @param count Number of entries.
+ * @param ack Decoded acknowledgment.
+ * @param stream Stream of the entries.
+ *
+ * @return Number of entries queued again.
+ */
+int seq_ranges_apply(u32_t *seq, bool *unacked, bool *queued, size_t size,
+		     size_t count, const struct cloud_data_ack *ack,
+		     enum cloud_data_stream stream);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* SEQ_RANGES_H__ */
@@ -0,0 +1,525 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <net/socket.h>
+#include <net/cloud.h>
+#include <cloud_codec.h>
+#include <metrics.h>
+#include <power_timeline.h>
+#include <flight_recorder.h>
+
+#include "cloud_io.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(cloud_io, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+#define TX_QUEUE_LEN_TOTAL                                                     \
+	(CONFIG_CLOUD_IO_QUEUE_ALERT_LEN + CONFIG_CLOUD_IO_QUEUE_LIVE_LEN +    \
+	 CONFIG_CLOUD_IO_QUEUE_CONFIG_LEN)
+
+K_MSGQ_DEFINE(tx_msgq_alert, sizeof(struct cloud_msg),
+	      CONFIG_CLOUD_IO_QUEUE_ALERT_LEN, 4);
+K_MSGQ_DEFINE(tx_msgq_live, sizeof(struct cloud_msg),
+	      CONFIG_CLOUD_IO_QUEUE_LIVE_LEN, 4);
+K_MSGQ_DEFINE(tx_msgq_config, sizeof(struct cloud_msg),
+	      CONFIG_CLOUD_IO_QUEUE_CONFIG_LEN, 4);
+K_MSGQ_DEFINE(tx_msgq_backlog, sizeof(struct cloud_msg),
+	      CONFIG_CLOUD_IO_QUEUE_BACKLOG_LEN, 4);
+
+static struct k_msgq *const tx_msgq[CLOUD_IO_PRIO_COUNT] = {
+	[CLOUD_IO_PRIO_ALERT] = &tx_msgq_alert,
+	[CLOUD_IO_PRIO_LIVE] = &tx_msgq_live,
+	[CLOUD_IO_PRIO_CONFIG] = &tx_msgq_config,
+	[CLOUD_IO_PRIO_BACKLOG] = &tx_msgq_backlog,
+};
+
+/** Counts the messages in all queues but the backlog queue. */
+K_SEM_DEFINE(tx_sem, 0, TX_QUEUE_LEN_TOTAL);
+/** Counts the messages in the backlog queue, which is paced, and the held
+ *  message.
+ */
+K_SEM_DEFINE(backlog_sem, 0, CONFIG_CLOUD_IO_QUEUE_BACKLOG_LEN + 1);
+/** Given by the socket watcher when the socket has pending events. */
+K_SEM_DEFINE(rx_sem, 0, 1);
+/** Given by the I/O thread to let the watcher wait for the next event. */
+K_SEM_DEFINE(watch_sem, 0, 1);
+
+static int watch_fd;
+static short watch_revents;
+/** True while the watcher polls the socket, only used by the I/O thread. */
+static bool watch_busy;
+
+/** Uptime of the last backlog publication. */
+static s64_t backlog_ts;
+
+#if defined(CONFIG_CLOUD_IO_QOS1)
+/** QoS 1 messages published and not yet acknowledged, oldest first. */
+static struct inflight {
+	struct cloud_msg msg;
+	/** Uptime of the last publication. */
+	s64_t ts;
+	/** Number of publications. */
+	int tx_cnt;
+} inflight[CONFIG_CLOUD_IO_INFLIGHT_MAX];
+
+static int inflight_cnt;
+/** Backlog message the backend did not take, published first next time. */
+static struct cloud_msg held;
+static bool held_valid;
+#endif
+
+/* Socket poll() can not be combined with kernel objects in k_poll(), so a
+ * helper thread blocks in poll() and hands the result over to the I/O
+ * thread. The helper never reads from or writes to the socket.
+ */
+static void socket_watch(void)
+{
+	struct pollfd fds[1];
+
+	while (true) {
+		k_sem_take(&watch_sem, K_FOREVER);
+
+		fds[0].fd = watch_fd;
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+
+		if (poll(fds, ARRAY_SIZE(fds), -1) < 0) {
+			LOG_ERR("poll, error: %d", errno);
+			watch_revents = POLLERR;
+		} else {
+			watch_revents = fds[0].revents;
+		}
+
+		k_sem_give(&rx_sem);
+	}
+}
+
+K_THREAD_DEFINE(cloud_io_watch_thread, CONFIG_CLOUD_IO_WATCH_STACKSIZE,
+		socket_watch, NULL, NULL, NULL, CONFIG_CLOUD_POLL_PRIORITY, 0,
+		K_NO_WAIT);
+
+static int socket_event_handle(struct cloud_backend *backend)
+{
+	if ((watch_revents & POLLIN) == POLLIN) {
+		cloud_input(backend);
+	}
+
+	if ((watch_revents & POLLNVAL) == POLLNVAL) {
+		LOG_ERR("Socket error: POLLNVAL");
+		LOG_ERR("The cloud socket was unexpectedly closed.");
+		return -EBADF;
+	}
+
+	if ((watch_revents & POLLHUP) == POLLHUP) {
+		LOG_ERR("Socket error: POLLHUP");
+		LOG_ERR("Connection was closed by the cloud.");
+		return -ECONNRESET;
+	}
+
+	if ((watch_revents & POLLERR) == POLLERR) {
+		LOG_ERR("Socket error: POLLERR");
+		LOG_ERR("Cloud connection was unexpectedly closed.");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int msg_send(struct cloud_backend *backend, struct cloud_msg *msg)
+{
+	int err;
+	u32_t start = k_uptime_get_32();
+	/* An empty state message requests the device configuration. */
+	bool cfg_get = msg->endpoint.type == CLOUD_EP_TOPIC_STATE &&
+		       msg->len == 0;
+
+	power_timeline_activity_mark(cfg_get ? POWER_TIMELINE_CONFIG :
+					       POWER_TIMELINE_PUBLISH);
+
+	err = cloud_send(backend, msg);
+	metrics_record(METRICS_HIST_CLOUD_SEND, k_uptime_get_32() - start);
+	flight_recorder_log(FLIGHT_RECORDER_SEND, msg->endpoint.type, msg->len,
+			    err);
+	if (err) {
+		LOG_ERR("Cloud send failed, err: %d", err);
+		metrics_inc(METRICS_CLOUD_SEND_FAIL);
+	}
+
+	return err;
+}
+
+#if defined(CONFIG_CLOUD_IO_QOS1)
+static bool inflight_full(void)
+{
+	return inflight_cnt == CONFIG_CLOUD_IO_INFLIGHT_MAX;
+}
+
+/** Time left before the oldest in-flight message times out. */
+static s32_t inflight_ack_left(void)
+{
+	if (inflight_cnt == 0) {
+		return K_FOREVER;
+	}
+
+	return MAX(inflight[0].ts + K_SECONDS(CONFIG_CLOUD_IO_ACK_TIMEOUT_SEC) -
+			   k_uptime_get(),
+		   0);
+}
+
+static void inflight_add(const struct cloud_msg *msg, int tx_cnt)
+{
+	struct inflight *entry = &inflight[inflight_cnt++];
+
+	entry->msg = *msg;
+	entry->ts = k_uptime_get();
+	entry->tx_cnt = tx_cnt;
+}
+
+/** Take an entry out of the window, the remaining ones keep their order. */
+static void inflight_remove(int i)
+{
+	inflight_cnt--;
+	memmove(&inflight[i], &inflight[i + 1],
+		(inflight_cnt - i) * sizeof(inflight[0]));
+}
+
+/** Publish the oldest in-flight message again, it moves to the end of the
+ *  window. A message published too often is dropped instead.
+ */
+static void inflight_republish(struct cloud_backend *backend)
+{
+	struct inflight entry = inflight[0];
+
+	inflight_remove(0);
+
+	if (entry.tx_cnt > CONFIG_CLOUD_IO_RETRANSMIT_MAX) {
+		LOG_ERR("Message dropped after %d publications", entry.tx_cnt);
+
+		if (entry.msg.len > 0) {
+			cloud_codec_release_data(&entry.msg);
+		}
+
+		return;
+	}
+
+	/* A failed publication is counted too, the message stays in the
+	 * window until the acknowledgment times out.
+	 */
+	msg_send(backend, &entry.msg);
+	inflight_add(&entry.msg, entry.tx_cnt + 1);
+}
+
+/** Publish the unacknowledged messages of a lost connection again. */
+static void inflight_retransmit(struct cloud_backend *backend)
+{
+	int cnt = inflight_cnt;
+
+	for (int i = 0; i < cnt; i++) {
+		inflight_republish(backend);
+	}
+}
+
+/** The oldest in-flight message was not acknowledged in time. It is
+ *  published again on this connection, until its retransmissions are used
+ *  up and the connection is given up.
+ */
+static int inflight_timeout(struct cloud_backend *backend)
+{
+	if (inflight[0].tx_cnt > CONFIG_CLOUD_IO_RETRANSMIT_MAX) {
+		LOG_ERR("No acknowledgment in %d seconds",
+			CONFIG_CLOUD_IO_ACK_TIMEOUT_SEC);
+		return -ETIMEDOUT;
+	}
+
+	LOG_WRN("No acknowledgment in %d seconds, publishing again",
+		CONFIG_CLOUD_IO_ACK_TIMEOUT_SEC);
+	inflight_republish(backend);
+
+	return 0;
+}
+
+void cloud_io_ack(const struct cloud_msg *msg)
+{
+	for (int i = 0; i < inflight_cnt; i++) {
+		if (inflight[i].msg.buf != msg->buf) {
+			continue;
+		}
+
+		if (inflight[i].msg.len > 0) {
+			cloud_codec_release_data(&inflight[i].msg);
+		}
+
+		inflight_remove(i);
+		flight_recorder_log(FLIGHT_RECORDER_ACK, inflight_cnt, 0, 0);
+		return;
+	}
+
+	/* Publications of the backend itself are acknowledged too. */
+	LOG_DBG("Acknowledgment of a message not in flight");
+}
+
+/** Get the held message, or else the first message of the queue. */
+static int backlog_get(struct cloud_msg *msg)
+{
+	if (held_valid) {
+		*msg = held;
+		held_valid = false;
+		return 0;
+	}
+
+	return k_msgq_get(&tx_msgq_backlog, msg, K_NO_WAIT);
+}
+
+/** Keep a message the backend did not take for the next attempt, unless it
+ *  can never be published.
+ */
+static void backlog_hold(struct cloud_msg *msg, int err)
+{
+	if (err == -EMSGSIZE || err == -EINVAL) {
+		LOG_ERR("Message dropped, error: %d", err);
+		cloud_codec_release_data(msg);
+		return;
+	}
+
+	held = *msg;
+	held_valid = true;
+	k_sem_give(&backlog_sem);
+}
+
+static s32_t backlog_interval(void)
+{
+	return held_valid ? MAX(CONFIG_CLOUD_IO_BACKLOG_INTERVAL_MS,
+				CONFIG_CLOUD_IO_BACKPRESSURE_DELAY_MS) :
+			    CONFIG_CLOUD_IO_BACKLOG_INTERVAL_MS;
+}
+#else
+static bool inflight_full(void)
+{
+	return false;
+}
+
+static s32_t inflight_ack_left(void)
+{
+	return K_FOREVER;
+}
+
+static void inflight_retransmit(struct cloud_backend *backend)
+{
+}
+
+static int inflight_timeout(struct cloud_backend *backend)
+{
+	return 0;
+}
+
+static int backlog_get(struct cloud_msg *msg)
+{
+	return k_msgq_get(&tx_msgq_backlog, msg, K_NO_WAIT);
+}
+
+static s32_t backlog_interval(void)
+{
+	return CONFIG_CLOUD_IO_BACKLOG_INTERVAL_MS;
+}
+#endif /* CONFIG_CLOUD_IO_QOS1 */
+
+/** Publish the first queued message of the classes first to last. */
+static void msg_publish(struct cloud_backend *backend,
+			enum cloud_io_prio first, enum cloud_io_prio last)
+{
+	int err;
+	struct cloud_msg msg;
+
+	for (int i = first; i <= last; i++) {
+		err = (i == CLOUD_IO_PRIO_BACKLOG) ?
+			      backlog_get(&msg) :
+			      k_msgq_get(tx_msgq[i], &msg, K_NO_WAIT);
+		if (err) {
+			continue;
+		}
+
+		err = msg_send(backend, &msg);
+
+		if (i == CLOUD_IO_PRIO_BACKLOG) {
+			backlog_ts = k_uptime_get();
+		}
+
+#if defined(CONFIG_CLOUD_IO_QOS1)
+		/* Kept until acknowledged. A message the backend did not
+		 * take is not in flight, it is tried again after the
+		 * backlog interval.
+		 */
+		if (msg.qos == CLOUD_QOS_AT_LEAST_ONCE) {
+			if (err) {
+				backlog_hold(&msg, err);
+			} else {
+				inflight_add(&msg, 1);
+			}
+
+			return;
+		}
+#endif
+		if (msg.len > 0) {
+			cloud_codec_release_data(&msg);
+		}
+
+		return;
+	}
+}
+
+/** Time left before the next backlog message may be published. */
+static s32_t backlog_pace_left(void)
+{
+	s64_t elapsed = k_uptime_get() - backlog_ts;
+	s32_t interval = backlog_interval();
+
+	if (backlog_ts == 0 || elapsed >= interval) {
+		return 0;
+	}
+
+	return interval - elapsed;
+}
+
+int cloud_io_send(const struct cloud_msg *msg, enum cloud_io_prio prio)
+{
+	int err;
+
+	__ASSERT_NO_MSG(prio < CLOUD_IO_PRIO_COUNT);
+
+	/* The in-flight window and the held message belong to the backlog. */
+	if (msg->qos != CLOUD_QOS_AT_MOST_ONCE &&
+	    (!IS_ENABLED(CONFIG_CLOUD_IO_QOS1) ||
+	     prio != CLOUD_IO_PRIO_BACKLOG)) {
+		return -EINVAL;
+	}
+
+	err = k_msgq_put(tx_msgq[prio], msg, K_NO_WAIT);
+	if (err) {
+		LOG_WRN("Publish queue %d full", prio);
+		return -ENOBUFS;
+	}
+
+	k_sem_give(prio == CLOUD_IO_PRIO_BACKLOG ? &backlog_sem : &tx_sem);
+
+	return 0;
+}
+
+u32_t cloud_io_free_space(enum cloud_io_prio prio)
+{
+	__ASSERT_NO_MSG(prio < CLOUD_IO_PRIO_COUNT);
+
+	return k_msgq_num_free_get(tx_msgq[prio]);
+}
+
+int cloud_io_run(struct cloud_backend *backend)
+{
+	int err;
+	int event_cnt;
+	s32_t keepalive, pace, ack, timeout;
+	struct k_poll_event events[] = {
+		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
+					 K_POLL_MODE_NOTIFY_ONLY, &rx_sem),
+		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
+					 K_POLL_MODE_NOTIFY_ONLY, &tx_sem),
+		/* Must be last, left out while the backlog is paced or the
+		 * in-flight window is full.
+		 */
+		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
+					 K_POLL_MODE_NOTIFY_ONLY, &backlog_sem),
+	};
+
+	/* A watcher left polling by a connection that timed out returns once
+	 * the old socket has been closed.
+	 */
+	if (watch_busy) {
+		k_sem_take(&rx_sem, K_FOREVER);
+	}
+
+	watch_fd = backend->config->socket;
+	watch_busy = true;
+	k_sem_give(&watch_sem);
+
+	inflight_retransmit(backend);
+
+	while (true) {
+		keepalive = cloud_keepalive_time_left(backend);
+		pace = backlog_pace_left();
+		ack = inflight_ack_left();
+
+		if (ack == 0) {
+			err = inflight_timeout(backend);
+			if (err) {
+				return err;
+			}
+
+			continue;
+		}
+
+		timeout = (ack == K_FOREVER) ? keepalive : MIN(keepalive, ack);
+		timeout = (pace > 0) ? MIN(timeout, pace) : timeout;
+		event_cnt = (pace > 0 || inflight_full()) ?
+				    ARRAY_SIZE(events) - 1 :
+				    ARRAY_SIZE(events);
+
+		err = k_poll(events, event_cnt, timeout);
+		if (err == -EAGAIN) {
+			if (timeout != keepalive) {
+				continue;
+			}
+
+			err = cloud_ping(backend);
+			if (err < 0) {
+				LOG_ERR("cloud_ping, error: %d", err);
+				return err;
+			}
+
+			if (err == 0) {
+				power_timeline_activity_mark(
+					POWER_TIMELINE_PING);
+				flight_recorder_log(FLIGHT_RECORDER_PING, 0, 0,
+						    0);
+				LOG_INF("Cloud ping!");
+			}
+
+			continue;
+		}
+
+		if (events[0].state == K_POLL_STATE_SEM_AVAILABLE) {
+			events[0].state = K_POLL_STATE_NOT_READY;
+			k_sem_take(&rx_sem, K_NO_WAIT);
+			watch_busy = false;
+
+			/* The watcher stays idle once the connection is
+			 * lost, until the next call re-arms it.
+			 */
+			err = socket_event_handle(backend);
+			if (err) {
+				return err;
+			}
+
+			watch_busy = true;
+			k_sem_give(&watch_sem);
+		}
+
+		/* Publish one message per wakeup so that incoming data and
+		 * messages of higher classes are handled in between.
+		 */
+		if (events[1].state == K_POLL_STATE_SEM_AVAILABLE) {
+			events[1].state = K_POLL_STATE_NOT_READY;
+			k_sem_take(&tx_sem, K_NO_WAIT);
+			msg_publish(backend, CLOUD_IO_PRIO_ALERT,
+				    CLOUD_IO_PRIO_CONFIG);
+		} else if (event_cnt == ARRAY_SIZE(events) &&
+			   events[2].state == K_POLL_STATE_SEM_AVAILABLE) {
+			events[2].state = K_POLL_STATE_NOT_READY;
+			k_sem_take(&backlog_sem, K_NO_WAIT);
+			msg_publish(backend, CLOUD_IO_PRIO_BACKLOG,
+				    CLOUD_IO_PRIO_BACKLOG);
+		}
+	}
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *@brief Cloud I/O library header.
+ */
+
+#ifndef CLOUD_IO_H__
+#define CLOUD_IO_H__
+
+#include <zephyr.h>
+#include <net/cloud.h>
+
+/**@file
+ *
+ * @defgroup cloud_io Cloud I/O
+ * @brief    Module that serializes all traffic on the cloud connection.
+ *
+ * Producers put encoded messages in bounded per priority queues and the
+ * thread that called cloud_io_run() publishes them, next to servicing
+ * incoming data and keepalive pings. Only that thread touches the cloud
+ * backend while connected.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Message priority classes, lower values are published first. A queued
+ *  message of a higher class is always published before the next message
+ *  of a lower class.
+ */
+enum cloud_io_prio {
+	/** User interaction and alerts, such as geofence events. */
+	CLOUD_IO_PRIO_ALERT,
+	/** Freshly sampled data and requests the device waits for. */
+	CLOUD_IO_PRIO_LIVE,
+	/** Device configuration requests and reports. */
+	CLOUD_IO_PRIO_CONFIG,
+	/** Buffered data, published at most every
+	 *  CONFIG_CLOUD_IO_BACKLOG_INTERVAL_MS.
+	 */
+	CLOUD_IO_PRIO_BACKLOG,
+
+	CLOUD_IO_PRIO_COUNT
+};
+
+/**
+ * @brief Queue a message for publication.
+ *
+ * On success the buffer of the message is owned by the cloud I/O module
+ * and released with cloud_codec_release_data() once it has been published.
+ * Messages with a zero length payload are never released.
+ *
+ * With CONFIG_CLOUD_IO_QOS1 backlog messages may be published with
+ * CLOUD_QOS_AT_LEAST_ONCE. They are then kept until acknowledged, with at
+ * most CONFIG_CLOUD_IO_INFLIGHT_MAX messages in flight. A message the
+ * backend does not take is not in flight, it is published again before the
+ * rest of the backlog.
+ *
+ * @param[in] msg Message to publish.
+ * @param[in] prio Priority of the message.
+ *
+ * @return 0 on success, -ENOBUFS if the queue of the priority is full,
+ *         -EINVAL if the QoS is not supported for the priority. The caller
+ *         keeps ownership of the buffer on failure.
+ */
+int cloud_io_send(const struct cloud_msg *msg, enum cloud_io_prio prio);
+
+/**
+ * @brief Get the number of messages that can be queued without blocking.
+ *
+ * @param[in] prio Priority to check.
+ *
+ * @return Number of free entries in the queue of the priority.
+ */
+u32_t cloud_io_free_space(enum cloud_io_prio prio);
+
+#if defined(CONFIG_CLOUD_IO_QOS1)
+/**
+ * @brief Acknowledge a QoS 1 message in flight.
+ *
+ * Must be called from the cloud event handler on CLOUD_EVT_DATA_SENT. The
+ * backend reports the acknowledged message in the event, or a message the
+ * server rejected for good, it is matched by its buffer, so acknowledgments
+ * may arrive in any order. Acknowledgments of messages not in flight are
+ * ignored.
+ *
+ * @param[in] msg Acknowledged message, evt->data.msg of the event.
+ */
+void cloud_io_ack(const struct cloud_msg *msg);
+#endif
+
+/**
+ * @brief Service a connected cloud backend.
+ *
+ * Publishes queued messages, handles incoming data and keeps the
+ * connection alive. A QoS 1 message that is not acknowledged within
+ * CONFIG_CLOUD_IO_ACK_TIMEOUT_SEC is published again. Returns when the
+ * connection is lost or a QoS 1 message is still not acknowledged after
+ * CONFIG_CLOUD_IO_RETRANSMIT_MAX retransmissions. The backend must then
+ * be disconnected. Queued messages and messages in
+ * flight are published on the next connection.
+ *
+ * The keepalive timeout of a backend may also cover its retransmissions. A
+ * ping that returns a positive value only retransmitted and is not counted
+ * as a keepalive ping.
+ *
+ * @param[in] backend Connected cloud backend.
+ *
+ * @return Negative error code describing why the connection was lost.
+ */
+int cloud_io_run(struct cloud_backend *backend);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
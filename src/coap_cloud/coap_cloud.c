@@ -0,0 +1,821 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <stdio.h>
+#include <string.h>
+#include <net/socket.h>
+#include <net/coap.h>
+#include <net/cloud_backend.h>
+#include <random/rand32.h>
+#if defined(CONFIG_COAP_CLOUD_DTLS)
+#include <net/tls_credentials.h>
+#endif
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(coap_cloud, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+#define TOKEN_LEN 2
+#define STATE_PATH "%s/state"
+#define STATE_PATH_LEN_MAX 48
+
+/** Retransmission state of a confirmable message, RFC 7252 section 4.2. */
+struct exchange {
+	bool active;
+	u16_t id;
+	int retransmit_cnt;
+	s32_t timeout_ms;
+	s64_t timeout_ts;
+};
+
+/** Confirmable request waiting for its acknowledgment. */
+struct pending {
+	struct exchange ex;
+	/** Reported in CLOUD_EVT_DATA_SENT once acknowledged or rejected. */
+	struct cloud_msg msg;
+	size_t len;
+	u8_t buf[CONFIG_COAP_CLOUD_MESSAGE_SIZE];
+};
+
+/** Observed resource, one per endpoint subscription. */
+struct observation {
+	struct cloud_endpoint ep;
+	u16_t token;
+	/** Registration request, rebuilt for every transmission. */
+	struct exchange ex;
+};
+
+static struct pending pending[CONFIG_COAP_CLOUD_PENDING_MAX];
+static struct observation obs[CONFIG_COAP_CLOUD_SUBSCRIPTIONS_MAX];
+static size_t obs_cnt;
+static struct exchange ping_ex;
+
+static const struct cloud_backend *coap_backend;
+static cloud_evt_handler_t evt_handler;
+static char state_path[STATE_PATH_LEN_MAX];
+static int sock = -1;
+static u16_t token_next;
+/** Uptime of the last transmission, drives the keepalive. */
+static s64_t tx_ts;
+
+static u8_t tx_buf[CONFIG_COAP_CLOUD_MESSAGE_SIZE];
+/* Payloads are handed over as strings, one byte is kept for the
+ * terminator.
+ */
+static u8_t rx_buf[CONFIG_COAP_CLOUD_MESSAGE_SIZE + 1];
+
+static void event_notify(struct cloud_event *evt)
+{
+	if (evt_handler != NULL) {
+		evt_handler(coap_backend, evt, NULL);
+	}
+}
+
+static void exchange_start(struct exchange *ex, u16_t id)
+{
+	ex->active = true;
+	ex->id = id;
+	ex->retransmit_cnt = 0;
+	ex->timeout_ms = CONFIG_COAP_CLOUD_ACK_TIMEOUT_MS +
+			 sys_rand32_get() %
+				 (CONFIG_COAP_CLOUD_ACK_TIMEOUT_MS / 2 + 1);
+	ex->timeout_ts = k_uptime_get() + ex->timeout_ms;
+}
+
+/** Returns 1 if the message has to be transmitted again, -ETIMEDOUT once
+ *  the retransmissions are exhausted.
+ */
+static int exchange_check(struct exchange *ex, s64_t now)
+{
+	if (!ex->active || now < ex->timeout_ts) {
+		return 0;
+	}
+
+	if (ex->retransmit_cnt == CONFIG_COAP_CLOUD_MAX_RETRANSMIT) {
+		ex->active = false;
+		return -ETIMEDOUT;
+	}
+
+	ex->retransmit_cnt++;
+	ex->timeout_ms *= 2;
+	ex->timeout_ts = now + ex->timeout_ms;
+
+	return 1;
+}
+
+static s64_t exchange_next(const struct exchange *ex, s64_t next)
+{
+	return ex->active ? MIN(next, ex->timeout_ts) : next;
+}
+
+static void exchanges_clear(void)
+{
+	for (int i = 0; i < ARRAY_SIZE(pending); i++) {
+		pending[i].ex.active = false;
+	}
+
+	for (int i = 0; i < obs_cnt; i++) {
+		obs[i].ex.active = false;
+	}
+
+	ping_ex.active = false;
+}
+
+static int packet_send(const u8_t *buf, size_t len)
+{
+	if (send(sock, buf, len, 0) < 0) {
+		LOG_ERR("send, error: %d", errno);
+		return -errno;
+	}
+
+	tx_ts = k_uptime_get();
+
+	return 0;
+}
+
+/** Append every segment of a topic style path as a Uri-Path option. */
+static int path_append(struct coap_packet *pkt, const char *path, size_t len)
+{
+	int err;
+	size_t start = 0;
+	const u8_t *segment = (const u8_t *)path;
+
+	for (size_t i = 0; i <= len; i++) {
+		if (i < len && path[i] != '/') {
+			continue;
+		}
+
+		if (i > start) {
+			err = coap_packet_append_option(
+				pkt, COAP_OPTION_URI_PATH, segment, i - start);
+			if (err) {
+				return err;
+			}
+		}
+
+		start = i + 1;
+		segment = (const u8_t *)&path[start];
+	}
+
+	return 0;
+}
+
+static int request_build(struct coap_packet *pkt, u8_t *buf, u8_t type,
+			 u8_t method, u16_t id, u16_t token, const char *path,
+			 size_t path_len, bool observe, const char *payload,
+			 size_t payload_len)
+{
+	int err;
+	u8_t token_buf[TOKEN_LEN] = { token >> 8, token & 0xFF };
+
+	err = coap_packet_init(pkt, buf, CONFIG_COAP_CLOUD_MESSAGE_SIZE,
+			       COAP_VERSION_1, type, TOKEN_LEN, token_buf,
+			       method, id);
+	if (err) {
+		return err;
+	}
+
+	/* Options must be appended in the order of their numbers. */
+	if (observe) {
+		err = coap_append_option_int(pkt, COAP_OPTION_OBSERVE, 0);
+		if (err) {
+			return err;
+		}
+	}
+
+	err = path_append(pkt, path, path_len);
+	if (err) {
+		return err;
+	}
+
+	if (payload_len == 0) {
+		return 0;
+	}
+
+	err = coap_append_option_int(pkt, COAP_OPTION_CONTENT_FORMAT,
+				     COAP_CONTENT_FORMAT_APP_JSON);
+	if (err) {
+		return err;
+	}
+
+	err = coap_packet_append_payload_marker(pkt);
+	if (err) {
+		return err;
+	}
+
+	err = coap_packet_append_payload(pkt, (u8_t *)payload, payload_len);
+	if (err) {
+		LOG_ERR("Payload of %d bytes does not fit in a message",
+			payload_len);
+		return -EMSGSIZE;
+	}
+
+	return 0;
+}
+
+/** Send an empty message, used for acknowledgments, resets and pings. */
+static int empty_send(u8_t type, u16_t id)
+{
+	int err;
+	struct coap_packet pkt;
+	u8_t buf[4];
+
+	err = coap_packet_init(&pkt, buf, sizeof(buf), COAP_VERSION_1, type, 0,
+			       NULL, COAP_CODE_EMPTY, id);
+	if (err) {
+		return err;
+	}
+
+	return packet_send(pkt.data, pkt.offset);
+}
+
+static int observation_register(struct observation *o)
+{
+	int err;
+	struct coap_packet pkt;
+
+	err = request_build(&pkt, tx_buf, COAP_TYPE_CON, COAP_METHOD_GET,
+			    o->ex.id, o->token, o->ep.str, o->ep.len, true,
+			    NULL, 0);
+	if (err) {
+		return err;
+	}
+
+	return packet_send(pkt.data, pkt.offset);
+}
+
+static struct observation *
+observation_find_type(enum cloud_endpoint_type type)
+{
+	for (int i = 0; i < obs_cnt; i++) {
+		if (obs[i].ep.type == type) {
+			return &obs[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct observation *observation_find_token(u16_t token)
+{
+	for (int i = 0; i < obs_cnt; i++) {
+		if (obs[i].token == token) {
+			return &obs[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct pending *pending_alloc(void)
+{
+	for (int i = 0; i < ARRAY_SIZE(pending); i++) {
+		if (!pending[i].ex.active) {
+			return &pending[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void connection_close(void)
+{
+	struct cloud_event evt = { .type = CLOUD_EVT_DISCONNECTED };
+
+	if (sock < 0) {
+		return;
+	}
+
+	close(sock);
+	sock = -1;
+	exchanges_clear();
+
+	event_notify(&evt);
+}
+
+static int endpoint_path(const struct cloud_endpoint *ep, const char **path,
+			 size_t *len)
+{
+	if (ep->str != NULL) {
+		*path = ep->str;
+		*len = ep->len;
+		return 0;
+	}
+
+	if (ep->type == CLOUD_EP_TOPIC_MSG) {
+		*path = state_path;
+		*len = strlen(state_path);
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+/** Handle a response or notification matched by its token. */
+static void response_handle(struct coap_packet *pkt, u8_t code)
+{
+	u8_t token_buf[COAP_TOKEN_MAX_LEN];
+	const u8_t *payload;
+	u16_t payload_len;
+	struct observation *o;
+	struct cloud_event evt = { .type = CLOUD_EVT_DATA_RECEIVED };
+
+	if (coap_header_get_token(pkt, token_buf) != TOKEN_LEN) {
+		return;
+	}
+
+	o = observation_find_token((token_buf[0] << 8) | token_buf[1]);
+	if (o == NULL) {
+		return;
+	}
+
+	if ((code >> 5) != 2) {
+		LOG_WRN("Observation of %s failed, code %d.%02d",
+			log_strdup(o->ep.str), code >> 5, code & 0x1F);
+		return;
+	}
+
+	payload = coap_packet_get_payload(pkt, &payload_len);
+	if (payload == NULL || payload_len == 0) {
+		return;
+	}
+
+	/* The payload ends the datagram, the spare byte of the receive
+	 * buffer takes the terminator.
+	 */
+	((u8_t *)payload)[payload_len] = '\0';
+
+	evt.data.msg.buf = (char *)payload;
+	evt.data.msg.len = payload_len;
+	evt.data.msg.endpoint = o->ep;
+
+	event_notify(&evt);
+}
+
+/** Complete the exchange acknowledged or reset by the message id. */
+static void exchange_complete(u16_t id, u8_t type, u8_t code)
+{
+	struct cloud_event evt = { .type = CLOUD_EVT_DATA_SENT };
+
+	if (ping_ex.active && ping_ex.id == id) {
+		/* Servers answer a ping with a reset. */
+		ping_ex.active = false;
+		return;
+	}
+
+	for (int i = 0; i < obs_cnt; i++) {
+		if (obs[i].ex.active && obs[i].ex.id == id) {
+			obs[i].ex.active = false;
+
+			if (type == COAP_TYPE_RESET) {
+				LOG_WRN("Observation of %s refused",
+					log_strdup(obs[i].ep.str));
+			}
+
+			return;
+		}
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(pending); i++) {
+		if (!pending[i].ex.active || pending[i].ex.id != id) {
+			continue;
+		}
+
+		pending[i].ex.active = false;
+
+		/* A server error may pass, the message is published again
+		 * once its acknowledgment times out. A reset or a client
+		 * error would be repeated, so the message is reported as
+		 * sent and dropped.
+		 */
+		if ((code >> 5) == 5) {
+			LOG_WRN("Message %d failed, code %d.%02d", id,
+				code >> 5, code & 0x1F);
+			return;
+		} else if (type == COAP_TYPE_RESET || (code >> 5) == 4) {
+			LOG_ERR("Message %d rejected, code %d.%02d", id,
+				code >> 5, code & 0x1F);
+		}
+
+		evt.data.msg = pending[i].msg;
+		event_notify(&evt);
+
+		return;
+	}
+}
+
+static int coap_cloud_init(const struct cloud_backend *const backend,
+			   cloud_evt_handler_t handler)
+{
+	int err;
+
+	coap_backend = backend;
+	evt_handler = handler;
+
+	err = snprintf(state_path, sizeof(state_path), STATE_PATH,
+		       backend->config->id);
+	if (err < 0 || err >= sizeof(state_path)) {
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int coap_cloud_uninit(const struct cloud_backend *const backend)
+{
+	connection_close();
+	obs_cnt = 0;
+	evt_handler = NULL;
+
+	return 0;
+}
+
+#if defined(CONFIG_COAP_CLOUD_DTLS)
+static int dtls_setup(int fd)
+{
+	int err;
+	int verify = 2;
+	sec_tag_t sec_tag_list[] = { CONFIG_COAP_CLOUD_SEC_TAG };
+
+	err = setsockopt(fd, SOL_TLS, TLS_PEER_VERIFY, &verify,
+			 sizeof(verify));
+	if (err) {
+		return -errno;
+	}
+
+	err = setsockopt(fd, SOL_TLS, TLS_SEC_TAG_LIST, sec_tag_list,
+			 sizeof(sec_tag_list));
+	if (err) {
+		return -errno;
+	}
+
+	err = setsockopt(fd, SOL_TLS, TLS_HOSTNAME,
+			 CONFIG_COAP_CLOUD_SERVER_HOSTNAME,
+			 sizeof(CONFIG_COAP_CLOUD_SERVER_HOSTNAME) - 1);
+	if (err) {
+		return -errno;
+	}
+
+	return 0;
+}
+#endif
+
+static int socket_connect(void)
+{
+	int err;
+	int fd;
+	int proto = IS_ENABLED(CONFIG_COAP_CLOUD_DTLS) ? IPPROTO_DTLS_1_2 :
+							 IPPROTO_UDP;
+	struct addrinfo *res;
+	struct addrinfo hints = {
+		.ai_family = AF_INET,
+		.ai_socktype = SOCK_DGRAM,
+	};
+
+	err = getaddrinfo(CONFIG_COAP_CLOUD_SERVER_HOSTNAME, NULL, &hints,
+			  &res);
+	if (err) {
+		LOG_ERR("getaddrinfo, error: %d", err);
+		return -EHOSTUNREACH;
+	}
+
+	((struct sockaddr_in *)res->ai_addr)->sin_port =
+		htons(CONFIG_COAP_CLOUD_SERVER_PORT);
+
+	fd = socket(AF_INET, SOCK_DGRAM, proto);
+	if (fd < 0) {
+		LOG_ERR("socket, error: %d", errno);
+		err = -errno;
+		goto exit;
+	}
+
+#if defined(CONFIG_COAP_CLOUD_DTLS)
+	err = dtls_setup(fd);
+	if (err) {
+		LOG_ERR("dtls_setup, error: %d", err);
+		close(fd);
+		goto exit;
+	}
+#endif
+
+	/* Runs the DTLS handshake when enabled. */
+	err = connect(fd, res->ai_addr, sizeof(struct sockaddr_in));
+	if (err) {
+		LOG_ERR("connect, error: %d", errno);
+		err = -errno;
+		close(fd);
+		goto exit;
+	}
+
+	err = fd;
+
+exit:
+	freeaddrinfo(res);
+
+	return err;
+}
+
+static int coap_cloud_connect(const struct cloud_backend *const backend)
+{
+	int err;
+	struct cloud_event evt = { .type = CLOUD_EVT_CONNECTED };
+
+	if (sock >= 0) {
+		return -EALREADY;
+	}
+
+	err = socket_connect();
+	if (err < 0) {
+		return err;
+	}
+
+	sock = err;
+	backend->config->socket = sock;
+	tx_ts = k_uptime_get();
+
+	token_next = sys_rand32_get();
+
+	for (int i = 0; i < obs_cnt; i++) {
+		obs[i].token = token_next++;
+		exchange_start(&obs[i].ex, coap_next_id());
+
+		err = observation_register(&obs[i]);
+		if (err) {
+			LOG_ERR("Observation of %s not registered, error: %d",
+				log_strdup(obs[i].ep.str), err);
+		}
+	}
+
+	/* Nothing is kept on the server between connections. */
+	evt.data.persistent_session = false;
+	event_notify(&evt);
+
+	evt.type = CLOUD_EVT_READY;
+	event_notify(&evt);
+
+	return 0;
+}
+
+static int coap_cloud_disconnect(const struct cloud_backend *const backend)
+{
+	if (sock < 0) {
+		return -ENOTCONN;
+	}
+
+	connection_close();
+
+	return 0;
+}
+
+static int coap_cloud_send(const struct cloud_backend *const backend,
+			   const struct cloud_msg *const msg)
+{
+	int err;
+	struct coap_packet pkt;
+	struct pending *p;
+	struct observation *o;
+	const char *path;
+	size_t path_len;
+
+	if (sock < 0) {
+		return -ENOTCONN;
+	}
+
+	/* The configuration is fetched by refreshing its observation, the
+	 * response carries the current state.
+	 */
+	if (msg->endpoint.type == CLOUD_EP_TOPIC_STATE) {
+		o = observation_find_type(CLOUD_EP_TOPIC_CONFIG);
+		if (o == NULL) {
+			return -ENOENT;
+		}
+
+		if (o->ex.active) {
+			return 0;
+		}
+
+		exchange_start(&o->ex, coap_next_id());
+
+		return observation_register(o);
+	}
+
+	err = endpoint_path(&msg->endpoint, &path, &path_len);
+	if (err) {
+		return err;
+	}
+
+	if (msg->qos == CLOUD_QOS_AT_MOST_ONCE) {
+		err = request_build(&pkt, tx_buf, COAP_TYPE_NON_CON,
+				    COAP_METHOD_POST, coap_next_id(),
+				    token_next++, path, path_len, false,
+				    msg->buf, msg->len);
+		if (err) {
+			return err;
+		}
+
+		return packet_send(pkt.data, pkt.offset);
+	}
+
+	p = pending_alloc();
+	if (p == NULL) {
+		LOG_WRN("All %d confirmable messages pending",
+			CONFIG_COAP_CLOUD_PENDING_MAX);
+		return -ENOBUFS;
+	}
+
+	err = request_build(&pkt, p->buf, COAP_TYPE_CON, COAP_METHOD_POST,
+			    coap_next_id(), token_next++, path, path_len, false,
+			    msg->buf, msg->len);
+	if (err) {
+		return err;
+	}
+
+	p->len = pkt.offset;
+	p->msg = *msg;
+	exchange_start(&p->ex, coap_header_get_id(&pkt));
+
+	/* The caller keeps a message that was not sent. */
+	err = packet_send(p->buf, p->len);
+	if (err) {
+		p->ex.active = false;
+	}
+
+	return err;
+}
+
+static int coap_cloud_input(const struct cloud_backend *const backend)
+{
+	int err;
+	ssize_t len;
+	u8_t type, code;
+	u16_t id;
+	struct coap_packet pkt;
+
+	if (sock < 0) {
+		return -ENOTCONN;
+	}
+
+	len = recv(sock, rx_buf, sizeof(rx_buf) - 1, MSG_DONTWAIT);
+	if (len < 0) {
+		return (errno == EAGAIN) ? 0 : -errno;
+	}
+
+	err = coap_packet_parse(&pkt, rx_buf, len, NULL, 0);
+	if (err) {
+		LOG_WRN("Malformed message dropped, error: %d", err);
+		return 0;
+	}
+
+	type = coap_header_get_type(&pkt);
+	code = coap_header_get_code(&pkt);
+	id = coap_header_get_id(&pkt);
+
+	switch (type) {
+	case COAP_TYPE_ACK:
+	case COAP_TYPE_RESET:
+		exchange_complete(id, type, code);
+
+		/* Piggybacked response. */
+		if (type == COAP_TYPE_ACK && code != COAP_CODE_EMPTY) {
+			response_handle(&pkt, code);
+		}
+		break;
+	case COAP_TYPE_CON:
+		empty_send(COAP_TYPE_ACK, id);
+		response_handle(&pkt, code);
+		break;
+	case COAP_TYPE_NON_CON:
+		response_handle(&pkt, code);
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int coap_cloud_ping(const struct cloud_backend *const backend)
+{
+	int err = 0;
+	s64_t now = k_uptime_get();
+
+	if (sock < 0) {
+		return -ENOTCONN;
+	}
+
+	for (int i = 0; i < ARRAY_SIZE(pending) && err >= 0; i++) {
+		err = exchange_check(&pending[i].ex, now);
+		if (err > 0) {
+			packet_send(pending[i].buf, pending[i].len);
+		}
+	}
+
+	for (int i = 0; i < obs_cnt && err >= 0; i++) {
+		err = exchange_check(&obs[i].ex, now);
+		if (err > 0) {
+			observation_register(&obs[i]);
+		}
+	}
+
+	if (err >= 0) {
+		err = exchange_check(&ping_ex, now);
+		if (err > 0) {
+			empty_send(COAP_TYPE_CON, ping_ex.id);
+		}
+	}
+
+	if (err < 0) {
+		LOG_ERR("No acknowledgment after %d retransmissions",
+			CONFIG_COAP_CLOUD_MAX_RETRANSMIT);
+		connection_close();
+		return err;
+	}
+
+	if (!ping_ex.active &&
+	    now - tx_ts >= K_SECONDS(CONFIG_COAP_CLOUD_KEEPALIVE_SEC)) {
+		exchange_start(&ping_ex, coap_next_id());
+		return empty_send(COAP_TYPE_CON, ping_ex.id);
+	}
+
+	/* No keepalive was due, only retransmissions. */
+	return 1;
+}
+
+static int coap_cloud_keepalive_time_left(
+	const struct cloud_backend *const backend)
+{
+	s64_t now = k_uptime_get();
+	s64_t next = tx_ts + K_SECONDS(CONFIG_COAP_CLOUD_KEEPALIVE_SEC);
+
+	for (int i = 0; i < ARRAY_SIZE(pending); i++) {
+		next = exchange_next(&pending[i].ex, next);
+	}
+
+	for (int i = 0; i < obs_cnt; i++) {
+		next = exchange_next(&obs[i].ex, next);
+	}
+
+	next = exchange_next(&ping_ex, next);
+
+	return MAX(next - now, 0);
+}
+
+static int coap_cloud_ep_subscriptions_add(
+	const struct cloud_backend *const backend,
+	const struct cloud_endpoint *const list, size_t list_count)
+{
+	if (obs_cnt + list_count > ARRAY_SIZE(obs)) {
+		return -ENOMEM;
+	}
+
+	for (int i = 0; i < list_count; i++) {
+		if (list[i].str == NULL) {
+			return -EINVAL;
+		}
+	}
+
+	for (int i = 0; i < list_count; i++) {
+		obs[obs_cnt].ep = list[i];
+		obs[obs_cnt].ex.active = false;
+		obs_cnt++;
+	}
+
+	return 0;
+}
+
+static int coap_cloud_ep_subscriptions_remove(
+	const struct cloud_backend *const backend,
+	const struct cloud_endpoint *const list, size_t list_count)
+{
+	for (int i = 0; i < list_count; i++) {
+		for (int j = 0; j < obs_cnt; j++) {
+			if (list[i].str == NULL ||
+			    strcmp(obs[j].ep.str, list[i].str) != 0) {
+				continue;
+			}
+
+			obs[j] = obs[--obs_cnt];
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static const struct cloud_api coap_cloud_api = {
+	.init = coap_cloud_init,
+	.uninit = coap_cloud_uninit,
+	.connect = coap_cloud_connect,
+	.disconnect = coap_cloud_disconnect,
+	.send = coap_cloud_send,
+	.ping = coap_cloud_ping,
+	.keepalive_time_left = coap_cloud_keepalive_time_left,
+	.input = coap_cloud_input,
+	.ep_subscriptions_add = coap_cloud_ep_subscriptions_add,
+	.ep_subscriptions_remove = coap_cloud_ep_subscriptions_remove,
+};
+
+CLOUD_BACKEND_DEFINE(COAP_CLOUD, coap_cloud_api);
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <stdio.h>
+#include "flight_recorder.h"
+
+#if defined(CONFIG_SHELL)
+#include <shell/shell.h>
+#endif
+
+/* Version of the dump format, bumped when the record layout changes. */
+#define DUMP_VERSION 1
+
+#define DUMP_PREFIX "FR:"
+
+/* Timestamps are hardware cycles, cheaper to read than the uptime. The
+ * dump header gives their frequency.
+ */
+struct record {
+	u32_t ts;
+	u16_t id;
+	/* Low bits of the record number, reveals overwrites in a dump. */
+	u16_t seq;
+	s32_t arg[3];
+};
+
+BUILD_ASSERT(sizeof(struct record) == 20);
+
+static struct record ring[CONFIG_FLIGHT_RECORDER_ENTRIES];
+static u32_t written;
+
+void flight_recorder_log(enum flight_recorder_event event, s32_t arg0,
+			 s32_t arg1, s32_t arg2)
+{
+	unsigned int key = irq_lock();
+	struct record *rec = &ring[written % ARRAY_SIZE(ring)];
+
+	rec->ts = k_cycle_get_32();
+	rec->id = event;
+	rec->seq = (u16_t)written;
+	rec->arg[0] = arg0;
+	rec->arg[1] = arg1;
+	rec->arg[2] = arg2;
+	written++;
+
+	irq_unlock(key);
+}
+
+static void printk_print(void *ctx, const char *line)
+{
+	ARG_UNUSED(ctx);
+
+	printk("%s\n", line);
+}
+
+void flight_recorder_dump(flight_recorder_print_t print, void *ctx)
+{
+	static const char hex[] = "0123456789abcdef";
+	char line[sizeof(DUMP_PREFIX) + 2 * sizeof(struct record)];
+	u32_t end = written;
+	u32_t start = end > ARRAY_SIZE(ring) ? end - ARRAY_SIZE(ring) : 0;
+
+	if (print == NULL) {
+		print = printk_print;
+	}
+
+	snprintf(line, sizeof(line), DUMP_PREFIX "BEGIN %d %u %u",
+		 DUMP_VERSION, sys_clock_hw_cycles_per_sec(), end - start);
+	print(ctx, line);
+
+	/* Events recorded during the dump may overwrite the oldest ones,
+	 * the decoder drops records that are out of sequence.
+	 */
+	for (u32_t i = start; i < end; i++) {
+		struct record rec;
+		unsigned int key = irq_lock();
+		const u8_t *bytes = (const u8_t *)&rec;
+		char *pos = line + sizeof(DUMP_PREFIX) - 1;
+
+		rec = ring[i % ARRAY_SIZE(ring)];
+		irq_unlock(key);
+
+		for (int j = 0; j < sizeof(rec); j++) {
+			*pos++ = hex[bytes[j] >> 4];
+			*pos++ = hex[bytes[j] & 0xf];
+		}
+
+		*pos = '\0';
+		print(ctx, line);
+	}
+
+	print(ctx, DUMP_PREFIX "END");
+}
+
+#if defined(CONFIG_SHELL)
+static void shell_line_print(void *ctx, const char *line)
+{
+	shell_print((const struct shell *)ctx, "%s", line);
+}
+
+static int cmd_flight(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	flight_recorder_dump(shell_line_print, (void *)shell);
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(flight, NULL, "Dump the flight recorder", cmd_flight);
+#endif /* CONFIG_SHELL */
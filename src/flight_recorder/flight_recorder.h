@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   Binary trace of timestamped events kept in a RAM ring.
+ */
+
+#ifndef FLIGHT_RECORDER_H__
+#define FLIGHT_RECORDER_H__
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Recorded events, listed in flight_recorder_events.h. */
+enum flight_recorder_event {
+#define FLIGHT_RECORDER_EVENT(name, arg0, arg1, arg2) FLIGHT_RECORDER_##name,
+#include "flight_recorder_events.h"
+#undef FLIGHT_RECORDER_EVENT
+
+	FLIGHT_RECORDER_EVENT_COUNT
+};
+
+/**
+ * @brief Output of a dump, called for each line.
+ *
+ * @param ctx Context given to flight_recorder_dump().
+ * @param line Line, without a line break.
+ */
+typedef void (*flight_recorder_print_t)(void *ctx, const char *line);
+
+#if defined(CONFIG_FLIGHT_RECORDER)
+/**
+ * @brief Record an event, overwriting the oldest one when the ring is full.
+ *
+ * Safe to call from any context, including interrupts.
+ */
+void flight_recorder_log(enum flight_recorder_event event, s32_t arg0,
+			 s32_t arg1, s32_t arg2);
+
+/**
+ * @brief Dump the ring, oldest event first, as hex encoded lines
+ *	  prefixed with "FR:" that scripts/flight_recorder.py decodes.
+ *
+ * @param print Line output, NULL to print with printk().
+ * @param ctx Context passed to the output.
+ */
+void flight_recorder_dump(flight_recorder_print_t print, void *ctx);
+#else
+static inline void flight_recorder_log(enum flight_recorder_event event,
+				       s32_t arg0, s32_t arg1, s32_t arg2)
+{
+	ARG_UNUSED(event);
+	ARG_UNUSED(arg0);
+	ARG_UNUSED(arg1);
+	ARG_UNUSED(arg2);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FLIGHT_RECORDER_H__ */
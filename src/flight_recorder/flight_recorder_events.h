@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Flight recorder events, FLIGHT_RECORDER_EVENT(name, arg0, arg1, arg2)
+ * with "_" for unused arguments. The ID of an event is its position in this
+ * list, which scripts/flight_recorder.py reads to decode dumps. Only append
+ * to it.
+ */
+
+FLIGHT_RECORDER_EVENT(BOOT, _, _, _)
+FLIGHT_RECORDER_EVENT(ENCODE, len, err, _)
+FLIGHT_RECORDER_EVENT(DECODE, len, err, _)
+FLIGHT_RECORDER_EVENT(SEND, ep, len, err)
+FLIGHT_RECORDER_EVENT(ACK, inflight, _, _)
+FLIGHT_RECORDER_EVENT(PING, _, _, _)
+FLIGHT_RECORDER_EVENT(CONNECT, err, failures, ms)
+FLIGHT_RECORDER_EVENT(DISCONNECT, err, _, _)
+FLIGHT_RECORDER_EVENT(BACKOFF, ms, failures, _)
+FLIGHT_RECORDER_EVENT(RRC, connected, _, _)
+FLIGHT_RECORDER_EVENT(GPS_START, timeout, interval, _)
+FLIGHT_RECORDER_EVENT(GPS_FIX, _, _, _)
+FLIGHT_RECORDER_EVENT(GPS_TIMEOUT, _, _, _)
+FLIGHT_RECORDER_EVENT(HEAP_FAIL, site, size, used)
+FLIGHT_RECORDER_EVENT(FOTA, started, _, _)
+FLIGHT_RECORDER_EVENT(ERROR, code, _, _)
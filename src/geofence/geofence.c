@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <cloud_codec.h>
+
+#include "geofence.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(geofence, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+#define DEG_TO_RAD (3.14159265f / 180.0f)
+#define METERS_PER_DEGREE 111320.0f
+
+enum zone_state {
+	ZONE_STATE_UNKNOWN,
+	ZONE_STATE_INSIDE,
+	ZONE_STATE_OUTSIDE,
+};
+
+struct zone {
+	struct cloud_data_geofence cfg;
+	/** Bounding box, including the hysteresis margin. */
+	double lat_min;
+	double lat_max;
+	double lng_min;
+	double lng_max;
+	/** Meters per degree of longitude at the zone. */
+	float lng_scale;
+	enum zone_state state;
+};
+
+static struct zone zones[CONFIG_GEOFENCE_MAX];
+static size_t zone_cnt;
+static geofence_evt_handler_t evt_handler;
+
+K_MUTEX_DEFINE(zone_lock);
+
+static void bbox_compute(struct zone *zone)
+{
+	const struct cloud_data_geofence *cfg = &zone->cfg;
+	/* The radius of a polygon is 0. */
+	float margin = cfg->radius + CONFIG_GEOFENCE_HYSTERESIS_M;
+
+	zone->lng_scale =
+		METERS_PER_DEGREE * cosf((float)cfg->lat[0] * DEG_TO_RAD);
+
+	zone->lat_min = zone->lat_max = cfg->lat[0];
+	zone->lng_min = zone->lng_max = cfg->lng[0];
+
+	for (int i = 1; i < cfg->vertex_cnt; i++) {
+		zone->lat_min = MIN(zone->lat_min, cfg->lat[i]);
+		zone->lat_max = MAX(zone->lat_max, cfg->lat[i]);
+		zone->lng_min = MIN(zone->lng_min, cfg->lng[i]);
+		zone->lng_max = MAX(zone->lng_max, cfg->lng[i]);
+	}
+
+	zone->lat_min -= margin / METERS_PER_DEGREE;
+	zone->lat_max += margin / METERS_PER_DEGREE;
+	zone->lng_min -= margin / zone->lng_scale;
+	zone->lng_max += margin / zone->lng_scale;
+}
+
+static bool circle_contains(const struct zone *zone, double lat, double lng,
+			    float margin)
+{
+	float dx = (float)(lng - zone->cfg.lng[0]) * zone->lng_scale;
+	float dy = (float)(lat - zone->cfg.lat[0]) * METERS_PER_DEGREE;
+	float r = zone->cfg.radius + margin;
+
+	return (dx * dx + dy * dy) <= r * r;
+}
+
+/** Ray casting, counts the polygon edges crossed by a ray going east. */
+static bool polygon_contains(const struct zone *zone, double lat, double lng)
+{
+	const struct cloud_data_geofence *cfg = &zone->cfg;
+	bool inside = false;
+
+	for (int i = 0, j = cfg->vertex_cnt - 1; i < cfg->vertex_cnt; j = i++) {
+		if ((cfg->lat[i] > lat) == (cfg->lat[j] > lat)) {
+			continue;
+		}
+
+		if (lng < (cfg->lng[j] - cfg->lng[i]) * (lat - cfg->lat[i]) /
+					  (cfg->lat[j] - cfg->lat[i]) +
+				  cfg->lng[i]) {
+			inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+/** Distance in meters from a point to the nearest edge of a polygon. */
+static float polygon_border_distance(const struct zone *zone, double lat,
+				     double lng)
+{
+	const struct cloud_data_geofence *cfg = &zone->cfg;
+	float min = FLT_MAX;
+
+	for (int i = 0, j = cfg->vertex_cnt - 1; i < cfg->vertex_cnt; j = i++) {
+		/* Edge and point relative to vertex j, in meters. */
+		float ex = (float)(cfg->lng[i] - cfg->lng[j]) * zone->lng_scale;
+		float ey = (float)(cfg->lat[i] - cfg->lat[j]) *
+			   METERS_PER_DEGREE;
+		float px = (float)(lng - cfg->lng[j]) * zone->lng_scale;
+		float py = (float)(lat - cfg->lat[j]) * METERS_PER_DEGREE;
+		float len2 = ex * ex + ey * ey;
+		float t = (len2 > 0.0f) ? (px * ex + py * ey) / len2 : 0.0f;
+
+		t = MIN(MAX(t, 0.0f), 1.0f);
+		px -= t * ex;
+		py -= t * ey;
+		min = MIN(min, px * px + py * py);
+	}
+
+	return sqrtf(min);
+}
+
+static bool zone_contains(const struct zone *zone, double lat, double lng)
+{
+	float margin = 0.0f;
+	bool inside;
+
+	if (lat < zone->lat_min || lat > zone->lat_max ||
+	    lng < zone->lng_min || lng > zone->lng_max) {
+		return false;
+	}
+
+	/* Require the fix to be clearly across the border of a zone before
+	 * the state changes, so that noise does not cause a stream of events.
+	 */
+	if (zone->state == ZONE_STATE_INSIDE) {
+		margin = CONFIG_GEOFENCE_HYSTERESIS_M;
+	} else if (zone->state == ZONE_STATE_OUTSIDE) {
+		margin = -CONFIG_GEOFENCE_HYSTERESIS_M;
+	}
+
+	if (zone->cfg.vertex_cnt == 0) {
+		return circle_contains(zone, lat, lng, margin);
+	}
+
+	inside = polygon_contains(zone, lat, lng);
+
+	/* A crossing within the margin keeps the state. */
+	if (margin != 0.0f && inside != (margin > 0.0f) &&
+	    polygon_border_distance(zone, lat, lng) <= fabsf(margin)) {
+		return !inside;
+	}
+
+	return inside;
+}
+
+int geofence_init(geofence_evt_handler_t handler)
+{
+	if (handler == NULL) {
+		LOG_INF("Geofence handler NULL!");
+		return -EINVAL;
+	}
+
+	evt_handler = handler;
+
+	return 0;
+}
+
+int geofence_set(const struct cloud_data_geofence *cfg, size_t count)
+{
+	static struct zone prev[CONFIG_GEOFENCE_MAX];
+	size_t prev_cnt;
+
+	if (count > CONFIG_GEOFENCE_MAX) {
+		return -ENOMEM;
+	}
+
+	for (int i = 0; i < count; i++) {
+		if ((cfg[i].vertex_cnt == 0 && cfg[i].radius == 0) ||
+		    cfg[i].vertex_cnt == 1 || cfg[i].vertex_cnt == 2 ||
+		    cfg[i].vertex_cnt > CONFIG_GEOFENCE_VERTICES_MAX) {
+			LOG_ERR("Zone %d is not a circle or a polygon",
+				cfg[i].id);
+			return -EINVAL;
+		}
+	}
+
+	k_mutex_lock(&zone_lock, K_FOREVER);
+
+	memcpy(prev, zones, sizeof(prev));
+	prev_cnt = zone_cnt;
+
+	for (int i = 0; i < count; i++) {
+		zones[i].cfg = cfg[i];
+		zones[i].state = ZONE_STATE_UNKNOWN;
+		bbox_compute(&zones[i]);
+
+		for (int j = 0; j < prev_cnt; j++) {
+			if (prev[j].cfg.id == cfg[i].id) {
+				zones[i].state = prev[j].state;
+				break;
+			}
+		}
+	}
+
+	zone_cnt = count;
+
+	k_mutex_unlock(&zone_lock);
+
+	LOG_INF("%d geofence zones set", count);
+
+	return 0;
+}
+
+int geofence_evaluate(double lat, double lng)
+{
+	int evt_cnt = 0;
+
+	k_mutex_lock(&zone_lock, K_FOREVER);
+
+	for (int i = 0; i < zone_cnt; i++) {
+		struct zone *zone = &zones[i];
+		enum zone_state state = zone_contains(zone, lat, lng) ?
+						ZONE_STATE_INSIDE :
+						ZONE_STATE_OUTSIDE;
+		struct geofence_evt evt = { .id = zone->cfg.id };
+
+		if (state == zone->state) {
+			continue;
+		}
+
+		zone->state = state;
+		evt.type = (state == ZONE_STATE_INSIDE) ? GEOFENCE_EVT_ENTER :
+							  GEOFENCE_EVT_EXIT;
+
+		LOG_INF("Zone %d %s", zone->cfg.id,
+			evt.type == GEOFENCE_EVT_ENTER ? "entered" : "left");
+
+		if (evt_handler != NULL) {
+			evt_handler(&evt);
+		}
+
+		evt_cnt++;
+	}
+
+	k_mutex_unlock(&zone_lock);
+
+	return evt_cnt;
+}
+
+size_t geofence_count(void)
+{
+	return zone_cnt;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *@brief Geofence library header.
+ */
+
+#ifndef GEOFENCE_H__
+#define GEOFENCE_H__
+
+#include <zephyr.h>
+#include <cloud_codec.h>
+
+/**@file
+ *
+ * @defgroup geofence Geofence
+ * @brief    Module that tracks whether the device is inside circular and
+ *           polygonal zones.
+ *
+ * Each zone gets a bounding box when it is set, so that most fixes are
+ * judged by four comparisons before the exact test is done.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Enum containing callback events from library. */
+enum geofence_evt_type {
+	GEOFENCE_EVT_ENTER,
+	GEOFENCE_EVT_EXIT,
+};
+
+/** @brief Structure containing a geofence event. */
+struct geofence_evt {
+	/** Event type. */
+	enum geofence_evt_type type;
+	/** Identifier of the zone that was entered or left. */
+	int id;
+};
+
+/** @brief Geofence library event handler.
+ *
+ *  @param[in] evt The event and any associated parameters.
+ */
+typedef void (*geofence_evt_handler_t)(const struct geofence_evt *const evt);
+
+/**
+ * @brief Initializes the library, sets callback handler.
+ *
+ * @param[in] handler Pointer to callback handler.
+ *
+ * @return 0 on success or negative error value on failure.
+ */
+int geofence_init(geofence_evt_handler_t handler);
+
+/**
+ * @brief Replace the zones that are tracked. The state of a zone with an
+ *        unchanged identifier is kept.
+ *
+ * @param[in] zones Zones.
+ * @param[in] count Number of zones, at most CONFIG_GEOFENCE_MAX.
+ *
+ * @return 0 on success or negative error value on failure.
+ */
+int geofence_set(const struct cloud_data_geofence *zones, size_t count);
+
+/**
+ * @brief Evaluate a position fix against all zones. An event is sent for
+ *        every zone that is entered or left, and for the initial state of
+ *        a new zone.
+ *
+ * @param[in] lat Latitude of the fix.
+ * @param[in] lng Longitude of the fix.
+ *
+ * @return Number of events sent.
+ */
+int geofence_evaluate(double lat, double lng);
+
+/** @brief Get the number of zones that are tracked. */
+size_t geofence_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
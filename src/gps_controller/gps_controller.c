@@ -5,24 +5,266 @@
  */
 
 #include <zephyr.h>
+#include <string.h>
 #include <sys/util.h>
+#include <sys/byteorder.h>
 #include <drivers/gps.h>
 #include <modem/lte_lc.h>
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+#include <nrf_socket.h>
+#endif
+#include <settings/settings.h>
+#include <date_time.h>
+#include <math.h>
 
 #include "ui.h"
 #include "gps_controller.h"
+#include "power_timeline.h"
 
 #include <logging/log.h>
 LOG_MODULE_REGISTER(gps_control, CONFIG_CAT_TRACKER_LOG_LEVEL);
 
+#define GPS_CONTROL_SETTINGS_KEY "gps_ctrl"
+#define GPS_CONTROL_LAST_FIX_KEY "last_fix"
+
+/* Seconds between the UNIX epoch and the GPS epoch (1980-01-06). */
+#define GPS_EPOCH_UNIX_SEC 315964800
+/* GPS time is ahead of UTC by the accumulated leap seconds. */
+#define GPS_UTC_LEAP_SEC 18
+#define SEC_PER_DAY 86400
+
+/* Size of an A-GPS record header: type (1 byte) and length (2 bytes). */
+#define AGPS_RECORD_HDR_LEN 3
+
 /* Structure to hold GPS work information */
 static struct device *gps_dev;
 static struct k_delayed_work start_work;
 static struct k_delayed_work stop_work;
 static atomic_t gps_is_active;
+static bool tracking;
+static u32_t tracking_interval;
 static struct gps_config gps_cfg = { .nav_mode = GPS_NAV_MODE_SINGLE_FIX,
 				     .power_mode = GPS_POWER_MODE_DISABLED };
 
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+/** Last known position, persisted to seed the next search. */
+struct gps_last_fix {
+	double lat;
+	double lng;
+	float alt;
+	float acc;
+	/** Time of fix. UNIX milliseconds. */
+	s64_t ts;
+};
+
+static struct gps_last_fix last_fix;
+static struct gps_last_fix last_fix_pending;
+static s64_t last_fix_stored_uptime;
+static bool last_fix_stored;
+static struct k_work last_fix_store_work;
+
+static int settings_set(const char *key, size_t len_rd,
+			settings_read_cb read_cb, void *cb_arg)
+{
+	ssize_t len;
+
+	if (strcmp(key, GPS_CONTROL_LAST_FIX_KEY) != 0) {
+		return -ENOENT;
+	}
+
+	if (len_rd != sizeof(last_fix)) {
+		LOG_WRN("Stored last fix has unexpected size, ignoring");
+		return 0;
+	}
+
+	len = read_cb(cb_arg, &last_fix, sizeof(last_fix));
+	if (len != sizeof(last_fix)) {
+		LOG_ERR("Failed to read last fix, error: %d", (int)len);
+		memset(&last_fix, 0, sizeof(last_fix));
+		return 0;
+	}
+
+	LOG_INF("Last fix restored from flash");
+
+	return 0;
+}
+
+static struct settings_handler settings_conf = {
+	.name = GPS_CONTROL_SETTINGS_KEY,
+	.h_set = settings_set,
+};
+
+static void last_fix_store_work_fn(struct k_work *work)
+{
+	int err;
+
+	ARG_UNUSED(work);
+
+	err = settings_save_one(GPS_CONTROL_SETTINGS_KEY "/"
+				GPS_CONTROL_LAST_FIX_KEY,
+				&last_fix_pending, sizeof(last_fix_pending));
+	if (err) {
+		LOG_ERR("Failed to store last fix, error: %d", err);
+		return;
+	}
+
+	LOG_DBG("Last fix stored to flash");
+}
+
+static int last_fix_settings_init(void)
+{
+	int err;
+
+	err = settings_subsys_init();
+	if (err) {
+		LOG_ERR("settings_subsys_init, error: %d", err);
+		return err;
+	}
+
+	err = settings_register(&settings_conf);
+	if (err) {
+		LOG_ERR("settings_register, error: %d", err);
+		return err;
+	}
+
+	err = settings_load_subtree(GPS_CONTROL_SETTINGS_KEY);
+	if (err) {
+		LOG_ERR("settings_load_subtree, error: %d", err);
+		return err;
+	}
+
+	k_work_init(&last_fix_store_work, last_fix_store_work_fn);
+
+	return 0;
+}
+
+/** Encode an uncertainty radius in meters to the 3GPP TS 23.032 format
+ *  r = C * ((1 + x)^K - 1) used by the modem.
+ */
+static u8_t uncertainty_encode(float r, float c, float x, u8_t max)
+{
+	float k = logf(r / c + 1.0f) / logf(1.0f + x);
+
+	if (k < 0.0f) {
+		return 0;
+	}
+
+	if (k > max) {
+		return max;
+	}
+
+	return (u8_t)k;
+}
+
+static int agps_location_inject(void)
+{
+	int err;
+	s64_t now;
+	nrf_gnss_agps_data_location_t location = { 0 };
+
+	if (last_fix.ts == 0) {
+		LOG_DBG("No stored fix to seed location from");
+		return -ENODATA;
+	}
+
+	err = date_time_now(&now);
+	if (err) {
+		LOG_DBG("Time unknown, cannot judge age of stored fix");
+		return -ENODATA;
+	}
+
+	if ((now - last_fix.ts) >
+	    K_SECONDS(CONFIG_GPS_CONTROL_AGPS_LOCATION_MAX_AGE_SEC)) {
+		LOG_DBG("Stored fix is too old to seed location");
+		return -ENODATA;
+	}
+
+	/* Latitude is encoded as N = 2^23 * lat / 90 and longitude as
+	 * N = 2^24 * lng / 360.
+	 */
+	location.latitude = (s32_t)(last_fix.lat * (1 << 23) / 90.0);
+	location.longitude = (s32_t)(last_fix.lng * (1 << 24) / 360.0);
+	location.altitude = (s16_t)last_fix.alt;
+	location.unc_semimajor = uncertainty_encode(
+		MAX(last_fix.acc,
+		    CONFIG_GPS_CONTROL_AGPS_LOCATION_UNCERTAINTY_M),
+		10.0f, 0.1f, 127);
+	location.unc_semiminor = location.unc_semimajor;
+	location.orientation_major = 0;
+	location.unc_altitude = uncertainty_encode(
+		CONFIG_GPS_CONTROL_AGPS_LOCATION_UNCERTAINTY_M, 45.0f,
+		0.025f, 127);
+	location.confidence = 68;
+
+	err = gps_agps_write(gps_dev, GPS_AGPS_LOCATION, &location,
+			     sizeof(location));
+	if (err) {
+		LOG_ERR("Failed to inject stored location, error: %d", err);
+		return err;
+	}
+
+	LOG_INF("Stored location injected");
+
+	return 0;
+}
+
+static int agps_time_inject(void)
+{
+	int err;
+	s64_t now;
+	s64_t gps_sec;
+	nrf_gnss_agps_data_system_time_and_sv_tow_t sys_time = { 0 };
+
+	err = date_time_now(&now);
+	if (err) {
+		LOG_DBG("Time unknown, cannot seed GPS system time");
+		return -ENODATA;
+	}
+
+	gps_sec = now / MSEC_PER_SEC - GPS_EPOCH_UNIX_SEC + GPS_UTC_LEAP_SEC;
+
+	sys_time.date_day = gps_sec / SEC_PER_DAY;
+	sys_time.time_full_s = gps_sec % SEC_PER_DAY;
+	sys_time.time_frac_ms = now % MSEC_PER_SEC;
+	sys_time.sv_mask = 0;
+
+	err = gps_agps_write(gps_dev, GPS_AGPS_GPS_SYSTEM_CLOCK_AND_TOWS,
+			     &sys_time, sizeof(sys_time));
+	if (err) {
+		LOG_ERR("Failed to inject system time, error: %d", err);
+		return err;
+	}
+
+	LOG_INF("System time injected");
+
+	return 0;
+}
+
+static size_t agps_element_size(enum gps_agps_type type)
+{
+	switch (type) {
+	case GPS_AGPS_UTC_PARAMETERS:
+		return sizeof(nrf_gnss_agps_data_utc_t);
+	case GPS_AGPS_EPHEMERIDES:
+		return sizeof(nrf_gnss_agps_data_ephemeris_t);
+	case GPS_AGPS_ALMANAC:
+		return sizeof(nrf_gnss_agps_data_almanac_t);
+	case GPS_AGPS_KLOBUCHAR_CORRECTION:
+		return sizeof(nrf_gnss_agps_data_klobuchar_t);
+	case GPS_AGPS_NEQUICK_CORRECTION:
+		return sizeof(nrf_gnss_agps_data_nequick_t);
+	case GPS_AGPS_GPS_SYSTEM_CLOCK_AND_TOWS:
+		return sizeof(nrf_gnss_agps_data_system_time_and_sv_tow_t);
+	case GPS_AGPS_LOCATION:
+		return sizeof(nrf_gnss_agps_data_location_t);
+	case GPS_AGPS_INTEGRITY:
+		return sizeof(nrf_gnss_agps_data_integrity_t);
+	default:
+		return 0;
+	}
+}
+#endif /* CONFIG_GPS_CONTROL_AGPS */
+
 static void start(struct k_work *work)
 {
 	ARG_UNUSED(work);
@@ -33,14 +275,39 @@ static void start(struct k_work *work)
 		return;
 	}
 
+	/* A tracking GPS keeps running in between fixes, restarting it
+	 * would throw away the retained ephemerides.
+	 */
+	if (tracking && gps_cfg.nav_mode == GPS_NAV_MODE_PERIODIC &&
+	    gps_cfg.interval == tracking_interval) {
+		LOG_DBG("GPS already tracking every %d seconds",
+			tracking_interval);
+		return;
+	}
+
+	if (tracking_interval > 0) {
+		gps_cfg.nav_mode = GPS_NAV_MODE_PERIODIC;
+		gps_cfg.interval = tracking_interval;
+	} else {
+		gps_cfg.nav_mode = GPS_NAV_MODE_SINGLE_FIX;
+		gps_cfg.interval = 0;
+	}
+
 	ui_led_set_pattern(UI_LED_GPS_SEARCHING);
 
 	err = gps_start(gps_dev, &gps_cfg);
 	if (err) {
 		LOG_ERR("Failed to enable GPS, error: %d", err);
+		tracking = false;
 		return;
 	}
 
+	tracking = (gps_cfg.nav_mode == GPS_NAV_MODE_PERIODIC);
+
+	if (tracking) {
+		LOG_INF("GPS tracking, fix every %d seconds", gps_cfg.interval);
+	}
+
 	gps_control_set_active(true);
 }
 
@@ -61,11 +328,12 @@ static void stop(struct k_work *work)
 	}
 
 	gps_control_set_active(false);
+	tracking = false;
 
 	LOG_INF("GPS operation was stopped");
 }
 
-void gps_control_start(u32_t delay_ms, u32_t timeout)
+void gps_control_start(u32_t delay_ms, u32_t timeout, u32_t interval)
 {
 	if (timeout == 0) {
 		LOG_ERR("No GPS timeout set");
@@ -73,6 +341,7 @@ void gps_control_start(u32_t delay_ms, u32_t timeout)
 	}
 
 	gps_cfg.timeout = timeout;
+	tracking_interval = interval;
 	k_delayed_work_submit(&start_work, delay_ms);
 }
 
@@ -81,6 +350,11 @@ void gps_control_stop(u32_t delay_ms)
 	k_delayed_work_submit(&stop_work, delay_ms);
 }
 
+bool gps_control_is_tracking(void)
+{
+	return tracking;
+}
+
 bool gps_control_is_active(void)
 {
 	return atomic_get(&gps_is_active);
@@ -88,8 +362,140 @@ bool gps_control_is_active(void)
 
 bool gps_control_set_active(bool active)
 {
-	return atomic_set(&gps_is_active, active ? 1 : 0);
+	bool was_active = atomic_set(&gps_is_active, active ? 1 : 0);
+
+	if (was_active != active) {
+		power_timeline_gps_update(active);
+	}
+
+	return was_active;
+}
+
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+int gps_control_agps_seed(struct gps_agps_request *request)
+{
+	int err;
+	int ret = 0;
+
+	if (gps_dev == NULL) {
+		LOG_ERR("GPS controller is not initialized");
+		return -ENODEV;
+	}
+
+	/* -ENODATA only means that the data has to be fetched. */
+	if (request->position) {
+		err = agps_location_inject();
+		if (!err) {
+			request->position = 0;
+		} else if (err != -ENODATA) {
+			ret = err;
+		}
+	}
+
+	if (request->system_time_tow) {
+		err = agps_time_inject();
+		if (!err) {
+			request->system_time_tow = 0;
+		} else if (err != -ENODATA && ret == 0) {
+			ret = err;
+		}
+	}
+
+	return ret;
+}
+
+int gps_control_agps_process(const u8_t *buf, size_t len)
+{
+	int err;
+	size_t offset = 1;
+	int injected = 0;
+
+	if (gps_dev == NULL) {
+		LOG_ERR("GPS controller is not initialized");
+		return -ENODEV;
+	}
+
+	if (buf == NULL || len < 1) {
+		return -EINVAL;
+	}
+
+	if (buf[0] != GPS_CONTROL_AGPS_FORMAT_VERSION) {
+		LOG_ERR("Unsupported A-GPS data format version: %d", buf[0]);
+		return -ENOTSUP;
+	}
+
+	while (offset + AGPS_RECORD_HDR_LEN <= len) {
+		enum gps_agps_type type = buf[offset];
+		u16_t record_len = sys_get_le16(&buf[offset + 1]);
+		size_t element_size = agps_element_size(type);
+
+		offset += AGPS_RECORD_HDR_LEN;
+
+		if (offset + record_len > len) {
+			LOG_ERR("A-GPS record of type %d is truncated", type);
+			return -EBADMSG;
+		}
+
+		if (element_size == 0 || (record_len % element_size) != 0) {
+			LOG_WRN("Skipping A-GPS record of type %d, length %d",
+				type, record_len);
+			offset += record_len;
+			continue;
+		}
+
+		/* The modem takes one element per write. */
+		for (size_t i = 0; i < record_len; i += element_size) {
+			err = gps_agps_write(gps_dev, type,
+					     (void *)&buf[offset + i],
+					     element_size);
+			if (err) {
+				LOG_ERR("Failed to inject A-GPS type %d, "
+					"error: %d", type, err);
+				return err;
+			}
+
+			injected++;
+		}
+
+		offset += record_len;
+	}
+
+	LOG_INF("%d A-GPS elements injected", injected);
+
+	return 0;
+}
+
+void gps_control_last_fix_store(const struct gps_pvt *pvt)
+{
+	int err;
+	s64_t now;
+
+	err = date_time_now(&now);
+	if (err) {
+		LOG_DBG("Time unknown, fix not stored");
+		return;
+	}
+
+	last_fix.lat = pvt->latitude;
+	last_fix.lng = pvt->longitude;
+	last_fix.alt = pvt->altitude;
+	last_fix.acc = pvt->accuracy;
+	last_fix.ts = now;
+
+	/* Limit flash writes, the fix is kept in RAM in between. */
+	if (last_fix_stored &&
+	    (k_uptime_get() - last_fix_stored_uptime) <
+		    K_SECONDS(CONFIG_GPS_CONTROL_LAST_FIX_STORE_INTERVAL_SEC)) {
+		return;
+	}
+
+	last_fix_pending = last_fix;
+	last_fix_stored = true;
+	last_fix_stored_uptime = k_uptime_get();
+
+	k_work_submit(&last_fix_store_work);
 }
+#endif /* CONFIG_GPS_CONTROL_AGPS */
 
 /** @brief Configures and starts the GPS device. */
 int gps_control_init(gps_event_handler_t handler)
@@ -121,6 +527,14 @@ int gps_control_init(gps_event_handler_t handler)
 	k_delayed_work_init(&start_work, start);
 	k_delayed_work_init(&stop_work, stop);
 
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+	err = last_fix_settings_init();
+	if (err) {
+		LOG_ERR("Stored fix not available, error: %d", err);
+		err = 0;
+	}
+#endif
+
 	LOG_INF("GPS initialized");
 
 	is_init = true;
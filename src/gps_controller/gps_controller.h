@@ -13,6 +13,7 @@
 #define GPS_CONTROLLER_H__
 
 #include <zephyr.h>
+#include <drivers/gps.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -22,12 +23,66 @@ int gps_control_init(gps_event_handler_t handler);
 
 void gps_control_stop(u32_t delay_ms);
 
-void gps_control_start(u32_t delay_ms, u32_t timeout);
+/**
+ * @brief Start a GPS search.
+ *
+ * @param[in] delay_ms Delay before the search is started.
+ * @param[in] timeout Search timeout in seconds.
+ * @param[in] interval Seconds in between fixes when tracking. The GPS keeps
+ *                     running in periodic navigation mode and reports a fix
+ *                     every interval. 0 gives a single fix search.
+ */
+void gps_control_start(u32_t delay_ms, u32_t timeout, u32_t interval);
+
+/** @brief Check if the GPS is running in periodic navigation mode. */
+bool gps_control_is_tracking(void);
 
 bool gps_control_is_active(void);
 
 bool gps_control_set_active(bool active);
 
+/** Version of the binary A-GPS assistance data format.
+ *
+ *  The assistance data published to the device is a version byte followed
+ *  by records of { type (u8), length (u16, little endian), data }, where
+ *  type is an enum gps_agps_type value and data is one or more elements in
+ *  the modem's nrf_gnss_agps_data_* layout for that type.
+ */
+#define GPS_CONTROL_AGPS_FORMAT_VERSION 1
+
+/**
+ * @brief Inject assistance data that is available on the device, the
+ *        stored last fix and the current time, and clear the corresponding
+ *        flags in the request.
+ *
+ * @param[in, out] request A-GPS request from the GPS driver. On return it
+ *                         only flags data that still has to be fetched.
+ *
+ * @return 0 on success, also when there is no usable data to inject, or the
+ *         first negative error value of the GPS driver. The request is
+ *         updated in either case.
+ */
+int gps_control_agps_seed(struct gps_agps_request *request);
+
+/**
+ * @brief Decode A-GPS assistance data received from the cloud and inject it
+ *        through the GPS driver.
+ *
+ * @param[in] buf Assistance data, see GPS_CONTROL_AGPS_FORMAT_VERSION.
+ * @param[in] len Length of the assistance data.
+ *
+ * @return 0 on success or negative error value on failure.
+ */
+int gps_control_agps_process(const u8_t *buf, size_t len);
+
+/**
+ * @brief Remember a position fix so that it can seed the next search, also
+ *        across reboots.
+ *
+ * @param[in] pvt Position fix.
+ */
+void gps_control_last_fix_store(const struct gps_pvt *pvt);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <math.h>
+#include <drivers/gps.h>
+
+#include "gps_filter.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(gps_filter, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+#define DEG_TO_RAD (3.14159265f / 180.0f)
+#define METERS_PER_DEGREE 111320.0f
+
+/* Distance from the origin of the local plane after which the origin is
+ * moved, keeps single precision math accurate to well below a meter.
+ */
+#define ORIGIN_MAX_DISTANCE_M 10000.0f
+
+/* Reported accuracy is never trusted to be better than this. */
+#define MIN_ACCURACY_M 1.0f
+
+#define ACCEL_VARIANCE                                                         \
+	((CONFIG_GPS_FILTER_ACCEL_SIGMA_CMS2 / 100.0f) *                       \
+	 (CONFIG_GPS_FILTER_ACCEL_SIGMA_CMS2 / 100.0f))
+#define GATE (CONFIG_GPS_FILTER_GATE_X100 / 100.0f)
+
+/** Position and velocity along one axis of the local plane, with the
+ *  unique elements of the symmetric covariance matrix.
+ */
+struct axis {
+	float pos;
+	float vel;
+	float p_pp;
+	float p_pv;
+	float p_vv;
+};
+
+static struct {
+	bool init;
+	int rejects;
+	s64_t ts;
+	/** Origin of the local east/north plane. */
+	double lat0;
+	double lng0;
+	/** Meters per degree of longitude at the origin. */
+	float lng_scale;
+	struct axis east;
+	struct axis north;
+} filter;
+
+static void origin_set(double lat, double lng)
+{
+	filter.lat0 = lat;
+	filter.lng0 = lng;
+	filter.lng_scale = METERS_PER_DEGREE * cosf((float)lat * DEG_TO_RAD);
+}
+
+static void axis_init(struct axis *axis, float pos, float var)
+{
+	axis->pos = pos;
+	axis->vel = 0.0f;
+	axis->p_pp = var;
+	axis->p_pv = 0.0f;
+	/* Velocity is unknown, start out with a generous variance. */
+	axis->p_vv = 100.0f;
+}
+
+static void axis_predict(struct axis *axis, float dt)
+{
+	float dt2 = dt * dt;
+	float dt3 = dt2 * dt;
+
+	axis->pos += axis->vel * dt;
+
+	/* P = F * P * F' + Q, for a white noise acceleration model. */
+	axis->p_pp += 2.0f * dt * axis->p_pv + dt2 * axis->p_vv +
+		      ACCEL_VARIANCE * dt3 / 3.0f;
+	axis->p_pv += dt * axis->p_vv + ACCEL_VARIANCE * dt2 / 2.0f;
+	axis->p_vv += ACCEL_VARIANCE * dt;
+}
+
+static void axis_correct(struct axis *axis, float innovation, float s)
+{
+	float k_p = axis->p_pp / s;
+	float k_v = axis->p_pv / s;
+	float p_pp = axis->p_pp;
+	float p_pv = axis->p_pv;
+
+	axis->pos += k_p * innovation;
+	axis->vel += k_v * innovation;
+
+	axis->p_pp -= k_p * p_pp;
+	axis->p_pv -= k_p * p_pv;
+	axis->p_vv -= k_v * p_pv;
+}
+
+static void filter_start(struct gps_pvt *pvt, s64_t ts, float var)
+{
+	origin_set(pvt->latitude, pvt->longitude);
+	axis_init(&filter.east, 0.0f, var);
+	axis_init(&filter.north, 0.0f, var);
+
+	filter.ts = ts;
+	filter.rejects = 0;
+	filter.init = true;
+}
+
+static void origin_move(void)
+{
+	double lat = filter.lat0 + filter.north.pos / METERS_PER_DEGREE;
+	double lng = filter.lng0 + filter.east.pos / filter.lng_scale;
+
+	origin_set(lat, lng);
+	filter.east.pos = 0.0f;
+	filter.north.pos = 0.0f;
+}
+
+int gps_filter_update(struct gps_pvt *pvt, s64_t ts)
+{
+	float acc = MAX(pvt->accuracy, MIN_ACCURACY_M);
+	float var = acc * acc;
+	float dt, east, north, in_e, in_n, s_e, s_n, d2;
+
+	if (!filter.init) {
+		filter_start(pvt, ts, var);
+		return 0;
+	}
+
+	dt = (ts > filter.ts) ? (ts - filter.ts) / 1000.0f : 0.0f;
+
+	east = (float)(pvt->longitude - filter.lng0) * filter.lng_scale;
+	north = (float)(pvt->latitude - filter.lat0) * METERS_PER_DEGREE;
+
+	axis_predict(&filter.east, dt);
+	axis_predict(&filter.north, dt);
+
+	in_e = east - filter.east.pos;
+	in_n = north - filter.north.pos;
+	s_e = filter.east.p_pp + var;
+	s_n = filter.north.p_pp + var;
+
+	/* Squared Mahalanobis distance of the innovation. */
+	d2 = (in_e * in_e) / s_e + (in_n * in_n) / s_n;
+
+	if (d2 > GATE) {
+		filter.rejects++;
+
+		if (filter.rejects < CONFIG_GPS_FILTER_MAX_REJECTS) {
+			/* Keep the prediction, the covariance has grown and
+			 * the next fix is judged more leniently.
+			 */
+			filter.ts = ts;
+			LOG_INF("Fix rejected as outlier, distance^2: %d",
+				(int)d2);
+			return -EAGAIN;
+		}
+
+		LOG_INF("Too many rejected fixes, restarting filter");
+		filter_start(pvt, ts, var);
+		return 0;
+	}
+
+	axis_correct(&filter.east, in_e, s_e);
+	axis_correct(&filter.north, in_n, s_n);
+
+	filter.ts = ts;
+	filter.rejects = 0;
+
+	pvt->latitude = filter.lat0 + filter.north.pos / METERS_PER_DEGREE;
+	pvt->longitude = filter.lng0 + filter.east.pos / filter.lng_scale;
+
+	if (fabsf(filter.east.pos) > ORIGIN_MAX_DISTANCE_M ||
+	    fabsf(filter.north.pos) > ORIGIN_MAX_DISTANCE_M) {
+		origin_move();
+	}
+
+	return 0;
+}
+
+void gps_filter_reset(void)
+{
+	filter.init = false;
+}
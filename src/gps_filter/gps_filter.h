@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *@brief GPS filter library header.
+ */
+
+#ifndef GPS_FILTER_H__
+#define GPS_FILTER_H__
+
+#include <zephyr.h>
+#include <drivers/gps.h>
+
+/**@file
+ *
+ * @defgroup gps_filter GPS filter
+ * @brief    Module that smooths GPS fixes and rejects outliers.
+ *
+ * Fixes are run through a constant-velocity Kalman filter in a local
+ * east/north plane. A fix whose innovation falls outside the gate is
+ * rejected as a jump outlier. If several fixes in a row are rejected the
+ * filter assumes the device really moved and restarts from the latest fix.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Run a position fix through the filter.
+ *
+ * @param[in, out] pvt Position fix. On success latitude and longitude are
+ *                     replaced with the filtered position.
+ * @param[in] ts Time of the fix, uptime in milliseconds.
+ *
+ * @return 0 if the fix was accepted, -EAGAIN if it was rejected as an
+ *         outlier.
+ */
+int gps_filter_update(struct gps_pvt *pvt, s64_t ts);
+
+/** @brief Forget the filter state, the next fix is accepted as is. */
+void gps_filter_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
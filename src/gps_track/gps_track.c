@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <math.h>
+#include <cloud_codec.h>
+
+#include "gps_track.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(gps_track, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+#define DEG_TO_RAD (3.14159265f / 180.0f)
+#define METERS_PER_DEGREE 111320.0f
+
+/* Upper bound for the number of entries handled in one pass. */
+#define TRACK_POINTS_MAX CONFIG_GPS_BUFFER_MAX
+
+struct point {
+	/** Index in the GPS buffer. */
+	int idx;
+	/** Position in meters, in a plane local to the first entry. */
+	float x;
+	float y;
+};
+
+struct range {
+	int first;
+	int last;
+};
+
+/** Collect queued entries ordered by time. Numbered entries were published
+ *  before and are sent again as they are, dropping one would leave a gap.
+ */
+static int points_collect(struct cloud_data_gps *buf, size_t count,
+			  struct point *pts)
+{
+	int n = 0;
+
+	for (int i = 0; i < count && n < TRACK_POINTS_MAX; i++) {
+		int j = n;
+
+		if (!buf[i].queued || buf[i].seq != CLOUD_DATA_SEQ_NONE) {
+			continue;
+		}
+
+		/* Insertion sort, the buffer is small. */
+		while (j > 0 && buf[pts[j - 1].idx].gps_ts > buf[i].gps_ts) {
+			pts[j] = pts[j - 1];
+			j--;
+		}
+
+		pts[j].idx = i;
+		n++;
+	}
+
+	return n;
+}
+
+static void points_project(struct cloud_data_gps *buf, struct point *pts,
+			   int n)
+{
+	double lat0 = buf[pts[0].idx].lat;
+	double lng0 = buf[pts[0].idx].longi;
+	float lng_scale = METERS_PER_DEGREE * cosf((float)lat0 * DEG_TO_RAD);
+
+	for (int i = 0; i < n; i++) {
+		pts[i].x = (float)(buf[pts[i].idx].longi - lng0) * lng_scale;
+		pts[i].y = (float)(buf[pts[i].idx].lat - lat0) *
+			   METERS_PER_DEGREE;
+	}
+}
+
+static float distance_sq(const struct point *a, const struct point *b)
+{
+	float dx = a->x - b->x;
+	float dy = a->y - b->y;
+
+	return dx * dx + dy * dy;
+}
+
+/** Squared distance from p to the segment a-b. */
+static float segment_distance_sq(const struct point *p, const struct point *a,
+				 const struct point *b)
+{
+	float dx = b->x - a->x;
+	float dy = b->y - a->y;
+	float len_sq = dx * dx + dy * dy;
+	float t;
+	struct point proj;
+
+	if (len_sq == 0.0f) {
+		return distance_sq(p, a);
+	}
+
+	t = ((p->x - a->x) * dx + (p->y - a->y) * dy) / len_sq;
+	t = MAX(0.0f, MIN(1.0f, t));
+
+	proj.x = a->x + t * dx;
+	proj.y = a->y + t * dy;
+
+	return distance_sq(p, &proj);
+}
+
+/** Merge runs of entries that stay within the tolerance of the first entry
+ *  of the run into that entry. Returns the number of points left.
+ */
+static int dwell_merge(struct cloud_data_gps *buf, struct point *pts, int n,
+		       float tolerance)
+{
+	int anchor = 0;
+	int kept = 1;
+
+	for (int i = 1; i < n; i++) {
+		struct cloud_data_gps *first = &buf[pts[anchor].idx];
+		struct cloud_data_gps *entry = &buf[pts[i].idx];
+		float radius = MAX(tolerance, first->acc);
+
+		if (distance_sq(&pts[anchor], &pts[i]) <= radius * radius) {
+			first->dur = (entry->gps_ts - first->gps_ts) /
+					     MSEC_PER_SEC +
+				     entry->dur;
+			entry->queued = false;
+			continue;
+		}
+
+		anchor = kept;
+		pts[kept++] = pts[i];
+	}
+
+	return kept;
+}
+
+static void douglas_peucker(struct cloud_data_gps *buf, struct point *pts,
+			    int n, float tolerance)
+{
+	struct range stack[TRACK_POINTS_MAX];
+	int top = 0;
+	float tolerance_sq = tolerance * tolerance;
+
+	stack[top++] = (struct range){ .first = 0, .last = n - 1 };
+
+	while (top > 0) {
+		struct range r = stack[--top];
+		float max_sq = -1.0f;
+		int max_idx = r.first;
+
+		if (r.last - r.first < 2) {
+			continue;
+		}
+
+		for (int i = r.first + 1; i < r.last; i++) {
+			float d_sq = segment_distance_sq(&pts[i], &pts[r.first],
+							 &pts[r.last]);
+
+			if (d_sq > max_sq) {
+				max_sq = d_sq;
+				max_idx = i;
+			}
+		}
+
+		if (max_sq > tolerance_sq) {
+			stack[top++] = (struct range){ .first = r.first,
+						       .last = max_idx };
+			stack[top++] = (struct range){ .first = max_idx,
+						       .last = r.last };
+			continue;
+		}
+
+		for (int i = r.first + 1; i < r.last; i++) {
+			/* Entries that absorbed a stay are kept. */
+			if (buf[pts[i].idx].dur == 0) {
+				buf[pts[i].idx].queued = false;
+			}
+		}
+	}
+}
+
+int gps_track_simplify(struct cloud_data_gps *buf, size_t count,
+		       u32_t tolerance)
+{
+	struct point pts[TRACK_POINTS_MAX];
+	int n, kept, dropped;
+
+	if (tolerance == 0) {
+		return 0;
+	}
+
+	n = points_collect(buf, count, pts);
+	if (n < 2) {
+		return 0;
+	}
+
+	points_project(buf, pts, n);
+
+	kept = dwell_merge(buf, pts, n, tolerance);
+	if (kept > 2) {
+		douglas_peucker(buf, pts, kept, tolerance);
+	}
+
+	/* Only the points of the track count. Numbered entries, and queued
+	 * entries beyond TRACK_POINTS_MAX, were left out of it.
+	 */
+	dropped = n - kept;
+	for (int i = 0; i < kept; i++) {
+		dropped += buf[pts[i].idx].queued ? 0 : 1;
+	}
+
+	LOG_INF("GPS track simplified from %d to %d entries", n, n - dropped);
+
+	return dropped;
+}
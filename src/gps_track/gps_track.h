@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *@brief GPS track simplification library header.
+ */
+
+#ifndef GPS_TRACK_H__
+#define GPS_TRACK_H__
+
+#include <zephyr.h>
+#include <cloud_codec.h>
+
+/**@file
+ *
+ * @defgroup gps_track GPS track
+ * @brief    Module that removes GPS entries that carry no new information.
+ *
+ * Consecutive entries within the tolerance of each other are merged into
+ * the first one, which gets the length of the stay as duration. The
+ * remaining track is simplified with the Douglas-Peucker algorithm so that
+ * no dropped entry lies further than the tolerance from the track.
+ * @{
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Simplify the track made up by the queued entries of a GPS buffer.
+ *
+ * Entries that are dropped are dequeued, the buffer order is not changed.
+ * Entries with a sequence number are left out of the track and kept.
+ *
+ * @param[in, out] buf GPS buffer.
+ * @param[in] count Number of entries in the buffer.
+ * @param[in] tolerance Tolerance in meters. 0 disables simplification.
+ *
+ * @return Number of dequeued entries.
+ */
+int gps_track_simplify(struct cloud_data_gps *buf, size_t count,
+		       u32_t tolerance);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* k_malloc(), k_calloc() and k_free() are wrapped at link time, see
+ * CMakeLists.txt, so every allocation from the system heap passes through
+ * here: cJSON, the codec, AWS IoT, FOTA and the download client alike.
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include "heap_monitor.h"
+#include <flight_recorder.h>
+
+#if defined(CONFIG_SHELL)
+#include <shell/shell.h>
+#endif
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(heap_monitor, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+/* k_malloc() keeps the id of its k_mem_pool block in front of each
+ * allocation, the size of the block follows from its level. The blocks of
+ * k_malloc() are marked in a bitmap with a bit per smallest block of the
+ * heap, which tells them from those k_free() gets from z_thread_malloc(),
+ * the thread resource pool allocations of queues for instance.
+ */
+#if defined(CONFIG_MEM_POOL_HEAP_BACKEND)
+#error "The heap monitor needs the blocks of the buddy allocator"
+#endif
+
+#define BLOCK_ID_SIZE WB_UP(sizeof(struct k_mem_block_id))
+
+extern struct k_mem_pool _heap_mem_pool;
+
+static ATOMIC_DEFINE(owned,
+		     CONFIG_HEAP_MEM_POOL_SIZE / CONFIG_HEAP_MEM_POOL_MIN_SIZE);
+
+void *__real_k_malloc(size_t size);
+void __real_k_free(void *ptr);
+
+static const char *const site_names[HEAP_MONITOR_SITE_COUNT] = {
+	[HEAP_MONITOR_SITE_OTHER] = "other",
+	[HEAP_MONITOR_SITE_CODEC] = "codec",
+	[HEAP_MONITOR_SITE_FOTA] = "fota",
+};
+
+static atomic_t used;
+static atomic_t peak;
+static atomic_t fail[HEAP_MONITOR_SITE_COUNT];
+static atomic_t fail_size;
+static atomic_t fail_used;
+static atomic_t default_site;
+
+/* The site of a thread is kept in its custom data, offset by one so that
+ * NULL means none.
+ */
+static enum heap_monitor_site site_current(void)
+{
+	uintptr_t site = (uintptr_t)k_thread_custom_data_get();
+
+	if (site == 0) {
+		return (enum heap_monitor_site)atomic_get(&default_site);
+	}
+
+	return (enum heap_monitor_site)(site - 1);
+}
+
+void heap_monitor_site_enter(enum heap_monitor_site site)
+{
+	k_thread_custom_data_set((void *)(uintptr_t)(site + 1));
+}
+
+void heap_monitor_site_exit(void)
+{
+	k_thread_custom_data_set(NULL);
+}
+
+void heap_monitor_default_site_set(enum heap_monitor_site site)
+{
+	atomic_set(&default_site, site);
+}
+
+static void fail_count(size_t size)
+{
+	enum heap_monitor_site site = site_current();
+	atomic_val_t in_use = atomic_get(&used);
+
+	atomic_inc(&fail[site]);
+	atomic_set(&fail_size, size);
+	atomic_set(&fail_used, in_use);
+	flight_recorder_log(FLIGHT_RECORDER_HEAP_FAIL, site, size, in_use);
+	LOG_WRN("%s: allocation of %d bytes failed, %d in use",
+		site_names[site], (int)size, (int)in_use);
+}
+
+/* Index of the block of an allocation in the bitmap, -1 if the block is
+ * not in the heap. No two blocks start within the smallest block size.
+ */
+static int block_index(void *ptr)
+{
+	u8_t *block = (u8_t *)ptr - BLOCK_ID_SIZE;
+	u8_t *buf = _heap_mem_pool.base.buf;
+
+	if (block < buf || block >= buf + CONFIG_HEAP_MEM_POOL_SIZE) {
+		return -1;
+	}
+
+	return (block - buf) / CONFIG_HEAP_MEM_POOL_MIN_SIZE;
+}
+
+/* The buddy allocator splits a block into four on each level. */
+static size_t block_size(void *ptr)
+{
+	const struct k_mem_block_id *id =
+		(const struct k_mem_block_id *)((u8_t *)ptr - BLOCK_ID_SIZE);
+	size_t size = _heap_mem_pool.base.max_sz;
+
+	for (int i = 0; i < id->level; i++) {
+		size = WB_DN(size / 4);
+	}
+
+	return size;
+}
+
+void *__wrap_k_malloc(size_t size)
+{
+	void *ptr = __real_k_malloc(size);
+	size_t block;
+	atomic_val_t in_use;
+	atomic_val_t max;
+
+	if (ptr == NULL) {
+		fail_count(size);
+		return NULL;
+	}
+
+	block = block_size(ptr);
+	atomic_set_bit(owned, block_index(ptr));
+	in_use = atomic_add(&used, block) + block;
+
+	do {
+		max = atomic_get(&peak);
+	} while (in_use > max && !atomic_cas(&peak, max, in_use));
+
+	return ptr;
+}
+
+void *__wrap_k_calloc(size_t nmemb, size_t size)
+{
+	size_t bounds;
+	void *ret;
+
+	if (__builtin_mul_overflow(nmemb, size, &bounds)) {
+		return NULL;
+	}
+
+	ret = __wrap_k_malloc(bounds);
+	if (ret != NULL) {
+		memset(ret, 0, bounds);
+	}
+
+	return ret;
+}
+
+void __wrap_k_free(void *ptr)
+{
+	int i;
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	i = block_index(ptr);
+	if (i >= 0 && atomic_test_and_clear_bit(owned, i)) {
+		atomic_sub(&used, block_size(ptr));
+	}
+
+	__real_k_free(ptr);
+}
+
+void heap_monitor_stats_get(struct heap_monitor_stats *stats)
+{
+	stats->used = atomic_get(&used);
+	stats->peak = atomic_get(&peak);
+	stats->fail_size = atomic_get(&fail_size);
+	stats->fail_used = atomic_get(&fail_used);
+
+	for (int i = 0; i < HEAP_MONITOR_SITE_COUNT; i++) {
+		stats->fail[i] = atomic_get(&fail[i]);
+	}
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_heap(const struct shell *shell, size_t argc, char **argv)
+{
+	struct heap_monitor_stats stats;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	heap_monitor_stats_get(&stats);
+
+	shell_print(shell, "Heap size:     %d", CONFIG_HEAP_MEM_POOL_SIZE);
+	shell_print(shell, "Allocated:     %d (peak %d)", stats.used,
+		    stats.peak);
+
+	for (int i = 0; i < HEAP_MONITOR_SITE_COUNT; i++) {
+		shell_print(shell, "Failed, %-6s %d", site_names[i],
+			    stats.fail[i]);
+	}
+
+	if (stats.fail_size > 0) {
+		shell_print(shell, "Last failure:  %d bytes, %d allocated",
+			    stats.fail_size, stats.fail_used);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(heap, NULL, "Print heap usage", cmd_heap);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   Heap usage and allocation failure monitor.
+ */
+
+#ifndef HEAP_MONITOR_H__
+#define HEAP_MONITOR_H__
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Sites allocations are accounted to. */
+enum heap_monitor_site {
+	HEAP_MONITOR_SITE_OTHER,
+	HEAP_MONITOR_SITE_CODEC,
+	HEAP_MONITOR_SITE_FOTA,
+
+	HEAP_MONITOR_SITE_COUNT
+};
+
+/** @brief Heap statistics, in bytes of the heap blocks that hold the
+ *	   allocations, the allocator overhead and rounding included.
+ */
+struct heap_monitor_stats {
+	/** Bytes of the system heap currently in use. */
+	u32_t used;
+	/** Most bytes in use at once since boot. */
+	u32_t peak;
+	/** Failed allocations per site. */
+	u32_t fail[HEAP_MONITOR_SITE_COUNT];
+	/** Size of the last failed allocation, 0 if none failed. */
+	u32_t fail_size;
+	/** Bytes in use when the last allocation failed. */
+	u32_t fail_used;
+};
+
+#if defined(CONFIG_HEAP_MONITOR)
+/** @brief Account allocations of the calling thread to a site. */
+void heap_monitor_site_enter(enum heap_monitor_site site);
+
+/** @brief End the site of the calling thread set by
+ *	   heap_monitor_site_enter().
+ */
+void heap_monitor_site_exit(void);
+
+/** @brief Site of allocations from threads that have not entered one. */
+void heap_monitor_default_site_set(enum heap_monitor_site site);
+
+/**
+ * @brief Get the heap statistics.
+ *
+ * @param stats Statistics.
+ */
+void heap_monitor_stats_get(struct heap_monitor_stats *stats);
+#else
+static inline void heap_monitor_site_enter(enum heap_monitor_site site)
+{
+	ARG_UNUSED(site);
+}
+
+static inline void heap_monitor_site_exit(void)
+{
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HEAP_MONITOR_H__ */
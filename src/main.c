@@ -14,14 +14,35 @@
 #include <dfu/mcuboot.h>
 #include <date_time.h>
 #include <dk_buttons_and_leds.h>
-#include <math.h>
+#include <random/rand32.h>
 
 /* Application spesific module*/
 #include "gps_controller.h"
 #include "ext_sensors.h"
 #include "watchdog.h"
 #include "cloud_codec.h"
+#include "seq_ranges.h"
+#include "cloud_io.h"
 #include "ui.h"
+#include "gps_track.h"
+#include "heap_monitor.h"
+#include "metrics.h"
+#include "power_timeline.h"
+#include "flight_recorder.h"
+#include "wakeup.h"
+#include "broker_cache.h"
+
+#if defined(CONFIG_STACK_MONITOR)
+#include "stack_monitor.h"
+#endif
+
+#if defined(CONFIG_GPS_FILTER)
+#include "gps_filter.h"
+#endif
+
+#if defined(CONFIG_GEOFENCE)
+#include "geofence.h"
+#endif
 
 #include <logging/log.h>
 LOG_MODULE_REGISTER(cat_tracker, CONFIG_CAT_TRACKER_LOG_LEVEL);
@@ -35,8 +56,24 @@ LOG_MODULE_REGISTER(cat_tracker, CONFIG_CAT_TRACKER_LOG_LEVEL);
 #define BATCH_TOPIC_LEN (AWS_CLOUD_CLIENT_ID_LEN + 6)
 #define MESSAGES_TOPIC "%s/messages"
 #define MESSAGES_TOPIC_LEN (AWS_CLOUD_CLIENT_ID_LEN + 9)
-
-enum app_endpoint_type { CLOUD_EP_TOPIC_MESSAGES = CLOUD_EP_PRIV_START };
+#define AGPS_REQUEST_TOPIC "%s/agps/get"
+#define AGPS_REQUEST_TOPIC_LEN (AWS_CLOUD_CLIENT_ID_LEN + 9)
+#define AGPS_TOPIC "%s/agps"
+#define AGPS_TOPIC_LEN (AWS_CLOUD_CLIENT_ID_LEN + 5)
+#define ACK_TOPIC "%s/ack"
+#define ACK_TOPIC_LEN (AWS_CLOUD_CLIENT_ID_LEN + 4)
+
+/* Periodic work and the sleep of the main loop tolerate running this much
+ * later than their delay, to share wakeups.
+ */
+#define PERIOD_SLACK(delay) ((delay) / 16)
+
+enum app_endpoint_type {
+	CLOUD_EP_TOPIC_MESSAGES = CLOUD_EP_PRIV_START,
+	CLOUD_EP_TOPIC_AGPS_REQUEST,
+	CLOUD_EP_TOPIC_AGPS,
+	CLOUD_EP_TOPIC_ACK
+};
 
 static struct cloud_data_gps gps_buf[CONFIG_GPS_BUFFER_MAX];
 static struct cloud_data_sensors sensors_buf[CONFIG_SENSOR_BUFFER_MAX];
@@ -44,13 +81,20 @@ static struct cloud_data_modem modem_buf[CONFIG_MODEM_BUFFER_MAX];
 static struct cloud_data_ui ui_buf[CONFIG_UI_BUFFER_MAX];
 static struct cloud_data_accelerometer accel_buf[CONFIG_ACCEL_BUFFER_MAX];
 static struct cloud_data_battery bat_buf[CONFIG_BAT_BUFFER_MAX];
+#if defined(CONFIG_GEOFENCE)
+static struct cloud_data_geofence_evt geofence_buf[CONFIG_GEOFENCE_EVT_BUFFER_MAX];
+/* Filled by the GPS handler, encoded on the system workqueue. */
+K_MUTEX_DEFINE(geofence_buf_lock);
+#endif
 
 static struct cloud_data_cfg cfg = { .gpst = 60,
 				     .act = true,
 				     .actw = 60,
 				     .pasw = 60,
 				     .movt = 3600,
-				     .acct = 100 };
+				     .acct = 100,
+				     .trkt = CONFIG_GPS_TRACK_TOLERANCE_M,
+				     .prec = CLOUD_DATA_PREC_DEFAULT };
 
 /** Head of circular buffers. */
 static int head_gps_buf;
@@ -59,23 +103,61 @@ static int head_modem_buf;
 static int head_ui_buf;
 static int head_accel_buf;
 static int head_bat_buf;
+#if defined(CONFIG_GEOFENCE)
+static int head_geofence_buf;
+#endif
+
+/** Next sequence number of each buffer. */
+static u32_t stream_seq[CLOUD_DATA_STREAM_COUNT];
 
-static struct cloud_endpoint sub_ep_topics_sub[1];
-static struct cloud_endpoint pub_ep_topics_sub[2];
+static struct cloud_endpoint sub_ep_topics_sub[3];
+static struct cloud_endpoint pub_ep_topics_sub[3];
 
 static char client_id_buf[AWS_CLOUD_CLIENT_ID_LEN + 1];
 static char batch_topic[BATCH_TOPIC_LEN + 1];
 static char cfg_topic[CFG_TOPIC_LEN + 1];
 static char messages_topic[MESSAGES_TOPIC_LEN + 1];
+static char agps_request_topic[AGPS_REQUEST_TOPIC_LEN + 1];
+static char agps_topic[AGPS_TOPIC_LEN + 1];
+static char ack_topic[ACK_TOPIC_LEN + 1];
 
 static struct modem_param_info modem_param;
 static struct cloud_backend *cloud_backend;
 
 static bool gps_fix;
+/** Uptime of the start of the GPS search awaiting its first fix, or 0. */
+static atomic_t gps_search_ts;
+#if defined(CONFIG_GPS_FILTER)
+/** Set when the track of the filter no longer applies. The filter is only
+ *  touched by the GPS handler, which resets it.
+ */
+static atomic_t gps_filter_stale;
+#endif
 
 static bool cloud_connected;
 static bool initial_cloud_connection;
 
+/** States of the cloud connection, driven by the cloud poll thread. */
+enum cloud_conn_state {
+	/** Waiting for LTE registration and a valid date time. */
+	CLOUD_CONN_STATE_LINK_WAIT,
+	CLOUD_CONN_STATE_CONNECTING,
+	CLOUD_CONN_STATE_CONNECTED,
+	/** Waiting before the next connection attempt. */
+	CLOUD_CONN_STATE_BACKOFF,
+};
+
+static atomic_t lte_registered;
+
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+/** A-GPS data requested by the GPS driver and not yet fetched. Written by
+ *  the GPS handler and encoded on the system workqueue, under the lock.
+ */
+static struct gps_agps_request agps_request;
+static struct k_spinlock agps_request_lock;
+static atomic_t agps_request_pending;
+#endif
+
 static struct k_delayed_work device_config_get_work;
 static struct k_delayed_work device_config_send_work;
 static struct k_delayed_work data_send_work;
@@ -84,16 +166,27 @@ static struct k_delayed_work ui_send_work;
 static struct k_delayed_work leds_set_work;
 static struct k_delayed_work mov_timeout_work;
 static struct k_delayed_work sample_data_work;
+static struct k_delayed_work agps_request_work;
+static struct k_delayed_work geofence_send_work;
+static struct k_delayed_work health_send_work;
+static struct k_delayed_work metrics_send_work;
+static struct k_delayed_work power_day_work;
 
 K_SEM_DEFINE(accel_trig_sem, 0, 1);
 K_SEM_DEFINE(gps_timeout_sem, 0, 1);
 K_SEM_DEFINE(cloud_conn_sem, 0, 1);
+K_SEM_DEFINE(date_time_sem, 0, 1);
 
 void error_handler(int err_code)
 {
 	LOG_ERR("err_handler, error code: %d", err_code);
 	ui_led_set_pattern(UI_LED_ERROR_SYSTEM_FAULT);
 
+#if defined(CONFIG_FLIGHT_RECORDER)
+	flight_recorder_log(FLIGHT_RECORDER_ERROR, err_code, 0, 0);
+	flight_recorder_dump(NULL, NULL);
+#endif
+
 #if !defined(CONFIG_DEBUG) && defined(CONFIG_REBOOT)
 	LOG_PANIC();
 	sys_reboot(0);
@@ -128,6 +221,37 @@ static int device_mode_check(void)
 	return cfg.actw;
 }
 
+/** Seconds in between fixes if the GPS should keep tracking, 0 if a single
+ *  fix search should be done every publication interval.
+ */
+static u32_t gps_tracking_interval(void)
+{
+	if (cfg.act &&
+	    device_mode_check() <= CONFIG_GPS_CONTROL_TRACKING_INTERVAL_MAX_SEC) {
+		return device_mode_check();
+	}
+
+	return 0;
+}
+
+/** Drop the filter track when the device mode or the tracking interval
+ *  changes, fixes from before are no base for the next ones.
+ */
+static void gps_filter_mode_set(bool act, u32_t interval)
+{
+#if defined(CONFIG_GPS_FILTER)
+	static bool mode_act;
+	static u32_t mode_interval;
+
+	if (act != mode_act || interval != mode_interval) {
+		atomic_set(&gps_filter_stale, true);
+	}
+
+	mode_act = act;
+	mode_interval = interval;
+#endif
+}
+
 static void time_set(struct gps_pvt *gps_data)
 {
 	struct tm gps_time;
@@ -142,6 +266,47 @@ static void time_set(struct gps_pvt *gps_data)
 	gps_time.tm_sec = gps_data->datetime.seconds;
 
 	date_time_set(&gps_time);
+	k_sem_give(&date_time_sem);
+}
+
+static bool date_time_valid(void)
+{
+	s64_t now;
+
+	return date_time_now(&now) == 0;
+}
+
+/** Wait until date time is valid, for at most
+ *  CONFIG_CLOUD_CONNECT_DATE_TIME_TIMEOUT_SEC. TLS needs a valid time to
+ *  check the server certificate, but an attempt without one is better than
+ *  not connecting at all.
+ */
+static void date_time_wait(void)
+{
+	s64_t deadline = k_uptime_get() +
+			 K_SECONDS(CONFIG_CLOUD_CONNECT_DATE_TIME_TIMEOUT_SEC);
+
+	if (date_time_valid()) {
+		return;
+	}
+
+	date_time_update();
+
+	while (!date_time_valid()) {
+		s64_t time_left = deadline - k_uptime_get();
+
+		if (time_left <= 0) {
+			LOG_WRN("No valid date time, connecting anyway");
+			return;
+		}
+
+		/* The date time library does not notify when modem or NTP
+		 * time is obtained, only GPS time gives the semaphore.
+		 */
+		k_sem_take(&date_time_sem, MIN(time_left, K_MSEC(500)));
+	}
+
+	LOG_INF("Date time valid %lld ms after boot", k_uptime_get());
 }
 
 static void leds_set(void)
@@ -165,8 +330,14 @@ static void battery_buffer_populate(void)
 		head_bat_buf = 0;
 	}
 
+	if (bat_buf[head_bat_buf].queued) {
+		metrics_inc(METRICS_OVERWRITE_BAT);
+	}
+
 	bat_buf[head_bat_buf].bat = modem_param.device.battery.value;
 	bat_buf[head_bat_buf].bat_ts = k_uptime_get();
+	bat_buf[head_bat_buf].seq = stream_seq[CLOUD_DATA_STREAM_BAT]++;
+	bat_buf[head_bat_buf].unacked = false;
 	bat_buf[head_bat_buf].queued = true;
 
 	LOG_INF("Entry: %d of %d in battery buffer filled", head_bat_buf,
@@ -181,19 +352,43 @@ static void gps_buffer_populate(struct gps_pvt *gps_data)
 		head_gps_buf = 0;
 	}
 
+	if (gps_buf[head_gps_buf].queued) {
+		metrics_inc(METRICS_OVERWRITE_GPS);
+
+		/* A number is spent on an entry lost before it got one, so
+		 * that the cloud sees the gap.
+		 */
+		if (gps_buf[head_gps_buf].seq == CLOUD_DATA_SEQ_NONE) {
+			stream_seq[CLOUD_DATA_STREAM_GPS]++;
+		}
+	}
+
 	gps_buf[head_gps_buf].longi = gps_data->longitude;
 	gps_buf[head_gps_buf].lat = gps_data->latitude;
 	gps_buf[head_gps_buf].alt = gps_data->altitude;
 	gps_buf[head_gps_buf].acc = gps_data->accuracy;
 	gps_buf[head_gps_buf].spd = gps_data->speed;
 	gps_buf[head_gps_buf].hdg = gps_data->heading;
+	gps_buf[head_gps_buf].dur = 0;
 	gps_buf[head_gps_buf].gps_ts = k_uptime_get();
+	gps_buf[head_gps_buf].seq = CLOUD_DATA_SEQ_NONE;
+	gps_buf[head_gps_buf].unacked = false;
 	gps_buf[head_gps_buf].queued = true;
 
 	LOG_INF("Entry: %d of %d in GPS buffer filled", head_gps_buf,
 		CONFIG_GPS_BUFFER_MAX - 1);
 }
 
+/** Number a GPS entry on its first encoding. Entries dropped by track
+ *  simplification are never numbered and leave no gap in the stream.
+ */
+static void gps_seq_assign(struct cloud_data_gps *entry)
+{
+	if (entry->queued && entry->seq == CLOUD_DATA_SEQ_NONE) {
+		entry->seq = stream_seq[CLOUD_DATA_STREAM_GPS]++;
+	}
+}
+
 void acc_array_swap(struct cloud_data_accelerometer *xp,
 		    struct cloud_data_accelerometer *yp)
 {
@@ -229,6 +424,8 @@ static void accelerometer_buffer_populate(
 			}
 		}
 
+		metrics_inc(METRICS_OVERWRITE_ACC);
+
 		/** Sort list after highest values using bubble sort.
 		 */
 		for (j = 0; j < ARRAY_SIZE(accel_buf)-i-1; j++) {
@@ -280,6 +477,9 @@ populate_buffer:
 		accel_buf[head_accel_buf].values[1] = acc_data->value_array[1];
 		accel_buf[head_accel_buf].values[2] = acc_data->value_array[2];
 		accel_buf[head_accel_buf].ts = k_uptime_get();
+		accel_buf[head_accel_buf].seq =
+			stream_seq[CLOUD_DATA_STREAM_ACCEL]++;
+		accel_buf[head_accel_buf].unacked = false;
 		accel_buf[head_accel_buf].queued = true;
 
 		LOG_INF("Entry: %d of %d in accelerometer buffer filled",
@@ -315,6 +515,10 @@ static int modem_buffer_populate(void)
 		head_modem_buf = 0;
 	}
 
+	if (modem_buf[head_modem_buf].queued) {
+		metrics_inc(METRICS_OVERWRITE_ROAM);
+	}
+
 	modem_buf[head_modem_buf].ip =
 		modem_param.network.ip_address.value_string;
 	modem_buf[head_modem_buf].cell =
@@ -341,6 +545,8 @@ static int modem_buffer_populate(void)
 		modem_param.network.current_band.value;
 	modem_buf[head_modem_buf].mod_ts = k_uptime_get();
 	modem_buf[head_modem_buf].mod_ts_static = k_uptime_get();
+	modem_buf[head_modem_buf].seq = stream_seq[CLOUD_DATA_STREAM_MODEM]++;
+	modem_buf[head_modem_buf].unacked = false;
 	modem_buf[head_modem_buf].queued = true;
 
 	LOG_INF("Entry: %d of %d in modem buffer filled", head_modem_buf,
@@ -359,6 +565,10 @@ static int sensors_buffer_populate(void)
 		head_sensor_buf = 0;
 	}
 
+	if (sensors_buf[head_sensor_buf].queued) {
+		metrics_inc(METRICS_OVERWRITE_ENV);
+	}
+
 	/* Request data from external sensors. */
 	err = ext_sensors_temperature_get(&sensors_buf[head_sensor_buf].temp);
 	if (err) {
@@ -373,6 +583,9 @@ static int sensors_buffer_populate(void)
 	}
 
 	sensors_buf[head_sensor_buf].env_ts = k_uptime_get();
+	sensors_buf[head_sensor_buf].seq =
+		stream_seq[CLOUD_DATA_STREAM_SENSORS]++;
+	sensors_buf[head_sensor_buf].unacked = false;
 	sensors_buf[head_sensor_buf].queued = true;
 
 	LOG_INF("Entry: %d of %d in sensor buffer filled", head_sensor_buf,
@@ -389,8 +602,14 @@ static void ui_buffer_populate(int btn_number)
 		head_ui_buf = 0;
 	}
 
+	if (ui_buf[head_ui_buf].queued) {
+		metrics_inc(METRICS_OVERWRITE_BTN);
+	}
+
 	ui_buf[head_ui_buf].btn = 1;
 	ui_buf[head_ui_buf].btn_ts = k_uptime_get();
+	ui_buf[head_ui_buf].seq = stream_seq[CLOUD_DATA_STREAM_UI]++;
+	ui_buf[head_ui_buf].unacked = false;
 	ui_buf[head_ui_buf].queued = true;
 
 	LOG_INF("Entry: %d of %d in UI buffer filled", head_ui_buf,
@@ -403,6 +622,7 @@ static void lte_evt_handler(const struct lte_lc_evt *const evt)
 	case LTE_LC_EVT_NW_REG_STATUS:
 		if ((evt->nw_reg_status != LTE_LC_NW_REG_REGISTERED_HOME) &&
 		    (evt->nw_reg_status != LTE_LC_NW_REG_REGISTERED_ROAMING)) {
+			atomic_set(&lte_registered, 0);
 			k_sem_take(&cloud_conn_sem, K_NO_WAIT);
 			break;
 		}
@@ -412,29 +632,29 @@ static void lte_evt_handler(const struct lte_lc_evt *const evt)
 				"Connected to home network" :
 				"Connected to roaming network");
 
+		atomic_set(&lte_registered, 1);
 		k_sem_give(&cloud_conn_sem);
 		break;
 	case LTE_LC_EVT_PSM_UPDATE:
 		LOG_DBG("PSM parameter update: TAU: %d, Active time: %d",
 			evt->psm_cfg.tau, evt->psm_cfg.active_time);
+		power_timeline_psm_update(evt->psm_cfg.active_time);
 		break;
-	case LTE_LC_EVT_EDRX_UPDATE: {
-		char log_buf[60];
-		ssize_t len;
-
-		len = snprintf(log_buf, sizeof(log_buf),
-			       "eDRX parameter update: eDRX: %f, PTW: %f",
-			       evt->edrx_cfg.edrx, evt->edrx_cfg.ptw);
-		if (len > 0) {
-			LOG_DBG("%s", log_strdup(log_buf));
-		}
+	case LTE_LC_EVT_EDRX_UPDATE:
+		LOG_DBG("eDRX parameter update: eDRX: %d ms, PTW: %d ms",
+			(int)(evt->edrx_cfg.edrx * 1000),
+			(int)(evt->edrx_cfg.ptw * 1000));
 		break;
-	}
 	case LTE_LC_EVT_RRC_UPDATE:
 		LOG_DBG("RRC mode: %s",
 			evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED ?
 				"Connected" :
 				"Idle");
+		power_timeline_rrc_update(evt->rrc_mode ==
+					  LTE_LC_RRC_MODE_CONNECTED);
+		flight_recorder_log(FLIGHT_RECORDER_RRC,
+				    evt->rrc_mode == LTE_LC_RRC_MODE_CONNECTED,
+				    0, 0);
 		break;
 	case LTE_LC_EVT_CELL_UPDATE:
 		LOG_DBG("LTE cell changed: Cell ID: %d, Tracking area: %d",
@@ -452,6 +672,11 @@ static void ext_sensors_evt_handler(const struct ext_sensor_evt *const evt)
 	case EXT_SENSOR_EVT_ACCELEROMETER_TRIGGER:
 		if (!cfg.act) {
 			accelerometer_buffer_populate(evt);
+
+			if (k_sem_count_get(&accel_trig_sem) > 0) {
+				metrics_inc(METRICS_ACCEL_TRIGGER_DROP);
+			}
+
 			k_sem_give(&accel_trig_sem);
 		}
 		break;
@@ -475,19 +700,46 @@ static int modem_configure(void)
 	return err;
 }
 
-static void device_config_get(void)
+/** Hand a message over to the cloud I/O thread, releases it on failure. */
+static int cloud_msg_queue(struct cloud_msg *msg, enum cloud_io_prio prio)
 {
 	int err;
 
+	err = cloud_io_send(msg, prio);
+	if (err) {
+		LOG_ERR("Message not queued, error: %d", err);
+
+		if (msg->len > 0) {
+			cloud_codec_release_data(msg);
+		}
+	}
+
+	return err;
+}
+
+/** Dequeue the entries encoded in a data message once it is queued, or keep
+ *  them queued if it was not.
+ */
+static void data_commit(bool queued)
+{
+	cloud_codec_gps_buffer_commit(gps_buf, queued);
+	cloud_codec_modem_buffer_commit(modem_buf, queued);
+	cloud_codec_ui_buffer_commit(ui_buf, queued);
+	cloud_codec_bat_buffer_commit(bat_buf, queued);
+#if defined(CONFIG_EXTERNAL_SENSORS)
+	cloud_codec_sensor_buffer_commit(sensors_buf, queued);
+	cloud_codec_accel_buffer_commit(accel_buf, queued);
+#endif
+}
+
+static void device_config_get(void)
+{
 	struct cloud_msg msg = { .qos = CLOUD_QOS_AT_MOST_ONCE,
 				 .endpoint.type = CLOUD_EP_TOPIC_STATE,
 				 .buf = "",
 				 .len = 0 };
 
-	err = cloud_send(cloud_backend, &msg);
-	if (err) {
-		LOG_ERR("Cloud send failed, err: %d", err);
-	}
+	cloud_msg_queue(&msg, CLOUD_IO_PRIO_CONFIG);
 }
 
 static void ui_send(void)
@@ -506,19 +758,120 @@ static void ui_send(void)
 				      &ui_buf[head_ui_buf],
 				      &accel_buf[head_accel_buf],
 				      &bat_buf[head_bat_buf],
-				      CLOUD_DATA_ENCODE_UI);
+				      CLOUD_DATA_ENCODE_BTN);
 	if (err) {
 		LOG_ERR("cloud_encode_button_message_data, error: %d", err);
+		data_commit(false);
 		return;
 	}
 
-	err = cloud_send(cloud_backend, &msg);
-	cloud_codec_release_data(&msg);
+	err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_ALERT);
+	data_commit(err == 0);
+}
+
+#if defined(CONFIG_GEOFENCE)
+static void geofence_buffer_populate(const struct geofence_evt *evt)
+{
+	k_mutex_lock(&geofence_buf_lock, K_FOREVER);
+
+	/* Go to start of buffer if end is reached. */
+	head_geofence_buf += 1;
+	if (head_geofence_buf == CONFIG_GEOFENCE_EVT_BUFFER_MAX) {
+		head_geofence_buf = 0;
+	}
+
+	if (geofence_buf[head_geofence_buf].queued) {
+		metrics_inc(METRICS_OVERWRITE_GEO);
+	}
+
+	geofence_buf[head_geofence_buf].ts = k_uptime_get();
+	geofence_buf[head_geofence_buf].id = evt->id;
+	geofence_buf[head_geofence_buf].enter =
+		(evt->type == GEOFENCE_EVT_ENTER);
+	geofence_buf[head_geofence_buf].queued = true;
+
+	LOG_INF("Entry: %d of %d in geofence buffer filled", head_geofence_buf,
+		CONFIG_GEOFENCE_EVT_BUFFER_MAX - 1);
+
+	k_mutex_unlock(&geofence_buf_lock);
+}
+
+static void geofence_send(void)
+{
+	int err;
+	bool queued = false;
+
+	struct cloud_msg msg = { .qos = CLOUD_QOS_AT_MOST_ONCE,
+				 .endpoint = pub_ep_topics_sub[1] };
+
+	if (!cloud_connected) {
+		return;
+	}
+
+	/* Held until the entries are committed, so that none is overwritten
+	 * in between.
+	 */
+	k_mutex_lock(&geofence_buf_lock, K_FOREVER);
+
+	for (int i = 0; i < CONFIG_GEOFENCE_EVT_BUFFER_MAX; i++) {
+		queued |= geofence_buf[i].queued;
+	}
+
+	if (!queued) {
+		k_mutex_unlock(&geofence_buf_lock);
+		return;
+	}
+
+	err = cloud_codec_encode_geofence_buffer(&msg, geofence_buf);
 	if (err) {
-		LOG_ERR("Cloud send failed, err: %d", err);
+		LOG_ERR("cloud_codec_encode_geofence_buffer, error: %d", err);
+		cloud_codec_geofence_buffer_commit(geofence_buf, false);
+		k_mutex_unlock(&geofence_buf_lock);
+		return;
+	}
+
+	err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_ALERT);
+	cloud_codec_geofence_buffer_commit(geofence_buf, err == 0);
+	k_mutex_unlock(&geofence_buf_lock);
+	if (err) {
+		return;
 	}
+
+	/* A message carries at most CONFIG_ENCODED_BUFFER_ENTRIES_MAX events,
+	 * the rest go in the next one.
+	 */
+	k_delayed_work_submit(&geofence_send_work, K_NO_WAIT);
+}
+
+static void geofence_evt_handler(const struct geofence_evt *evt)
+{
+	geofence_buffer_populate(evt);
+	k_delayed_work_submit(&geofence_send_work, K_NO_WAIT);
 }
 
+/** While zones are configured, only transitions and every
+ *  CONFIG_GEOFENCE_FIX_DECIMATION-th fix are worth reporting.
+ */
+static bool geofence_fix_report(const struct gps_pvt *pvt)
+{
+	static int fix_cnt;
+
+	if (geofence_evaluate(pvt->latitude, pvt->longitude) > 0 ||
+	    geofence_count() == 0) {
+		fix_cnt = 0;
+		return true;
+	}
+
+	fix_cnt++;
+	if (fix_cnt >= CONFIG_GEOFENCE_FIX_DECIMATION) {
+		fix_cnt = 0;
+		return true;
+	}
+
+	return false;
+}
+#endif /* CONFIG_GEOFENCE */
+
 static void device_config_send(void)
 {
 	int err;
@@ -535,45 +888,197 @@ static void device_config_send(void)
 		return;
 	}
 
-	err = cloud_send(cloud_backend, &msg);
-	cloud_codec_release_data(&msg);
+	cloud_msg_queue(&msg, CLOUD_IO_PRIO_CONFIG);
+}
+
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+/* Called by the GPS driver when it needs assistance data. */
+static void agps_request_update(const struct gps_agps_request *needed)
+{
+	int err;
+	k_spinlock_key_t key;
+	struct gps_agps_request request = *needed;
+
+	/* Inject what is known locally, fetch the rest. */
+	err = gps_control_agps_seed(&request);
+	if (err) {
+		LOG_WRN("A-GPS not seeded, error: %d", err);
+	}
+
+	key = k_spin_lock(&agps_request_lock);
+	agps_request = request;
+	k_spin_unlock(&agps_request_lock, key);
+	atomic_set(&agps_request_pending, 1);
+
+	if (cloud_connected) {
+		k_delayed_work_submit(&agps_request_work, K_NO_WAIT);
+	}
+}
+
+static void agps_request_send(void)
+{
+	int err;
+	k_spinlock_key_t key;
+	struct gps_agps_request request;
+
+	struct cloud_msg msg = { .qos = CLOUD_QOS_AT_MOST_ONCE,
+				 .endpoint = pub_ep_topics_sub[2] };
+
+	if (!atomic_cas(&agps_request_pending, 1, 0)) {
+		return;
+	}
+
+	key = k_spin_lock(&agps_request_lock);
+	request = agps_request;
+	k_spin_unlock(&agps_request_lock, key);
+
+	err = cloud_codec_encode_agps_request(&msg, &request);
+	if (err) {
+		LOG_ERR("A-GPS request not encoded, error: %d", err);
+		return;
+	}
+
+	err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_LIVE);
+	if (err) {
+		atomic_set(&agps_request_pending, 1);
+	}
+}
+#endif
+
+#if defined(CONFIG_HEAP_MONITOR)
+static void health_send(void)
+{
+	int err;
+	struct heap_monitor_stats stats;
+	struct cloud_data_health health = { 0 };
+#if defined(CONFIG_STACK_MONITOR)
+	/* Too large for the system workqueue stack. */
+	static struct stack_monitor_thread
+		stacks[CONFIG_STACK_MONITOR_THREADS_MAX];
+#endif
+
+	struct cloud_msg msg = { .qos = CLOUD_QOS_AT_MOST_ONCE,
+				 .endpoint = pub_ep_topics_sub[1] };
+
+	heap_monitor_stats_get(&stats);
+
+#if defined(CONFIG_STACK_MONITOR)
+	health.stacks = stacks;
+	health.stack_cnt = stack_monitor_get(stacks, ARRAY_SIZE(stacks));
+#endif
+
+	health.heap_used = stats.used;
+	health.heap_peak = stats.peak;
+	health.fail_codec = stats.fail[HEAP_MONITOR_SITE_CODEC];
+	health.fail_fota = stats.fail[HEAP_MONITOR_SITE_FOTA];
+	health.fail_other = stats.fail[HEAP_MONITOR_SITE_OTHER];
+	health.fail_size = stats.fail_size;
+	health.fail_used = stats.fail_used;
+	health.ts = k_uptime_get();
+
+	err = cloud_codec_encode_health(&msg, &health);
+	if (err) {
+		LOG_ERR("Health not encoded, error: %d", err);
+		return;
+	}
+
+	cloud_msg_queue(&msg, CLOUD_IO_PRIO_BACKLOG);
+}
+#endif
+
+#if defined(CONFIG_POWER_TIMELINE)
+static void power_summary_send(bool daily)
+{
+	int err;
+	struct power_timeline_summary summary;
+
+	struct cloud_msg msg = { .qos = CLOUD_QOS_AT_MOST_ONCE };
+
+	if (daily) {
+		power_timeline_day_end(&summary);
+		msg.endpoint = pub_ep_topics_sub[1];
+	} else {
+		power_timeline_cycle_end(&summary);
+		msg.endpoint = pub_ep_topics_sub[0];
+	}
+
+	LOG_INF("%s power: %d ms connected in %d connections, %d ms idle, "
+		"%d ms PSM, %d ms GPS, of %d ms", daily ? "Daily" : "Cycle",
+		summary.connected, summary.connections, summary.idle,
+		summary.psm, summary.gps, summary.period);
+
+	if (!daily && !IS_ENABLED(CONFIG_POWER_TIMELINE_CYCLE_REPORT)) {
+		return;
+	}
+
+	err = cloud_codec_encode_power(&msg, &summary, daily);
+	if (err) {
+		LOG_ERR("Power summary not encoded, error: %d", err);
+		return;
+	}
+
+	cloud_msg_queue(&msg, CLOUD_IO_PRIO_BACKLOG);
+}
+#endif
+
+#if defined(CONFIG_METRICS)
+static void metrics_send(void)
+{
+	int err;
+	struct metrics_snapshot snapshot;
+
+	struct cloud_msg msg = { .qos = CLOUD_QOS_AT_MOST_ONCE,
+				 .endpoint = pub_ep_topics_sub[0] };
+
+	metrics_snapshot_get(&snapshot);
+
+	err = cloud_codec_encode_metrics(&msg, &snapshot);
+	if (err == -EAGAIN) {
+		LOG_INF("No metrics to report");
+		return;
+	} else if (err) {
+		LOG_ERR("Metrics not encoded, error: %d", err);
+		return;
+	}
+
+	err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_BACKLOG);
 	if (err) {
-		LOG_ERR("Cloud send failed, err: %d", err);
+		return;
 	}
+
+	metrics_consume(&snapshot);
 }
+#endif
 
 static void data_send(void)
 {
 	int err;
-	enum cloud_data_encode_schema pub_schema;
+	u32_t pub_schema = CLOUD_DATA_ENCODE_BAT | CLOUD_DATA_ENCODE_ROAM |
+			   CLOUD_DATA_ENCODE_ENV;
 
 	/** Data encoded depending on mode, obtained gps fix and
 	 * accelerometer trigger.
 	 */
 
 	if (!initial_cloud_connection) {
-		pub_schema = CLOUD_DATA_ENCODE_MSTAT_MDYN_SENS_BAT;
+		pub_schema |= CLOUD_DATA_ENCODE_DEV;
 	} else {
-		if (cfg.act && !gps_fix) {
-			pub_schema = CLOUD_DATA_ENCODE_MDYN_SENS_BAT;
-		}
-
-		if (cfg.act && gps_fix) {
-			pub_schema = CLOUD_DATA_ENCODE_MDYN_SENS_BAT_GPS;
+		if (gps_fix) {
+			pub_schema |= CLOUD_DATA_ENCODE_GPS;
 		}
 
-		if (!cfg.act && !gps_fix) {
-			pub_schema = CLOUD_DATA_ENCODE_MDYN_SENS_BAT_ACCEL;
-		}
-
-		if (!cfg.act && gps_fix) {
-			pub_schema = CLOUD_DATA_ENCODE_MDYN_SENS_BAT_GPS_ACCEL;
+		if (!cfg.act) {
+			pub_schema |= CLOUD_DATA_ENCODE_ACC;
 		}
 	}
 
 	struct cloud_msg msg = { .qos = CLOUD_QOS_AT_MOST_ONCE,
 				 .endpoint.type = CLOUD_EP_TOPIC_MSG };
 
+	if (pub_schema & CLOUD_DATA_ENCODE_GPS) {
+		gps_seq_assign(&gps_buf[head_gps_buf]);
+	}
+
 	err = cloud_codec_encode_data(&msg,
 				      &gps_buf[head_gps_buf],
 				      &sensors_buf[head_sensor_buf],
@@ -584,30 +1089,92 @@ static void data_send(void)
 				      pub_schema);
 	if (err) {
 		LOG_ERR("Error enconding message %d", err);
+		data_commit(false);
 		return;
 	}
 
-	err = cloud_send(cloud_backend, &msg);
-	cloud_codec_release_data(&msg);
+	err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_LIVE);
+	data_commit(err == 0);
 	if (err) {
-		LOG_ERR("Cloud send failed, err: %d", err);
 		return;
 	}
 
+	if (!initial_cloud_connection) {
+		LOG_INF("First data queued %lld ms after boot",
+			k_uptime_get());
+	}
+
 	gps_fix = false;
 	initial_cloud_connection = true;
 }
 
+/** Postpone the rest of the buffer drain while the publish queue is full. */
+static bool buffered_data_send_defer(void)
+{
+	if (cloud_io_free_space(CLOUD_IO_PRIO_BACKLOG) > 0) {
+		return false;
+	}
+
+	LOG_INF("Publish queue full, buffered data send deferred");
+	k_delayed_work_submit(&buffered_data_send_work,
+			      K_MSEC(CONFIG_CLOUD_IO_BACKPRESSURE_DELAY_MS));
+
+	return true;
+}
+
+#if defined(CONFIG_CLOUD_CODEC_SEQ)
+static void ack_process(char *buf)
+{
+	int err;
+	int resend_cnt = 0;
+	static struct cloud_data_ack ack;
+
+	err = cloud_codec_decode_ack(buf, &ack);
+	if (err) {
+		LOG_ERR("Acknowledgment not decoded, error: %d", err);
+		return;
+	}
+
+	resend_cnt += SEQ_RANGES_APPLY(gps_buf, &ack, CLOUD_DATA_STREAM_GPS);
+	resend_cnt += SEQ_RANGES_APPLY(sensors_buf, &ack,
+				       CLOUD_DATA_STREAM_SENSORS);
+	resend_cnt += SEQ_RANGES_APPLY(modem_buf, &ack,
+				       CLOUD_DATA_STREAM_MODEM);
+	resend_cnt += SEQ_RANGES_APPLY(ui_buf, &ack, CLOUD_DATA_STREAM_UI);
+	resend_cnt += SEQ_RANGES_APPLY(accel_buf, &ack,
+				       CLOUD_DATA_STREAM_ACCEL);
+	resend_cnt += SEQ_RANGES_APPLY(bat_buf, &ack, CLOUD_DATA_STREAM_BAT);
+
+	if (resend_cnt > 0) {
+		LOG_INF("%d entries reported missing, sending again",
+			resend_cnt);
+		k_delayed_work_submit(&buffered_data_send_work, K_NO_WAIT);
+	}
+}
+#endif /* CONFIG_CLOUD_CODEC_SEQ */
+
 static void buffered_data_send(void)
 {
 	int err;
 	bool queued_entries = false;
 
 	struct cloud_msg msg = {
-		.qos = CLOUD_QOS_AT_MOST_ONCE,
+		.qos = IS_ENABLED(CONFIG_CLOUD_IO_QOS1) ?
+			       CLOUD_QOS_AT_LEAST_ONCE :
+			       CLOUD_QOS_AT_MOST_ONCE,
 		.endpoint = pub_ep_topics_sub[0],
 	};
 
+	/* Drop entries that add nothing to the track before encoding, the
+	 * remaining ones are numbered oldest first.
+	 */
+	gps_track_simplify(gps_buf, ARRAY_SIZE(gps_buf), cfg.trkt);
+
+	for (int i = 1; i <= CONFIG_GPS_BUFFER_MAX; i++) {
+		gps_seq_assign(
+			&gps_buf[(head_gps_buf + i) % CONFIG_GPS_BUFFER_MAX]);
+	}
+
 check_gps_buffer:
 
 	/* Check if it exists queued entries in the gps buffer. */
@@ -621,23 +1188,28 @@ check_gps_buffer:
 	}
 
 	if (queued_entries) {
+		if (buffered_data_send_defer()) {
+			return;
+		}
+
 		/* Encode and send queued entries in batches. */
 		err = cloud_codec_encode_gps_buffer(&msg, gps_buf);
 		if (err) {
 			LOG_ERR("Error encoding GPS buffer: %d", err);
+			cloud_codec_gps_buffer_commit(gps_buf, false);
 			return;
 		}
 
-		err = cloud_send(cloud_backend, &msg);
-		cloud_codec_release_data(&msg);
+		err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_BACKLOG);
+		cloud_codec_gps_buffer_commit(gps_buf, err == 0);
 		if (err) {
-			LOG_ERR("Cloud send failed, err: %d", err);
 			return;
 		}
 
 		goto check_gps_buffer;
 	}
 
+#if defined(CONFIG_EXTERNAL_SENSORS)
 check_sensors_buffer:
 
 	/* Check if it exists queued entries in the gps buffer. */
@@ -651,22 +1223,27 @@ check_sensors_buffer:
 	}
 
 	if (queued_entries) {
+		if (buffered_data_send_defer()) {
+			return;
+		}
+
 		/* Encode and send queued entries in batches. */
 		err = cloud_codec_encode_sensor_buffer(&msg, sensors_buf);
 		if (err) {
 			LOG_ERR("Error encoding sensors buffer: %d", err);
+			cloud_codec_sensor_buffer_commit(sensors_buf, false);
 			return;
 		}
 
-		err = cloud_send(cloud_backend, &msg);
-		cloud_codec_release_data(&msg);
+		err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_BACKLOG);
+		cloud_codec_sensor_buffer_commit(sensors_buf, err == 0);
 		if (err) {
-			LOG_ERR("Cloud send failed, err: %d", err);
 			return;
 		}
 
 		goto check_sensors_buffer;
 	}
+#endif
 
 check_modem_buffer:
 
@@ -681,17 +1258,21 @@ check_modem_buffer:
 	}
 
 	if (queued_entries) {
+		if (buffered_data_send_defer()) {
+			return;
+		}
+
 		/* Encode and send queued entries in batches. */
 		err = cloud_codec_encode_modem_buffer(&msg, modem_buf);
 		if (err) {
 			LOG_ERR("Error encoding modem buffer: %d", err);
+			cloud_codec_modem_buffer_commit(modem_buf, false);
 			return;
 		}
 
-		err = cloud_send(cloud_backend, &msg);
-		cloud_codec_release_data(&msg);
+		err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_BACKLOG);
+		cloud_codec_modem_buffer_commit(modem_buf, err == 0);
 		if (err) {
-			LOG_ERR("Cloud send failed, err: %d", err);
 			return;
 		}
 
@@ -711,23 +1292,28 @@ check_ui_buffer:
 	}
 
 	if (queued_entries) {
+		if (buffered_data_send_defer()) {
+			return;
+		}
+
 		/* Encode and send queued entries in batches. */
 		err = cloud_codec_encode_ui_buffer(&msg, ui_buf);
 		if (err) {
 			LOG_ERR("Error encoding modem buffer: %d", err);
+			cloud_codec_ui_buffer_commit(ui_buf, false);
 			return;
 		}
 
-		err = cloud_send(cloud_backend, &msg);
-		cloud_codec_release_data(&msg);
+		err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_BACKLOG);
+		cloud_codec_ui_buffer_commit(ui_buf, err == 0);
 		if (err) {
-			LOG_ERR("Cloud send failed, err: %d", err);
 			return;
 		}
 
 		goto check_ui_buffer;
 	}
 
+#if defined(CONFIG_EXTERNAL_SENSORS)
 check_accel_buffer:
 
 	/* Check if it exists queued entries in the gps buffer. */
@@ -744,22 +1330,27 @@ check_accel_buffer:
 	 * passive device mode.
 	 */
 	if (queued_entries && !cfg.act) {
+		if (buffered_data_send_defer()) {
+			return;
+		}
+
 		/* Encode and send queued entries in batches. */
 		err = cloud_codec_encode_accel_buffer(&msg, accel_buf);
 		if (err) {
 			LOG_ERR("Error encoding accelerometer buffer: %d", err);
+			cloud_codec_accel_buffer_commit(accel_buf, false);
 			return;
 		}
 
-		err = cloud_send(cloud_backend, &msg);
-		cloud_codec_release_data(&msg);
+		err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_BACKLOG);
+		cloud_codec_accel_buffer_commit(accel_buf, err == 0);
 		if (err) {
-			LOG_ERR("Cloud send failed, err: %d", err);
 			return;
 		}
 
 		goto check_accel_buffer;
 	}
+#endif
 
 check_battery_buffer:
 
@@ -774,17 +1365,21 @@ check_battery_buffer:
 	}
 
 	if (queued_entries) {
+		if (buffered_data_send_defer()) {
+			return;
+		}
+
 		/* Encode and send queued entries in batches. */
 		err = cloud_codec_encode_bat_buffer(&msg, bat_buf);
 		if (err) {
 			LOG_ERR("Error encoding accelerometer buffer: %d", err);
+			cloud_codec_bat_buffer_commit(bat_buf, false);
 			return;
 		}
 
-		err = cloud_send(cloud_backend, &msg);
-		cloud_codec_release_data(&msg);
+		err = cloud_msg_queue(&msg, CLOUD_IO_PRIO_BACKLOG);
+		cloud_codec_bat_buffer_commit(bat_buf, err == 0);
 		if (err) {
-			LOG_ERR("Cloud send failed, err: %d", err);
 			return;
 		}
 
@@ -802,6 +1397,7 @@ static void config_get(void)
 	k_delayed_work_submit(&sample_data_work, K_NO_WAIT);
 
 	if (cloud_connected) {
+		k_delayed_work_submit(&agps_request_work, K_NO_WAIT);
 		k_delayed_work_submit(&device_config_get_work, K_NO_WAIT);
 		k_delayed_work_submit(&device_config_send_work, K_NO_WAIT);
 		k_delayed_work_submit(&data_send_work, K_NO_WAIT);
@@ -875,6 +1471,49 @@ static void ui_send_work_fn(struct k_work *work)
 	ui_send();
 }
 
+static void agps_request_work_fn(struct k_work *work)
+{
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+	agps_request_send();
+#endif
+}
+
+static void geofence_send_work_fn(struct k_work *work)
+{
+#if defined(CONFIG_GEOFENCE)
+	geofence_send();
+#endif
+}
+
+static void health_send_work_fn(struct k_work *work)
+{
+#if defined(CONFIG_HEAP_MONITOR)
+	health_send();
+
+	k_delayed_work_submit(&health_send_work,
+			      K_SECONDS(CONFIG_HEALTH_REPORT_INTERVAL_SEC));
+#endif
+}
+
+static void metrics_send_work_fn(struct k_work *work)
+{
+#if defined(CONFIG_METRICS)
+	metrics_send();
+
+	k_delayed_work_submit(&metrics_send_work,
+			      K_SECONDS(CONFIG_METRICS_REPORT_INTERVAL_SEC));
+#endif
+}
+
+static void power_day_work_fn(struct k_work *work)
+{
+#if defined(CONFIG_POWER_TIMELINE)
+	power_summary_send(true);
+
+	k_delayed_work_submit(&power_day_work, K_HOURS(24));
+#endif
+}
+
 static void mov_timeout_work_fn(struct k_work *work)
 {
 	if (!cfg.act) {
@@ -882,8 +1521,8 @@ static void mov_timeout_work_fn(struct k_work *work)
 		k_sem_give(&accel_trig_sem);
 	}
 
-	k_delayed_work_submit(&mov_timeout_work,
-			      K_SECONDS(cfg.movt));
+	wakeup_work_submit(&mov_timeout_work, K_SECONDS(cfg.movt),
+			   PERIOD_SLACK(K_SECONDS(cfg.movt)));
 }
 
 static void work_init(void)
@@ -904,6 +1543,27 @@ static void work_init(void)
 			    ui_send_work_fn);
 	k_delayed_work_init(&sample_data_work,
 			    sample_data_work_fn);
+	k_delayed_work_init(&agps_request_work,
+			    agps_request_work_fn);
+	k_delayed_work_init(&geofence_send_work,
+			    geofence_send_work_fn);
+	k_delayed_work_init(&health_send_work,
+			    health_send_work_fn);
+	k_delayed_work_init(&metrics_send_work,
+			    metrics_send_work_fn);
+	k_delayed_work_init(&power_day_work,
+			    power_day_work_fn);
+}
+
+/** Records the time to the first fix of a search. */
+static void gps_ttf_record(void)
+{
+	u32_t start = atomic_set(&gps_search_ts, 0);
+
+	if (start != 0) {
+		metrics_record(METRICS_HIST_GPS_TTF,
+			       (k_uptime_get_32() - start) / MSEC_PER_SEC);
+	}
 }
 
 static void gps_trigger_handler(struct device *dev, struct gps_event *evt)
@@ -914,23 +1574,60 @@ static void gps_trigger_handler(struct device *dev, struct gps_event *evt)
 		break;
 	case GPS_EVT_SEARCH_STOPPED:
 		LOG_INF("GPS_EVT_SEARCH_STOPPED");
+		gps_control_set_active(false);
+#if defined(CONFIG_GPS_FILTER)
+		gps_filter_reset();
+#endif
 		break;
 	case GPS_EVT_SEARCH_TIMEOUT:
 		LOG_INF("GPS_EVT_SEARCH_TIMEOUT");
 		gps_control_set_active(false);
+		atomic_set(&gps_search_ts, 0);
+		metrics_inc(METRICS_GPS_TIMEOUT);
+		flight_recorder_log(FLIGHT_RECORDER_GPS_TIMEOUT, 0, 0, 0);
 		k_sem_give(&gps_timeout_sem);
 		break;
 	case GPS_EVT_PVT:
 		/* Don't spam logs */
 		break;
-	case GPS_EVT_PVT_FIX:
+	case GPS_EVT_PVT_FIX: {
+		struct gps_pvt pvt = evt->pvt;
+
 		LOG_INF("GPS_EVT_PVT_FIX");
-		gps_control_set_active(false);
-		time_set(&evt->pvt);
-		gps_buffer_populate(&evt->pvt);
+		/* A tracking GPS keeps searching after the fix. */
+		if (!gps_control_is_tracking()) {
+			gps_control_set_active(false);
+		}
+		gps_ttf_record();
+		flight_recorder_log(FLIGHT_RECORDER_GPS_FIX, 0, 0, 0);
+		time_set(&pvt);
+#if defined(CONFIG_GPS_FILTER)
+		if (atomic_cas(&gps_filter_stale, true, false)) {
+			gps_filter_reset();
+		}
+
+		if (gps_filter_update(&pvt, k_uptime_get())) {
+			/* A tracking GPS delivers another fix shortly. */
+			if (!gps_control_is_tracking()) {
+				k_sem_give(&gps_timeout_sem);
+			}
+			break;
+		}
+#endif
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+		gps_control_last_fix_store(&pvt);
+#endif
+#if defined(CONFIG_GEOFENCE)
+		if (!geofence_fix_report(&pvt)) {
+			k_sem_give(&gps_timeout_sem);
+			break;
+		}
+#endif
+		gps_buffer_populate(&pvt);
 		gps_fix = true;
 		k_sem_give(&gps_timeout_sem);
 		break;
+	}
 	case GPS_EVT_NMEA:
 		/* Don't spam logs */
 		break;
@@ -946,6 +1643,9 @@ static void gps_trigger_handler(struct device *dev, struct gps_event *evt)
 		break;
 	case GPS_EVT_AGPS_DATA_NEEDED:
 		LOG_INF("GPS_EVT_AGPS_DATA_NEEDED");
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+		agps_request_update(&evt->agps_request);
+#endif
 		break;
 	case GPS_EVT_ERROR:
 		LOG_INF("GPS_EVT_ERROR\n");
@@ -966,8 +1666,14 @@ void cloud_event_handler(const struct cloud_backend *const backend,
 	case CLOUD_EVT_CONNECTED:
 		LOG_INF("CLOUD_EVT_CONNECTED");
 		cloud_connected = true;
+		LOG_INF("Cloud connected %lld ms after boot", k_uptime_get());
+		LOG_INF("Persistent session %s",
+			evt->data.persistent_session ? "resumed" : "not present");
 		config_get();
+		k_delayed_work_submit(&geofence_send_work, K_NO_WAIT);
+#if defined(CONFIG_BOOTLOADER_MCUBOOT)
 		boot_write_img_confirmed();
+#endif
 		break;
 	case CLOUD_EVT_READY:
 		LOG_INF("CLOUD_EVT_READY");
@@ -981,12 +1687,24 @@ void cloud_event_handler(const struct cloud_backend *const backend,
 	case CLOUD_EVT_DISCONNECTED:
 		LOG_INF("CLOUD_EVT_DISCONNECTED");
 		cloud_connected = false;
+		power_timeline_fota_set(false);
+#if defined(CONFIG_HEAP_MONITOR)
+		heap_monitor_default_site_set(HEAP_MONITOR_SITE_OTHER);
+#endif
 		break;
 	case CLOUD_EVT_ERROR:
 		LOG_ERR("CLOUD_EVT_ERROR");
 		break;
 	case CLOUD_EVT_FOTA_START:
 		LOG_INF("CLOUD_EVT_FOTA_START");
+		power_timeline_fota_set(true);
+		flight_recorder_log(FLIGHT_RECORDER_FOTA, 1, 0, 0);
+#if defined(CONFIG_HEAP_MONITOR)
+		/* The download runs on the backend thread, which does not
+		 * enter a site of its own.
+		 */
+		heap_monitor_default_site_set(HEAP_MONITOR_SITE_FOTA);
+#endif
 		break;
 	case CLOUD_EVT_FOTA_ERASE_PENDING:
 		LOG_INF("CLOUD_EVT_FOTA_ERASE_PENDING");
@@ -1001,14 +1719,47 @@ void cloud_event_handler(const struct cloud_backend *const backend,
 		break;
 	case CLOUD_EVT_DATA_SENT:
 		LOG_INF("CLOUD_EVT_DATA_SENT");
+#if defined(CONFIG_CLOUD_IO_QOS1)
+		cloud_io_ack(&evt->data.msg);
+#endif
 		break;
 	case CLOUD_EVT_DATA_RECEIVED:
 		LOG_INF("CLOUD_EVT_DATA_RECEIVED");
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+		if (evt->data.msg.endpoint.str != NULL &&
+		    evt->data.msg.endpoint.len == AGPS_TOPIC_LEN &&
+		    strncmp(evt->data.msg.endpoint.str, agps_topic,
+			    AGPS_TOPIC_LEN) == 0) {
+			err = gps_control_agps_process(
+				(const u8_t *)evt->data.msg.buf,
+				evt->data.msg.len);
+			if (err) {
+				LOG_ERR("A-GPS data not processed, error: %d",
+					err);
+			}
+			break;
+		}
+#endif
+#if defined(CONFIG_CLOUD_CODEC_SEQ)
+		if (evt->data.msg.endpoint.str != NULL &&
+		    evt->data.msg.endpoint.len == ACK_TOPIC_LEN &&
+		    strncmp(evt->data.msg.endpoint.str, ack_topic,
+			    ACK_TOPIC_LEN) == 0) {
+			ack_process(evt->data.msg.buf);
+			break;
+		}
+#endif
 		err = cloud_codec_decode_response(evt->data.msg.buf, &cfg);
 		if (err) {
 			LOG_ERR("Could not decode response %d", err);
 		}
 		ext_sensors_accelerometer_threshold_set(cfg.acct);
+#if defined(CONFIG_GEOFENCE)
+		err = geofence_set(cfg.geo, cfg.geo_cnt);
+		if (err) {
+			LOG_ERR("geofence_set, error: %d", err);
+		}
+#endif
 		k_delayed_work_submit(&device_config_send_work, K_NO_WAIT);
 		break;
 	case CLOUD_EVT_PAIR_REQUEST:
@@ -1023,92 +1774,119 @@ void cloud_event_handler(const struct cloud_backend *const backend,
 	}
 }
 
-void cloud_poll(void)
+/** Hash of the device ID, mixed into the backoff jitter so that devices
+ *  do not retry in lockstep even if their random generators agree.
+ */
+static u32_t backoff_seed_get(void)
 {
-	int err;
-	int cloud_connect_retries = 0;
-	int retry_backoff_s = 0;
+	static u32_t seed;
 
-	k_sem_take(&cloud_conn_sem, K_FOREVER);
+	if (seed == 0) {
+		/* FNV-1a */
+		seed = 2166136261U;
 
-connect:
-
-	if (cloud_connect_retries >= CONFIG_CLOUD_RECONNECT_RETRIES) {
-		LOG_ERR("Too many cloud connect retires, reboot");
-		error_handler(-EIO);
+		for (int i = 0; client_id_buf[i] != '\0'; i++) {
+			seed ^= client_id_buf[i];
+			seed *= 16777619U;
+		}
 	}
 
-	/* Exponential backoff in case of disconnect from
-	 * cloud.
-	 */
-
-	retry_backoff_s = 10 + pow(cloud_connect_retries, 4);
-	cloud_connect_retries++;
-
-	LOG_INF("Trying to connect to cloud in %d seconds", retry_backoff_s);
-
-	/** Sleep in order to make sure time has been pushed to the modem. */
-	k_sleep(K_SECONDS(5));
-
-	date_time_update();
+	return seed;
+}
 
-	k_sleep(K_SECONDS(retry_backoff_s));
+/** Capped exponential backoff with equal jitter, in milliseconds. */
+static s32_t cloud_backoff_ms(int failures)
+{
+	s32_t backoff_s = CONFIG_CLOUD_BACKOFF_BASE_SEC;
+	s32_t half_ms;
 
-	err = cloud_connect(cloud_backend);
-	if (err) {
-		LOG_ERR("cloud_connect failed: %d", err);
-		goto connect;
+	for (int i = 1; i < failures && backoff_s < CONFIG_CLOUD_BACKOFF_MAX_SEC;
+	     i++) {
+		backoff_s *= 2;
 	}
 
-	cloud_connect_retries++;
+	backoff_s = MIN(backoff_s, CONFIG_CLOUD_BACKOFF_MAX_SEC);
+	half_ms = K_SECONDS(backoff_s) / 2;
 
-	struct pollfd fds[] = { { .fd = cloud_backend->config->socket,
-				  .events = POLLIN } };
-
-	while (true) {
-		err = poll(fds, ARRAY_SIZE(fds),
-			   cloud_keepalive_time_left(cloud_backend));
+	return half_ms +
+	       (sys_rand32_get() ^ backoff_seed_get()) % (half_ms + 1);
+}
 
-		if (err < 0) {
-			LOG_ERR("poll, error: %d", err);
-			error_handler(err);
-			continue;
-		}
+void cloud_poll(void)
+{
+	int err;
+	int failures = 0;
+	s32_t backoff_ms;
+	s64_t connect_ms;
+	s64_t connected_ts = 0;
+	enum cloud_conn_state state = CLOUD_CONN_STATE_LINK_WAIT;
 
-		if (err == 0) {
-			cloud_ping(cloud_backend);
-			LOG_INF("Cloud ping!");
-			continue;
-		}
+	while (true) {
+		switch (state) {
+		case CLOUD_CONN_STATE_LINK_WAIT:
+			while (!atomic_get(&lte_registered)) {
+				k_sem_take(&cloud_conn_sem, K_FOREVER);
+			}
 
-		if ((fds[0].revents & POLLIN) == POLLIN) {
-			cloud_input(cloud_backend);
-		}
+			date_time_wait();
+			state = CLOUD_CONN_STATE_CONNECTING;
+			break;
+		case CLOUD_CONN_STATE_CONNECTING:
+			connect_ms = k_uptime_get();
+			err = cloud_connect(cloud_backend);
+			connect_ms = k_uptime_get() - connect_ms;
+			flight_recorder_log(FLIGHT_RECORDER_CONNECT, err, failures,
+					    connect_ms);
+			if (err) {
+				LOG_ERR("cloud_connect failed: %d", err);
+
+				/* The broker may have moved. */
+				if (broker_cache_hit()) {
+					broker_cache_invalidate();
+				}
 
-		if ((fds[0].revents & POLLNVAL) == POLLNVAL) {
-			LOG_ERR("Socket error: POLLNVAL");
-			LOG_ERR("The cloud socket was unexpectedly closed.");
-			error_handler(-EIO);
-			return;
-		}
+				failures++;
+				state = CLOUD_CONN_STATE_BACKOFF;
+				break;
+			}
 
-		if ((fds[0].revents & POLLHUP) == POLLHUP) {
-			LOG_ERR("Socket error: POLLHUP");
-			LOG_ERR("Connection was closed by the cloud.");
-			LOG_ERR("TRYING TO RECONNECT...");
+			LOG_INF("Connected in %lld ms, broker address %s",
+				connect_ms,
+				broker_cache_hit() ? "cached" : "looked up");
+			connected_ts = k_uptime_get();
+			state = CLOUD_CONN_STATE_CONNECTED;
 			break;
-		}
+		case CLOUD_CONN_STATE_CONNECTED:
+			err = cloud_io_run(cloud_backend);
+			LOG_ERR("Cloud connection lost, error: %d", err);
+			flight_recorder_log(FLIGHT_RECORDER_DISCONNECT, err, 0, 0);
+			cloud_disconnect(cloud_backend);
+
+			/* Backoff starts over after a stable connection. */
+			if (k_uptime_get() - connected_ts >=
+			    K_SECONDS(CONFIG_CLOUD_CONNECTION_STABLE_SEC)) {
+				failures = 0;
+			}
 
-		if ((fds[0].revents & POLLERR) == POLLERR) {
-			LOG_ERR("Socket error: POLLERR");
-			LOG_ERR("Cloud connection was unexpectedly closed.");
-			error_handler(-EIO);
-			return;
+			failures++;
+			state = CLOUD_CONN_STATE_BACKOFF;
+			break;
+		case CLOUD_CONN_STATE_BACKOFF:
+			backoff_ms = cloud_backoff_ms(failures);
+			metrics_inc(METRICS_CLOUD_RECONNECT);
+			metrics_record(METRICS_HIST_BACKOFF,
+				       backoff_ms / MSEC_PER_SEC);
+			flight_recorder_log(FLIGHT_RECORDER_BACKOFF, backoff_ms,
+					    failures, 0);
+
+			LOG_INF("Trying to connect to cloud in %d ms, failures: %d",
+				backoff_ms, failures);
+
+			k_sleep(backoff_ms);
+			state = CLOUD_CONN_STATE_LINK_WAIT;
+			break;
 		}
 	}
-
-	cloud_disconnect(cloud_backend);
-	goto connect;
 }
 
 K_THREAD_DEFINE(cloud_poll_thread, CONFIG_CLOUD_POLL_STACKSIZE, cloud_poll,
@@ -1159,6 +1937,10 @@ static void button_handler(u32_t button_states, u32_t has_changed)
 {
 	static int try_again_timeout;
 
+	if (has_changed & button_states) {
+		ui_led_wake();
+	}
+
 	/* Publication of data due to button presses limited
 	 * to 1 push every 2 seconds to avoid spamming the cloud socket.
 	 */
@@ -1172,8 +1954,8 @@ static void button_handler(u32_t button_states, u32_t has_changed)
 
 		if (cloud_connected) {
 			k_delayed_work_submit(&ui_send_work, K_NO_WAIT);
-			k_delayed_work_submit(&leds_set_work,
-					      K_SECONDS(3));
+			wakeup_work_submit(&leds_set_work, K_SECONDS(3),
+					   PERIOD_SLACK(K_SECONDS(3)));
 		}
 
 		try_again_timeout = k_uptime_get();
@@ -1213,6 +1995,16 @@ static int populate_app_endpoint_topics()
 	pub_ep_topics_sub[1].len = MESSAGES_TOPIC_LEN;
 	pub_ep_topics_sub[1].type = CLOUD_EP_TOPIC_MESSAGES;
 
+	err = snprintf(agps_request_topic, sizeof(agps_request_topic),
+		       AGPS_REQUEST_TOPIC, client_id_buf);
+	if (err != AGPS_REQUEST_TOPIC_LEN) {
+		return -ENOMEM;
+	}
+
+	pub_ep_topics_sub[2].str = agps_request_topic;
+	pub_ep_topics_sub[2].len = AGPS_REQUEST_TOPIC_LEN;
+	pub_ep_topics_sub[2].type = CLOUD_EP_TOPIC_AGPS_REQUEST;
+
 	err = snprintf(cfg_topic, sizeof(cfg_topic), CFG_TOPIC, client_id_buf);
 	if (err != CFG_TOPIC_LEN) {
 		return -ENOMEM;
@@ -1222,6 +2014,25 @@ static int populate_app_endpoint_topics()
 	sub_ep_topics_sub[0].len = CFG_TOPIC_LEN;
 	sub_ep_topics_sub[0].type = CLOUD_EP_TOPIC_CONFIG;
 
+	err = snprintf(agps_topic, sizeof(agps_topic), AGPS_TOPIC,
+		       client_id_buf);
+	if (err != AGPS_TOPIC_LEN) {
+		return -ENOMEM;
+	}
+
+	sub_ep_topics_sub[1].str = agps_topic;
+	sub_ep_topics_sub[1].len = AGPS_TOPIC_LEN;
+	sub_ep_topics_sub[1].type = CLOUD_EP_TOPIC_AGPS;
+
+	err = snprintf(ack_topic, sizeof(ack_topic), ACK_TOPIC, client_id_buf);
+	if (err != ACK_TOPIC_LEN) {
+		return -ENOMEM;
+	}
+
+	sub_ep_topics_sub[2].str = ack_topic;
+	sub_ep_topics_sub[2].len = ACK_TOPIC_LEN;
+	sub_ep_topics_sub[2].type = CLOUD_EP_TOPIC_ACK;
+
 	err = cloud_ep_subscriptions_add(cloud_backend, sub_ep_topics_sub,
 					 ARRAY_SIZE(sub_ep_topics_sub));
 	if (err) {
@@ -1273,6 +2084,8 @@ void main(void)
 {
 	int err;
 
+	flight_recorder_log(FLIGHT_RECORDER_BOOT, 0, 0, 0);
+
 	LOG_INF("The cat tracker has started");
 	LOG_INF("Version: %s", log_strdup(CONFIG_CAT_TRACKER_APP_VERSION));
 
@@ -1305,12 +2118,36 @@ void main(void)
 		error_handler(err);
 	}
 
+	/* Without the cache every connection looks the broker up. */
+	err = broker_cache_init();
+	if (err) {
+		LOG_INF("broker_cache_init, error: %d", err);
+	}
+
 	err = cloud_setup();
 	if (err) {
 		LOG_INF("cloud_setup, error %d", err);
 		error_handler(err);
 	}
 
+#if defined(CONFIG_HEAP_MONITOR)
+	if (CONFIG_HEALTH_REPORT_INTERVAL_SEC > 0) {
+		k_delayed_work_submit(&health_send_work,
+			K_SECONDS(CONFIG_HEALTH_REPORT_INTERVAL_SEC));
+	}
+#endif
+
+#if defined(CONFIG_POWER_TIMELINE)
+	k_delayed_work_submit(&power_day_work, K_HOURS(24));
+#endif
+
+#if defined(CONFIG_METRICS)
+	if (CONFIG_METRICS_REPORT_INTERVAL_SEC > 0) {
+		k_delayed_work_submit(&metrics_send_work,
+			K_SECONDS(CONFIG_METRICS_REPORT_INTERVAL_SEC));
+	}
+#endif
+
 	err = ui_init();
 	if (err) {
 		LOG_INF("ui_init, error: %d", err);
@@ -1323,6 +2160,14 @@ void main(void)
 		error_handler(err);
 	}
 
+#if defined(CONFIG_GEOFENCE)
+	err = geofence_init(geofence_evt_handler);
+	if (err) {
+		LOG_INF("geofence_init, error %d", err);
+		error_handler(err);
+	}
+#endif
+
 	err = modem_configure();
 	if (err) {
 		LOG_INF("modem_configure, error: %d", err);
@@ -1333,13 +2178,21 @@ void main(void)
 	 * Makes sure the device publishes every once and a while even
 	 * though the device is in passive mode and movement is not detected.
 	 */
-	k_delayed_work_submit(&mov_timeout_work,
-			      K_SECONDS(cfg.movt));
+	wakeup_work_submit(&mov_timeout_work, K_SECONDS(cfg.movt),
+			   PERIOD_SLACK(K_SECONDS(cfg.movt)));
 
 	while (true) {
 		/*Check current device mode*/
 		if (!cfg.act) {
 			LOG_INF("Device in PASSIVE mode");
+
+			/* Don't keep the GPS tracking while waiting for
+			 * movement.
+			 */
+			if (gps_control_is_tracking()) {
+				gps_control_stop(K_NO_WAIT);
+			}
+
 			k_delayed_work_submit(&leds_set_work,
 					      K_NO_WAIT);
 			if (!k_sem_take(&accel_trig_sem, K_FOREVER)) {
@@ -1351,20 +2204,46 @@ void main(void)
 
 		/** Start GPS search, disable GPS if gpst is set to 0. */
 		if (cfg.gpst > 0) {
-			gps_control_start(K_NO_WAIT, cfg.gpst);
+			u32_t interval = gps_tracking_interval();
+
+			gps_filter_mode_set(cfg.act, interval);
+			atomic_set(&gps_search_ts, k_uptime_get_32());
+			metrics_inc(METRICS_GPS_SEARCH);
+			flight_recorder_log(FLIGHT_RECORDER_GPS_START, cfg.gpst,
+					    interval, 0);
+			gps_control_start(K_NO_WAIT, cfg.gpst, interval);
 
 			/*Wait for GPS search timeout*/
-			k_sem_take(&gps_timeout_sem, K_FOREVER);
+			if (interval > 0) {
+				/* A tracking GPS does not time out, wait at
+				 * most one interval for the next fix. Fixes
+				 * of the previous interval were given while
+				 * the device slept, drop them.
+				 */
+				k_sem_reset(&gps_timeout_sem);
+				k_sem_take(&gps_timeout_sem,
+					   K_SECONDS(interval + cfg.gpst));
+			} else {
+				k_sem_take(&gps_timeout_sem, K_FOREVER);
+			}
+		} else if (gps_control_is_tracking()) {
+			gps_control_stop(K_NO_WAIT);
 		}
 
 		/*Send update to cloud. */
 		data_publish();
 
+#if defined(CONFIG_POWER_TIMELINE)
+		power_summary_send(false);
+#endif
+
 		/* Set device mode led behaviour */
-		k_delayed_work_submit(&leds_set_work, K_SECONDS(15));
+		wakeup_work_submit(&leds_set_work, K_SECONDS(15),
+				   PERIOD_SLACK(K_SECONDS(15)));
 
 		/*Sleep*/
 		LOG_INF("Going to sleep for: %d seconds", device_mode_check());
-		k_sleep(K_SECONDS(device_mode_check()));
+		wakeup_sleep(K_SECONDS(device_mode_check()),
+			     PERIOD_SLACK(K_SECONDS(device_mode_check())));
 	}
 }
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include "metrics.h"
+
+static const char *const counter_names[METRICS_COUNTER_COUNT] = {
+	[METRICS_CLOUD_SEND_FAIL] = "sendFail",
+	[METRICS_CLOUD_RECONNECT] = "reconn",
+	[METRICS_GPS_SEARCH] = "gpsSearch",
+	[METRICS_GPS_TIMEOUT] = "gpsTimeout",
+	[METRICS_OVERWRITE_GPS] = "ovrGps",
+	[METRICS_OVERWRITE_ENV] = "ovrEnv",
+	[METRICS_OVERWRITE_ROAM] = "ovrRoam",
+	[METRICS_OVERWRITE_BTN] = "ovrBtn",
+	[METRICS_OVERWRITE_ACC] = "ovrAcc",
+	[METRICS_OVERWRITE_BAT] = "ovrBat",
+	[METRICS_OVERWRITE_GEO] = "ovrGeo",
+	[METRICS_ACCEL_TRIGGER_DROP] = "accDrop",
+};
+
+static const char *const hist_names[METRICS_HIST_COUNT] = {
+	[METRICS_HIST_ENCODE_DATA] = "encData",
+	[METRICS_HIST_ENCODE_BATCH] = "encBatch",
+	[METRICS_HIST_CLOUD_SEND] = "send",
+	[METRICS_HIST_BACKOFF] = "backoff",
+	[METRICS_HIST_GPS_TTF] = "gpsTtf",
+};
+
+/* Exclusive upper bounds of the buckets but the last. */
+static const u32_t
+	hist_bounds[METRICS_HIST_COUNT][METRICS_HIST_BUCKETS - 1] = {
+	[METRICS_HIST_ENCODE_DATA] = { 1, 2, 5, 10, 20 },
+	[METRICS_HIST_ENCODE_BATCH] = { 1, 2, 5, 10, 20 },
+	[METRICS_HIST_CLOUD_SEND] = { 10, 50, 200, 1000, 5000 },
+	[METRICS_HIST_BACKOFF] = { 30, 120, 600, 1800, 3600 },
+	[METRICS_HIST_GPS_TTF] = { 5, 15, 30, 60, 120 },
+};
+
+static atomic_t counters[METRICS_COUNTER_COUNT];
+static atomic_t hists[METRICS_HIST_COUNT][METRICS_HIST_BUCKETS];
+static s64_t start_ts;
+
+void metrics_inc(enum metrics_counter counter)
+{
+	atomic_inc(&counters[counter]);
+}
+
+void metrics_record(enum metrics_hist hist, u32_t value)
+{
+	int i = 0;
+
+	while (i < METRICS_HIST_BUCKETS - 1 && value >= hist_bounds[hist][i]) {
+		i++;
+	}
+
+	atomic_inc(&hists[hist][i]);
+}
+
+void metrics_snapshot_get(struct metrics_snapshot *snapshot)
+{
+	for (int i = 0; i < METRICS_COUNTER_COUNT; i++) {
+		snapshot->counter[i] = atomic_get(&counters[i]);
+	}
+
+	for (int i = 0; i < METRICS_HIST_COUNT; i++) {
+		for (int j = 0; j < METRICS_HIST_BUCKETS; j++) {
+			snapshot->hist[i][j] = atomic_get(&hists[i][j]);
+		}
+	}
+
+	snapshot->start_ts = start_ts;
+	snapshot->ts = k_uptime_get();
+}
+
+void metrics_consume(const struct metrics_snapshot *snapshot)
+{
+	/* Counts added since the snapshot are kept for the next one. */
+	for (int i = 0; i < METRICS_COUNTER_COUNT; i++) {
+		atomic_sub(&counters[i], snapshot->counter[i]);
+	}
+
+	for (int i = 0; i < METRICS_HIST_COUNT; i++) {
+		for (int j = 0; j < METRICS_HIST_BUCKETS; j++) {
+			atomic_sub(&hists[i][j], snapshot->hist[i][j]);
+		}
+	}
+
+	start_ts = snapshot->ts;
+}
+
+const char *metrics_counter_name(enum metrics_counter counter)
+{
+	return counter_names[counter];
+}
+
+const char *metrics_hist_name(enum metrics_hist hist)
+{
+	return hist_names[hist];
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   Counters and fixed-bucket histograms of field behavior.
+ */
+
+#ifndef METRICS_H__
+#define METRICS_H__
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Counters. */
+enum metrics_counter {
+	/** cloud_send() failures. */
+	METRICS_CLOUD_SEND_FAIL,
+	/** Reconnections after a lost or failed cloud connection. */
+	METRICS_CLOUD_RECONNECT,
+	/** GPS searches started, and those that timed out. */
+	METRICS_GPS_SEARCH,
+	METRICS_GPS_TIMEOUT,
+	/** Queued data buffer entries overwritten before publication. */
+	METRICS_OVERWRITE_GPS,
+	METRICS_OVERWRITE_ENV,
+	METRICS_OVERWRITE_ROAM,
+	METRICS_OVERWRITE_BTN,
+	METRICS_OVERWRITE_ACC,
+	METRICS_OVERWRITE_BAT,
+	METRICS_OVERWRITE_GEO,
+	/** Accelerometer triggers while one was still pending. */
+	METRICS_ACCEL_TRIGGER_DROP,
+
+	METRICS_COUNTER_COUNT
+};
+
+/** @brief Histograms, the unit of the recorded values is given for each. */
+enum metrics_hist {
+	/** Encoding of a data message, in milliseconds. */
+	METRICS_HIST_ENCODE_DATA,
+	/** Encoding of a batch message, in milliseconds. */
+	METRICS_HIST_ENCODE_BATCH,
+	/** cloud_send() duration, in milliseconds. */
+	METRICS_HIST_CLOUD_SEND,
+	/** Reconnection backoff, in seconds. */
+	METRICS_HIST_BACKOFF,
+	/** GPS time to fix, in seconds. */
+	METRICS_HIST_GPS_TTF,
+
+	METRICS_HIST_COUNT
+};
+
+/** Number of buckets of a histogram, the last one takes the overflow. */
+#define METRICS_HIST_BUCKETS 6
+
+/** @brief Counts since the last consumed snapshot. */
+struct metrics_snapshot {
+	u32_t counter[METRICS_COUNTER_COUNT];
+	u32_t hist[METRICS_HIST_COUNT][METRICS_HIST_BUCKETS];
+	/** Uptime when the counting started, in milliseconds. */
+	s64_t start_ts;
+	/** Uptime of the snapshot, in milliseconds. */
+	s64_t ts;
+};
+
+#if defined(CONFIG_METRICS)
+/** @brief Increment a counter. */
+void metrics_inc(enum metrics_counter counter);
+
+/** @brief Record a value in the bucket of a histogram it falls into. */
+void metrics_record(enum metrics_hist hist, u32_t value);
+
+/**
+ * @brief Take a snapshot of the counts.
+ *
+ * Counting goes on, the snapshot is only subtracted from the counts by
+ * metrics_consume().
+ *
+ * @param snapshot Snapshot.
+ */
+void metrics_snapshot_get(struct metrics_snapshot *snapshot);
+
+/**
+ * @brief Subtract a published snapshot from the counts.
+ *
+ * @param snapshot Snapshot taken by metrics_snapshot_get().
+ */
+void metrics_consume(const struct metrics_snapshot *snapshot);
+
+/** @brief Short name of a counter, as published. */
+const char *metrics_counter_name(enum metrics_counter counter);
+
+/** @brief Short name of a histogram, as published. */
+const char *metrics_hist_name(enum metrics_hist hist);
+#else
+static inline void metrics_inc(enum metrics_counter counter)
+{
+	ARG_UNUSED(counter);
+}
+
+static inline void metrics_record(enum metrics_hist hist, u32_t value)
+{
+	ARG_UNUSED(hist);
+	ARG_UNUSED(value);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METRICS_H__ */
@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <string.h>
+#include "power_timeline.h"
+
+#if defined(CONFIG_SHELL)
+#include <shell/shell.h>
+#endif
+
+/* No connection cause known yet. */
+#define CAUSE_NONE POWER_TIMELINE_ACTIVITY_COUNT
+
+enum state {
+	STATE_CONNECTED,
+	STATE_IDLE,
+	STATE_PSM,
+	STATE_GPS_ON,
+	STATE_GPS_OFF,
+};
+
+static const char *const state_names[] = {
+	[STATE_CONNECTED] = "connected",
+	[STATE_IDLE] = "idle",
+	[STATE_PSM] = "psm",
+	[STATE_GPS_ON] = "gps on",
+	[STATE_GPS_OFF] = "gps off",
+};
+
+static const char *const activity_names[POWER_TIMELINE_ACTIVITY_COUNT] = {
+	[POWER_TIMELINE_PUBLISH] = "pub",
+	[POWER_TIMELINE_PING] = "ping",
+	[POWER_TIMELINE_FOTA] = "fota",
+	[POWER_TIMELINE_CONFIG] = "cfg",
+	[POWER_TIMELINE_OTHER] = "other",
+};
+
+static struct transition {
+	u32_t ts;
+	enum state state;
+} timeline[CONFIG_POWER_TIMELINE_LEN];
+static int timeline_head;
+static int timeline_cnt;
+
+static struct k_spinlock lock;
+static bool rrc_connected;
+static bool gps_active;
+static bool fota_active;
+static int psm_active_time = -1;
+static s64_t idle_since;
+static s64_t accounted_ts;
+static enum power_timeline_activity conn_cause = CAUSE_NONE;
+static enum power_timeline_activity pending = CAUSE_NONE;
+static s64_t pending_ts;
+static struct power_timeline_summary cycle;
+static struct power_timeline_summary day;
+static struct power_timeline_summary total;
+
+static void timeline_add(s64_t ts, enum state state)
+{
+	timeline[timeline_head].ts = (u32_t)ts;
+	timeline[timeline_head].state = state;
+	timeline_head = (timeline_head + 1) % ARRAY_SIZE(timeline);
+	timeline_cnt = MIN(timeline_cnt + 1, ARRAY_SIZE(timeline));
+}
+
+static void summary_add(struct power_timeline_summary *sum,
+			const struct power_timeline_summary *delta)
+{
+	sum->connected += delta->connected;
+	sum->idle += delta->idle;
+	sum->psm += delta->psm;
+	sum->gps += delta->gps;
+	sum->connections += delta->connections;
+
+	for (int i = 0; i < POWER_TIMELINE_ACTIVITY_COUNT; i++) {
+		sum->activity[i] += delta->activity[i];
+	}
+}
+
+/* Every count and duration goes into all summaries alike. */
+static void summaries_add(const struct power_timeline_summary *delta)
+{
+	summary_add(&cycle, delta);
+	summary_add(&day, delta);
+	summary_add(&total, delta);
+}
+
+/* Adds the time since the last call to the state the modem was in. */
+static void account(s64_t now)
+{
+	struct power_timeline_summary delta = { 0 };
+	u32_t elapsed = now - accounted_ts;
+
+	if (now <= accounted_ts) {
+		return;
+	}
+
+	if (rrc_connected) {
+		delta.connected = elapsed;
+		delta.activity[conn_cause == CAUSE_NONE ?
+			       POWER_TIMELINE_OTHER : conn_cause] = elapsed;
+	} else if (psm_active_time < 0) {
+		delta.idle = elapsed;
+	} else {
+		s64_t psm_ts = idle_since + K_SECONDS(psm_active_time);
+
+		if (now > psm_ts) {
+			delta.psm = now - MAX(accounted_ts, psm_ts);
+
+			if (accounted_ts < psm_ts) {
+				timeline_add(psm_ts, STATE_PSM);
+			}
+		}
+
+		delta.idle = elapsed - delta.psm;
+	}
+
+	if (gps_active) {
+		delta.gps = elapsed;
+	}
+
+	summaries_add(&delta);
+	accounted_ts = now;
+}
+
+void power_timeline_rrc_update(bool connected)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	s64_t now = k_uptime_get();
+
+	account(now);
+
+	if (connected == rrc_connected) {
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	rrc_connected = connected;
+
+	if (connected) {
+		struct power_timeline_summary delta = { .connections = 1 };
+
+		summaries_add(&delta);
+
+		if (fota_active) {
+			conn_cause = POWER_TIMELINE_FOTA;
+		} else if (pending != CAUSE_NONE &&
+			   now - pending_ts <=
+				   CONFIG_POWER_TIMELINE_CAUSE_WINDOW_MS) {
+			conn_cause = pending;
+		}
+	} else {
+		idle_since = now;
+		conn_cause = CAUSE_NONE;
+	}
+
+	pending = CAUSE_NONE;
+	timeline_add(now, connected ? STATE_CONNECTED : STATE_IDLE);
+
+	k_spin_unlock(&lock, key);
+}
+
+void power_timeline_psm_update(int active_time)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	account(k_uptime_get());
+	psm_active_time = active_time;
+
+	k_spin_unlock(&lock, key);
+}
+
+void power_timeline_gps_update(bool active)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	s64_t now = k_uptime_get();
+
+	account(now);
+
+	if (active != gps_active) {
+		gps_active = active;
+		timeline_add(now, active ? STATE_GPS_ON : STATE_GPS_OFF);
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void power_timeline_activity_mark(enum power_timeline_activity activity)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	/* The connected time not yet accounted goes to the cause found
+	 * here, which is why it is not accounted first.
+	 */
+	if (rrc_connected) {
+		if (conn_cause == CAUSE_NONE) {
+			conn_cause = activity;
+		}
+	} else {
+		pending = activity;
+		pending_ts = k_uptime_get();
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+void power_timeline_fota_set(bool active)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	account(k_uptime_get());
+	fota_active = active;
+
+	if (active && rrc_connected) {
+		conn_cause = POWER_TIMELINE_FOTA;
+	}
+
+	k_spin_unlock(&lock, key);
+}
+
+static void summary_end(struct power_timeline_summary *sum,
+			struct power_timeline_summary *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	s64_t now = k_uptime_get();
+
+	account(now);
+
+	*out = *sum;
+	out->period = now - sum->start_ts;
+
+	memset(sum, 0, sizeof(*sum));
+	sum->start_ts = now;
+
+	k_spin_unlock(&lock, key);
+}
+
+void power_timeline_cycle_end(struct power_timeline_summary *summary)
+{
+	summary_end(&cycle, summary);
+}
+
+void power_timeline_day_end(struct power_timeline_summary *summary)
+{
+	summary_end(&day, summary);
+}
+
+void power_timeline_total_get(struct power_timeline_summary *summary)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	s64_t now = k_uptime_get();
+
+	account(now);
+
+	*summary = total;
+	summary->period = now;
+
+	k_spin_unlock(&lock, key);
+}
+
+const char *power_timeline_activity_name(enum power_timeline_activity act)
+{
+	return activity_names[act];
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_power(const struct shell *shell, size_t argc, char **argv)
+{
+	struct power_timeline_summary sum;
+	struct transition copy[ARRAY_SIZE(timeline)];
+	k_spinlock_key_t key;
+	int first, cnt;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	key = k_spin_lock(&lock);
+	account(k_uptime_get());
+	sum = day;
+	sum.period = k_uptime_get() - day.start_ts;
+	memcpy(copy, timeline, sizeof(copy));
+	first = (timeline_head - timeline_cnt + ARRAY_SIZE(timeline)) %
+		ARRAY_SIZE(timeline);
+	cnt = timeline_cnt;
+	k_spin_unlock(&lock, key);
+
+	for (int i = 0; i < cnt; i++) {
+		struct transition *t = &copy[(first + i) % ARRAY_SIZE(copy)];
+
+		shell_print(shell, "%10u ms  %s", t->ts, state_names[t->state]);
+	}
+
+	shell_print(shell, "Today, of %u ms: connected %u (%u connections), "
+		    "idle %u, psm %u, gps %u", sum.period, sum.connected,
+		    sum.connections, sum.idle, sum.psm, sum.gps);
+
+	for (int i = 0; i < POWER_TIMELINE_ACTIVITY_COUNT; i++) {
+		shell_print(shell, "  %-6s %u ms", activity_names[i],
+			    sum.activity[i]);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(power, NULL, "Print the modem power timeline", cmd_power);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   Timeline of modem power states, with the radio connected time
+ *	    attributed to the activity that caused it.
+ */
+
+#ifndef POWER_TIMELINE_H__
+#define POWER_TIMELINE_H__
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Activities that connected time is attributed to. */
+enum power_timeline_activity {
+	POWER_TIMELINE_PUBLISH,
+	POWER_TIMELINE_PING,
+	POWER_TIMELINE_FOTA,
+	POWER_TIMELINE_CONFIG,
+	/** Connections nothing in the firmware asked for, such as paging
+	 *  and tracking area updates.
+	 */
+	POWER_TIMELINE_OTHER,
+
+	POWER_TIMELINE_ACTIVITY_COUNT
+};
+
+/** @brief Time spent in each state over a period, in milliseconds. */
+struct power_timeline_summary {
+	/** Uptime at the start of the period. */
+	s64_t start_ts;
+	/** Length of the period. */
+	u32_t period;
+	/** RRC connected. */
+	u32_t connected;
+	/** RRC idle, out of PSM. */
+	u32_t idle;
+	/** PSM, estimated from the active time granted by the network. */
+	u32_t psm;
+	/** GPS active, regardless of the LTE state. */
+	u32_t gps;
+	/** Number of RRC connections. */
+	u32_t connections;
+	/** Connected time per activity. */
+	u32_t activity[POWER_TIMELINE_ACTIVITY_COUNT];
+};
+
+#if defined(CONFIG_POWER_TIMELINE)
+/** @brief Track an RRC mode update. */
+void power_timeline_rrc_update(bool connected);
+
+/**
+ * @brief Track the PSM active time granted by the network.
+ *
+ * @param active_time Active time in seconds, -1 if PSM is not granted.
+ */
+void power_timeline_psm_update(int active_time);
+
+/** @brief Track the GPS turning on or off. */
+void power_timeline_gps_update(bool active);
+
+/**
+ * @brief Mark an activity that needs the radio. A connection is caused by
+ *	  the activity marked shortly before it, or else by the first one
+ *	  marked while connected.
+ */
+void power_timeline_activity_mark(enum power_timeline_activity activity);
+
+/** @brief Attribute all connected time to FOTA while a download runs. */
+void power_timeline_fota_set(bool active);
+
+/** @brief Get the summary of the current cycle and start a new one. */
+void power_timeline_cycle_end(struct power_timeline_summary *summary);
+
+/** @brief Get the summary of the current day and start a new one. */
+void power_timeline_day_end(struct power_timeline_summary *summary);
+
+/** @brief Get the summary of the time since boot. */
+void power_timeline_total_get(struct power_timeline_summary *summary);
+
+/** @brief Short name of an activity, as published. */
+const char *power_timeline_activity_name(enum power_timeline_activity act);
+#else
+static inline void power_timeline_rrc_update(bool connected)
+{
+	ARG_UNUSED(connected);
+}
+
+static inline void power_timeline_psm_update(int active_time)
+{
+	ARG_UNUSED(active_time);
+}
+
+static inline void power_timeline_gps_update(bool active)
+{
+	ARG_UNUSED(active);
+}
+
+static inline void
+power_timeline_activity_mark(enum power_timeline_activity activity)
+{
+	ARG_UNUSED(activity);
+}
+
+static inline void power_timeline_fota_set(bool active)
+{
+	ARG_UNUSED(active);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POWER_TIMELINE_H__ */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Stand-in for the modem library header on native_posix. Only the A-GPS
+ * element types are provided, in the layout of the modem library, so that
+ * the GPS controller decodes and injects assistance data as on the device.
+ */
+
+#ifndef NRF_SOCKET_H__
+#define NRF_SOCKET_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+	int32_t a1;
+	int32_t a0;
+	uint8_t tot;
+	uint8_t wn_t;
+	int8_t delta_tls;
+	uint8_t wn_lsf;
+	int8_t dn;
+	int8_t delta_tlsf;
+} nrf_gnss_agps_data_utc_t;
+
+typedef struct {
+	uint8_t sv_id;
+	uint8_t health;
+	uint16_t iodc;
+	uint16_t toc;
+	int8_t af2;
+	int16_t af1;
+	int32_t af0;
+	int8_t tgd;
+	uint8_t ura;
+	uint8_t fit_int;
+	uint16_t toe;
+	int32_t w;
+	int16_t delta_n;
+	int32_t m0;
+	int32_t omega_dot;
+	uint32_t e;
+	int16_t idot;
+	uint32_t sqrt_a;
+	int32_t i0;
+	int32_t omega0;
+	int16_t crs;
+	int16_t cis;
+	int16_t cus;
+	int16_t crc;
+	int16_t cic;
+	int16_t cuc;
+} nrf_gnss_agps_data_ephemeris_t;
+
+typedef struct {
+	uint8_t sv_id;
+	uint8_t wn;
+	uint8_t toa;
+	uint8_t ioda;
+	uint16_t e;
+	int16_t delta_i;
+	int16_t omega_dot;
+	uint8_t sv_health;
+	uint32_t sqrt_a;
+	int32_t omega0;
+	int32_t w;
+	int32_t m0;
+	int16_t af0;
+	int16_t af1;
+} nrf_gnss_agps_data_almanac_t;
+
+typedef struct {
+	int8_t alpha0;
+	int8_t alpha1;
+	int8_t alpha2;
+	int8_t alpha3;
+	int8_t beta0;
+	int8_t beta1;
+	int8_t beta2;
+	int8_t beta3;
+} nrf_gnss_agps_data_klobuchar_t;
+
+typedef struct {
+	int16_t ai0;
+	int16_t ai1;
+	int16_t ai2;
+	uint8_t storm_cond;
+	uint8_t storm_valid;
+} nrf_gnss_agps_data_nequick_t;
+
+typedef struct {
+	uint16_t tlm;
+	uint8_t flags;
+} nrf_gnss_agps_data_tow_element_t;
+
+typedef struct {
+	uint16_t date_day;
+	uint32_t time_full_s;
+	uint16_t time_frac_ms;
+	uint32_t sv_mask;
+	nrf_gnss_agps_data_tow_element_t sv_tow[32];
+} nrf_gnss_agps_data_system_time_and_sv_tow_t;
+
+typedef struct {
+	int32_t latitude;
+	int32_t longitude;
+	int16_t altitude;
+	uint8_t unc_semimajor;
+	uint8_t unc_semiminor;
+	uint8_t orientation_major;
+	uint8_t unc_altitude;
+	uint8_t confidence;
+} nrf_gnss_agps_data_location_t;
+
+typedef struct {
+	uint32_t integrity_mask;
+} nrf_gnss_agps_data_integrity_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NRF_SOCKET_H__ */
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Offline cloud backend for duty cycle runs. Messages are counted and
+ * dropped, acknowledged at once, and a configuration request is answered
+ * with CONFIG_SIMULATION_CLOUD_CFG. The traffic drives the RRC mode of the
+ * simulated modem, and the totals are printed as a "SIM:REPORT" line every
+ * CONFIG_SIMULATION_REPORT_INTERVAL_SEC, for scripts/duty_cycle_sim.py.
+ *
+ * Responses are signalled on a socket pair, so that the cloud_io watcher
+ * polls the backend as it polls a broker connection.
+ */
+
+#include <zephyr.h>
+#include <net/socket.h>
+#include <net/cloud_backend.h>
+
+#include "power_timeline.h"
+#include "sim_modem.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(sim_cloud, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+struct sim_cloud_stats {
+	u32_t connects;
+	u32_t tx_msgs;
+	u32_t tx_bytes;
+	u32_t rx_msgs;
+	u32_t rx_bytes;
+	u32_t pings;
+};
+
+static const struct cloud_backend *sim_backend;
+static cloud_evt_handler_t evt_handler;
+static int fds[2] = { -1, -1 };
+static struct cloud_endpoint cfg_ep = { .type = CLOUD_EP_TOPIC_CONFIG };
+/* QoS 1 messages to acknowledge, reported in CLOUD_EVT_DATA_SENT. */
+K_MSGQ_DEFINE(ack_msgq, sizeof(struct cloud_msg), 8, 4);
+static atomic_t cfg_pending;
+/** Uptime of the last transmission, drives the keepalive. */
+static s64_t tx_ts;
+static struct sim_cloud_stats stats;
+static struct k_delayed_work report_work;
+
+/* Handed over as a string, in the form of a shadow delta. */
+static char cfg_buf[] =
+	"{\"state\":{\"cfg\":" CONFIG_SIMULATION_CLOUD_CFG "}}";
+
+static void event_notify(struct cloud_event *evt)
+{
+	if (evt_handler != NULL) {
+		evt_handler(sim_backend, evt, NULL);
+	}
+}
+
+static void response_signal(void)
+{
+	char c = 0;
+
+	if (send(fds[1], &c, sizeof(c), MSG_DONTWAIT) < 0 &&
+	    errno != EAGAIN) {
+		LOG_ERR("Response not signalled, error: %d", errno);
+	}
+}
+
+static void traffic(void)
+{
+	tx_ts = k_uptime_get();
+	sim_modem_traffic();
+}
+
+static void report_work_fn(struct k_work *work)
+{
+	u32_t uptime = k_uptime_get() / MSEC_PER_SEC;
+	struct power_timeline_summary sum;
+
+	power_timeline_total_get(&sum);
+
+	printk("SIM:REPORT {\"uptime\":%u,\"connected\":%u,\"idle\":%u,"
+	       "\"psm\":%u,\"gps\":%u,\"connections\":%u,\"connects\":%u,"
+	       "\"txMsgs\":%u,\"txBytes\":%u,\"rxMsgs\":%u,\"rxBytes\":%u,"
+	       "\"pings\":%u}\n",
+	       uptime, sum.connected / MSEC_PER_SEC, sum.idle / MSEC_PER_SEC,
+	       sum.psm / MSEC_PER_SEC, sum.gps / MSEC_PER_SEC,
+	       sum.connections, stats.connects, stats.tx_msgs,
+	       stats.tx_bytes, stats.rx_msgs, stats.rx_bytes, stats.pings);
+
+	k_delayed_work_submit(&report_work,
+			      K_SECONDS(CONFIG_SIMULATION_REPORT_INTERVAL_SEC));
+}
+
+static int sim_cloud_init(const struct cloud_backend *const backend,
+			  cloud_evt_handler_t handler)
+{
+	sim_backend = backend;
+	evt_handler = handler;
+
+	k_delayed_work_init(&report_work, report_work_fn);
+	k_delayed_work_submit(&report_work,
+			      K_SECONDS(CONFIG_SIMULATION_REPORT_INTERVAL_SEC));
+
+	return 0;
+}
+
+static int sim_cloud_disconnect(const struct cloud_backend *const backend)
+{
+	struct cloud_event evt = { .type = CLOUD_EVT_DISCONNECTED };
+
+	if (fds[0] < 0) {
+		return -ENOTCONN;
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+	fds[0] = fds[1] = -1;
+	k_msgq_purge(&ack_msgq);
+	atomic_set(&cfg_pending, false);
+
+	event_notify(&evt);
+
+	return 0;
+}
+
+static int sim_cloud_uninit(const struct cloud_backend *const backend)
+{
+	sim_cloud_disconnect(backend);
+	k_delayed_work_cancel(&report_work);
+	evt_handler = NULL;
+
+	return 0;
+}
+
+static int sim_cloud_connect(const struct cloud_backend *const backend)
+{
+	int err;
+	struct cloud_event evt = { .type = CLOUD_EVT_CONNECTED };
+
+	if (fds[0] >= 0) {
+		return -EALREADY;
+	}
+
+	err = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+	if (err) {
+		LOG_ERR("socketpair, error: %d", errno);
+		return -errno;
+	}
+
+	backend->config->socket = fds[0];
+	stats.connects++;
+	traffic();
+
+	evt.data.persistent_session = false;
+	event_notify(&evt);
+
+	evt.type = CLOUD_EVT_READY;
+	event_notify(&evt);
+
+	return 0;
+}
+
+static int sim_cloud_send(const struct cloud_backend *const backend,
+			  const struct cloud_msg *const msg)
+{
+	if (fds[0] < 0) {
+		return -ENOTCONN;
+	}
+
+	if (msg->qos == CLOUD_QOS_AT_LEAST_ONCE &&
+	    k_msgq_put(&ack_msgq, msg, K_NO_WAIT)) {
+		return -ENOBUFS;
+	}
+
+	traffic();
+	stats.tx_msgs++;
+	stats.tx_bytes += msg->len;
+
+	if (msg->endpoint.type == CLOUD_EP_TOPIC_STATE && msg->len == 0) {
+		atomic_set(&cfg_pending, true);
+		response_signal();
+	} else if (msg->qos == CLOUD_QOS_AT_LEAST_ONCE) {
+		response_signal();
+	}
+
+	return 0;
+}
+
+static int sim_cloud_input(const struct cloud_backend *const backend)
+{
+	char c;
+	struct cloud_event evt = { .type = CLOUD_EVT_DATA_SENT };
+
+	if (fds[0] < 0) {
+		return -ENOTCONN;
+	}
+
+	/* One pass answers all the signals drained here. */
+	while (recv(fds[0], &c, sizeof(c), MSG_DONTWAIT) > 0) {
+	}
+
+	while (k_msgq_get(&ack_msgq, &evt.data.msg, K_NO_WAIT) == 0) {
+		event_notify(&evt);
+	}
+
+	if (atomic_cas(&cfg_pending, true, false)) {
+		stats.rx_msgs++;
+		stats.rx_bytes += sizeof(cfg_buf) - 1;
+
+		evt.type = CLOUD_EVT_DATA_RECEIVED;
+		evt.data.msg.buf = cfg_buf;
+		evt.data.msg.len = sizeof(cfg_buf) - 1;
+		evt.data.msg.endpoint = cfg_ep;
+		event_notify(&evt);
+	}
+
+	return 0;
+}
+
+static int sim_cloud_ping(const struct cloud_backend *const backend)
+{
+	if (fds[0] < 0) {
+		return -ENOTCONN;
+	}
+
+	traffic();
+	stats.pings++;
+
+	return 0;
+}
+
+static int sim_cloud_keepalive_time_left(
+	const struct cloud_backend *const backend)
+{
+	s64_t left = tx_ts + K_SECONDS(CONFIG_SIMULATION_CLOUD_KEEPALIVE_SEC) -
+		     k_uptime_get();
+
+	return MAX(left, 0);
+}
+
+static int sim_cloud_ep_subscriptions_add(
+	const struct cloud_backend *const backend,
+	const struct cloud_endpoint *const list, size_t list_count)
+{
+	for (int i = 0; i < list_count; i++) {
+		if (list[i].type == CLOUD_EP_TOPIC_CONFIG) {
+			cfg_ep = list[i];
+		}
+	}
+
+	return 0;
+}
+
+static int sim_cloud_ep_subscriptions_remove(
+	const struct cloud_backend *const backend,
+	const struct cloud_endpoint *const list, size_t list_count)
+{
+	return 0;
+}
+
+static const struct cloud_api sim_cloud_api = {
+	.init = sim_cloud_init,
+	.uninit = sim_cloud_uninit,
+	.connect = sim_cloud_connect,
+	.disconnect = sim_cloud_disconnect,
+	.send = sim_cloud_send,
+	.ping = sim_cloud_ping,
+	.keepalive_time_left = sim_cloud_keepalive_time_left,
+	.input = sim_cloud_input,
+	.ep_subscriptions_add = sim_cloud_ep_subscriptions_add,
+	.ep_subscriptions_remove = sim_cloud_ep_subscriptions_remove,
+};
+
+CLOUD_BACKEND_DEFINE(SIM_CLOUD, sim_cloud_api);
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Stand-in for the buttons and LEDs of the DK library. LED changes are
+ * logged and buttons are pressed with the "sim button" shell command.
+ */
+
+#include <zephyr.h>
+#include <stdlib.h>
+#include <dk_buttons_and_leds.h>
+
+#if defined(CONFIG_SHELL)
+#include <shell/shell.h>
+#endif
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(sim_dk, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+static button_handler_t button_handler;
+static u32_t led_state;
+
+int dk_buttons_init(button_handler_t handler)
+{
+	button_handler = handler;
+
+	return 0;
+}
+
+int dk_leds_init(void)
+{
+	return 0;
+}
+
+int dk_set_leds_state(u32_t leds_on_mask, u32_t leds_off_mask)
+{
+	u32_t state = (led_state & ~leds_off_mask) | leds_on_mask;
+
+	if (state != led_state) {
+		led_state = state;
+		LOG_INF("LEDs: %c%c%c%c", state & DK_LED1_MSK ? '1' : '-',
+			state & DK_LED2_MSK ? '2' : '-',
+			state & DK_LED3_MSK ? '3' : '-',
+			state & DK_LED4_MSK ? '4' : '-');
+	}
+
+	return 0;
+}
+
+int dk_set_leds(u32_t leds)
+{
+	return dk_set_leds_state(leds, DK_ALL_LEDS_MSK);
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_button(const struct shell *shell, size_t argc, char **argv)
+{
+	int button = atoi(argv[1]);
+	u32_t mask;
+
+	if (button < 1 || button > 4) {
+		shell_error(shell, "Buttons are 1 to 4");
+		return -EINVAL;
+	}
+
+	if (button_handler == NULL) {
+		shell_error(shell, "Buttons not initialized");
+		return -ENODEV;
+	}
+
+	/* A press and a release. */
+	mask = BIT(button - 1);
+	button_handler(mask, mask);
+	button_handler(0, mask);
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_sim,
+	SHELL_CMD_ARG(button, NULL, "Press a button, 1 to 4", cmd_button, 2,
+		      0),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(sim, &sub_sim, "Simulation stand-ins", NULL);
+#endif /* CONFIG_SHELL */
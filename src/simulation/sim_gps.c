@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <stdlib.h>
+#include <string.h>
+#include <drivers/gps.h>
+#include "sim_trace.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(sim_gps, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+#define KNOTS_TO_MPS 0.514444f
+/* User equivalent range error, turns the HDOP into an accuracy. */
+#define UERE_M 5.0f
+#define NMEA_FIELDS_MAX 20
+
+static const char trace_buf[] = {
+#include "sim_gps_trace.inc"
+};
+
+static struct sim_trace trace = SIM_TRACE_INIT(trace_buf);
+
+static struct {
+	struct device *dev;
+	gps_event_handler_t handler;
+	struct gps_config cfg;
+	struct k_delayed_work fix_work;
+	struct k_delayed_work timeout_work;
+	float altitude;
+	float hdop;
+	/* Assistance data was injected, the GPS asks for none. */
+	bool assisted;
+} gps;
+
+static int nmea_split(char *line, char **field, int max)
+{
+	int cnt = 0;
+	char *checksum = strchr(line, '*');
+
+	if (checksum != NULL) {
+		*checksum = '\0';
+	}
+
+	field[cnt++] = line;
+
+	for (; *line != '\0' && cnt < max; line++) {
+		if (*line == ',') {
+			*line = '\0';
+			field[cnt++] = line + 1;
+		}
+	}
+
+	return cnt;
+}
+
+/* NMEA coordinates are degrees and minutes, dddmm.mmmm. */
+static double nmea_coord_get(const char *value, const char *hemisphere)
+{
+	double raw = strtod(value, NULL);
+	int deg = raw / 100;
+	double coord = deg + (raw - deg * 100) / 60;
+
+	return (*hemisphere == 'S' || *hemisphere == 'W') ? -coord : coord;
+}
+
+static void nmea_datetime_get(const char *time, const char *date,
+			      struct gps_datetime *datetime)
+{
+	int hhmmss = atoi(time);
+	int ddmmyy = atoi(date);
+	const char *fraction = strchr(time, '.');
+
+	datetime->hour = hhmmss / 10000;
+	datetime->minute = hhmmss / 100 % 100;
+	datetime->seconds = hhmmss % 100;
+	datetime->ms = fraction ? strtod(fraction, NULL) * 1000 : 0;
+	datetime->day = ddmmyy / 10000;
+	datetime->month = ddmmyy / 100 % 100;
+	datetime->year = 2000 + ddmmyy % 100;
+}
+
+/* Reads the trace up to the next RMC sentence.
+ *
+ * Returns 1 with the fix in pvt, 0 if the sentence has no fix, and -ENODATA
+ * if the trace has no RMC sentence.
+ */
+static int epoch_next(struct gps_pvt *pvt)
+{
+	char line[GPS_NMEA_SENTENCE_MAX_LENGTH];
+	char *field[NMEA_FIELDS_MAX];
+	int cnt;
+
+	for (size_t i = 0; i < trace.len; i++) {
+		if (!sim_trace_line(&trace, line, sizeof(line))) {
+			break;
+		}
+
+		cnt = nmea_split(line, field, ARRAY_SIZE(field));
+		if (strlen(field[0]) != 6) {
+			continue;
+		}
+
+		if (strcmp(&field[0][3], "GGA") == 0 && cnt > 9) {
+			gps.hdop = strtod(field[8], NULL);
+			gps.altitude = strtod(field[9], NULL);
+			continue;
+		}
+
+		if (strcmp(&field[0][3], "RMC") != 0 || cnt < 10) {
+			continue;
+		}
+
+		if (field[2][0] != 'A') {
+			return 0;
+		}
+
+		memset(pvt, 0, sizeof(*pvt));
+		pvt->latitude = nmea_coord_get(field[3], field[4]);
+		pvt->longitude = nmea_coord_get(field[5], field[6]);
+		pvt->speed = strtod(field[7], NULL) * KNOTS_TO_MPS;
+		pvt->heading = strtod(field[8], NULL);
+		pvt->altitude = gps.altitude;
+		pvt->hdop = gps.hdop;
+		pvt->accuracy = gps.hdop * UERE_M;
+		nmea_datetime_get(field[1], field[9], &pvt->datetime);
+
+		return 1;
+	}
+
+	return -ENODATA;
+}
+
+static void event_send(enum gps_event_type type)
+{
+	struct gps_event evt = { .type = type };
+
+	gps.handler(gps.dev, &evt);
+}
+
+/* Arms the next search of a periodic configuration. */
+static void periodic_next(void)
+{
+	k_delayed_work_submit(&gps.fix_work, K_SECONDS(gps.cfg.interval));
+
+	if (gps.cfg.timeout > 0) {
+		k_delayed_work_submit(&gps.timeout_work,
+				      K_SECONDS(gps.cfg.interval +
+						gps.cfg.timeout));
+	}
+}
+
+static void fix_work_fn(struct k_work *work)
+{
+	struct gps_event evt = { .type = GPS_EVT_PVT_FIX };
+	int ret;
+
+	ret = epoch_next(&evt.pvt);
+	if (ret < 0) {
+		LOG_ERR("No RMC sentence in the GPS trace");
+		return;
+	}
+
+	/* Every second without a fix takes the next epoch of the trace. */
+	if (ret == 0) {
+		k_delayed_work_submit(&gps.fix_work, K_SECONDS(1));
+		return;
+	}
+
+	k_delayed_work_cancel(&gps.timeout_work);
+	gps.handler(gps.dev, &evt);
+
+	if (gps.cfg.nav_mode == GPS_NAV_MODE_PERIODIC) {
+		periodic_next();
+	}
+}
+
+static void timeout_work_fn(struct k_work *work)
+{
+	k_delayed_work_cancel(&gps.fix_work);
+	event_send(GPS_EVT_SEARCH_TIMEOUT);
+
+	if (gps.cfg.nav_mode == GPS_NAV_MODE_PERIODIC) {
+		periodic_next();
+	}
+}
+
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+static void agps_request(void)
+{
+	struct gps_event evt = {
+		.type = GPS_EVT_AGPS_DATA_NEEDED,
+		.agps_request = {
+			.sv_mask_ephe = UINT32_MAX,
+			.sv_mask_alm = UINT32_MAX,
+			.utc = 1,
+			.klobuchar = 1,
+			.system_time_tow = 1,
+			.position = 1,
+			.integrity = 1,
+		},
+	};
+
+	gps.handler(gps.dev, &evt);
+}
+
+static int sim_gps_agps_write(struct device *dev, enum gps_agps_type type,
+			      void *data, size_t data_len)
+{
+	s32_t ttf = K_SECONDS(CONFIG_SIMULATION_GPS_AGPS_TTF_SEC);
+
+	LOG_DBG("A-GPS type %d, %d bytes injected", type, (int)data_len);
+
+	gps.assisted = true;
+
+	/* Shortens the search in progress. */
+	if (k_delayed_work_remaining_get(&gps.fix_work) > ttf) {
+		k_delayed_work_submit(&gps.fix_work, ttf);
+	}
+
+	return 0;
+}
+#endif
+
+static int sim_gps_start(struct device *dev, struct gps_config *cfg)
+{
+	gps.cfg = *cfg;
+
+	k_delayed_work_submit(&gps.fix_work,
+			      K_SECONDS(CONFIG_SIMULATION_GPS_TTF_SEC));
+
+	if (cfg->timeout > 0) {
+		k_delayed_work_submit(&gps.timeout_work,
+				      K_SECONDS(cfg->timeout));
+	} else {
+		k_delayed_work_cancel(&gps.timeout_work);
+	}
+
+	event_send(GPS_EVT_SEARCH_STARTED);
+
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+	if (!gps.assisted) {
+		agps_request();
+	}
+#endif
+
+	return 0;
+}
+
+static int sim_gps_stop(struct device *dev)
+{
+	k_delayed_work_cancel(&gps.fix_work);
+	k_delayed_work_cancel(&gps.timeout_work);
+	event_send(GPS_EVT_SEARCH_STOPPED);
+
+	return 0;
+}
+
+static int sim_gps_init(struct device *dev, gps_event_handler_t handler)
+{
+	if (handler == NULL) {
+		return -EINVAL;
+	}
+
+	gps.dev = dev;
+	gps.handler = handler;
+	k_delayed_work_init(&gps.fix_work, fix_work_fn);
+	k_delayed_work_init(&gps.timeout_work, timeout_work_fn);
+
+	return 0;
+}
+
+static const struct gps_driver_api sim_gps_api = {
+	.start = sim_gps_start,
+	.stop = sim_gps_stop,
+	.init = sim_gps_init,
+#if defined(CONFIG_GPS_CONTROL_AGPS)
+	.agps_write = sim_gps_agps_write,
+#endif
+};
+
+static int sim_gps_setup(struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	return 0;
+}
+
+DEVICE_AND_API_INIT(sim_gps, CONFIG_GPS_DEV_NAME, sim_gps_setup, NULL, NULL,
+		    POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEVICE,
+		    &sim_gps_api);
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Stand-ins for the LTE link control and modem information libraries. The
+ * network is always found, PSM is granted as configured and the modem
+ * parameters are constant. Registration gives the network time, as the
+ * modem does on the nRF9160.
+ */
+
+#include <zephyr.h>
+#include <stdio.h>
+#include <string.h>
+#include <modem/lte_lc.h>
+#include <modem/modem_info.h>
+#include <date_time.h>
+
+#include "sim_modem.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(sim_modem, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+#define SIM_RSRP 45
+#define SIM_PSM_TAU_SEC 3600
+
+static lte_lc_evt_handler_t lte_handler;
+static rsrp_cb_t rsrp_handler;
+static struct k_delayed_work attach_work;
+static struct k_delayed_work rrc_idle_work;
+static atomic_t rrc_connected;
+
+/* The start of the GPS trace, 2020-09-01 08:00:00 UTC. */
+static const struct tm network_time = {
+	.tm_year = 2020 - 1900,
+	.tm_mon = 8,
+	.tm_mday = 1,
+	.tm_hour = 8,
+};
+
+static void rrc_evt_send(enum lte_lc_rrc_mode mode)
+{
+	struct lte_lc_evt evt = {
+		.type = LTE_LC_EVT_RRC_UPDATE,
+		.rrc_mode = mode,
+	};
+
+	if (lte_handler != NULL) {
+		lte_handler(&evt);
+	}
+}
+
+static void rrc_idle_work_fn(struct k_work *work)
+{
+	if (atomic_cas(&rrc_connected, true, false)) {
+		rrc_evt_send(LTE_LC_RRC_MODE_IDLE);
+	}
+}
+
+void sim_modem_traffic(void)
+{
+	if (atomic_cas(&rrc_connected, false, true)) {
+		rrc_evt_send(LTE_LC_RRC_MODE_CONNECTED);
+	}
+
+	k_delayed_work_submit(&rrc_idle_work,
+			      K_SECONDS(CONFIG_SIMULATION_RRC_INACTIVITY_SEC));
+}
+
+static void attach_work_fn(struct k_work *work)
+{
+	struct lte_lc_evt evt = {
+		.type = LTE_LC_EVT_NW_REG_STATUS,
+		.nw_reg_status = LTE_LC_NW_REG_REGISTERED_HOME,
+	};
+	struct tm time = network_time;
+
+	LOG_INF("Registered with the simulated network");
+	date_time_set(&time);
+	lte_handler(&evt);
+
+	if (rsrp_handler != NULL) {
+		rsrp_handler(SIM_RSRP);
+	}
+}
+
+int lte_lc_init_and_connect_async(lte_lc_evt_handler_t handler)
+{
+	if (handler == NULL) {
+		return -EINVAL;
+	}
+
+	lte_handler = handler;
+	k_delayed_work_init(&attach_work, attach_work_fn);
+	k_delayed_work_init(&rrc_idle_work, rrc_idle_work_fn);
+	k_delayed_work_submit(&attach_work,
+			      K_SECONDS(CONFIG_SIMULATION_LTE_ATTACH_SEC));
+
+	return 0;
+}
+
+int lte_lc_psm_req(bool enable)
+{
+	struct lte_lc_evt evt = { .type = LTE_LC_EVT_PSM_UPDATE };
+
+	if (lte_handler == NULL) {
+		return -EINVAL;
+	}
+
+	if (enable && CONFIG_SIMULATION_PSM_ACTIVE_TIME_SEC >= 0) {
+		evt.psm_cfg.tau = SIM_PSM_TAU_SEC;
+		evt.psm_cfg.active_time = CONFIG_SIMULATION_PSM_ACTIVE_TIME_SEC;
+	} else {
+		evt.psm_cfg.tau = -1;
+		evt.psm_cfg.active_time = -1;
+	}
+
+	lte_handler(&evt);
+
+	return 0;
+}
+
+int modem_info_init(void)
+{
+	return 0;
+}
+
+int modem_info_params_init(struct modem_param_info *modem)
+{
+	if (modem == NULL) {
+		return -EINVAL;
+	}
+
+	memset(modem, 0, sizeof(*modem));
+	modem->device.board = CONFIG_BOARD;
+
+	return 0;
+}
+
+int modem_info_rsrp_register(rsrp_cb_t cb)
+{
+	rsrp_handler = cb;
+
+	return 0;
+}
+
+int modem_info_params_get(struct modem_param_info *modem)
+{
+	struct network_param *network = &modem->network;
+
+	network->current_band.value = 20;
+	network->area_code.value = 0x1234;
+	network->lte_mode.value = 1;
+	network->nbiot_mode.value = 0;
+	network->gps_mode.value = 1;
+	network->cellid_dec = 12345678;
+	strcpy(network->current_operator.value_string, "00101");
+#if defined(CONFIG_NET_CONFIG_MY_IPV4_ADDR)
+	strcpy(network->ip_address.value_string,
+	       CONFIG_NET_CONFIG_MY_IPV4_ADDR);
+#endif
+	strcpy(modem->sim.iccid.value_string, "8900000000000000000");
+	strcpy(modem->device.modem_fw.value_string, "simulation");
+	modem->device.battery.value = 4000;
+
+	return 0;
+}
+
+int modem_info_string_get(enum modem_info info, char *buf,
+			  const size_t buf_size)
+{
+	switch (info) {
+	case MODEM_INFO_IMEI:
+		return snprintf(buf, buf_size, "%s", CONFIG_SIMULATION_IMEI);
+	default:
+		return -ENOTSUP;
+	}
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   Traffic hook of the simulated modem.
+ */
+
+#ifndef SIM_MODEM_H__
+#define SIM_MODEM_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Report traffic on the link. Enters RRC connected mode and restarts
+ *	  the inactivity timer of CONFIG_SIMULATION_RRC_INACTIVITY_SEC.
+ */
+void sim_modem_traffic(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_MODEM_H__ */
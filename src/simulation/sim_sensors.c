@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <stdio.h>
+#include <string.h>
+#include <drivers/sensor.h>
+#include "sim_trace.h"
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(sim_sensors, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+#define LINE_LEN 80
+
+static const char accel_trace_buf[] = {
+#include "sim_accel_trace.inc"
+};
+
+static const char env_trace_buf[] = {
+#include "sim_env_trace.inc"
+};
+
+static struct {
+	struct device *dev;
+	struct sim_trace trace;
+	struct k_delayed_work work;
+	struct sensor_trigger trig;
+	sensor_trigger_handler_t handler;
+	/* Values of the last trigger and the next one. */
+	double xyz[3];
+	double next[3];
+} accel = { .trace = SIM_TRACE_INIT(accel_trace_buf) };
+
+#define ENV_TEMP BIT(0)
+#define ENV_HUMIDITY BIT(1)
+
+static struct {
+	struct sim_trace trace;
+	double temp;
+	double humidity;
+	/* Values of the current line not read yet. A line is a reading of
+	 * both, which are fetched one after the other.
+	 */
+	u8_t unread;
+} env = { .trace = SIM_TRACE_INIT(env_trace_buf) };
+
+static void sensor_value_set(struct sensor_value *val, double d)
+{
+	val->val1 = (s32_t)d;
+	val->val2 = (s32_t)((d - val->val1) * 1000000);
+}
+
+/* Reads the next trigger, returns its delay in ms or -1 without one. */
+static s32_t accel_next(void)
+{
+	char line[LINE_LEN];
+	double delay;
+
+	if (!sim_trace_line(&accel.trace, line, sizeof(line))) {
+		return -1;
+	}
+
+	if (sscanf(line, "%lf %lf %lf %lf", &delay, &accel.next[0],
+		   &accel.next[1], &accel.next[2]) != 4) {
+		LOG_WRN("Malformed accelerometer trace line: %s",
+			log_strdup(line));
+		return -1;
+	}
+
+	return delay * MSEC_PER_SEC;
+}
+
+static void accel_work_fn(struct k_work *work)
+{
+	s32_t delay;
+
+	memcpy(accel.xyz, accel.next, sizeof(accel.xyz));
+	accel.handler(accel.dev, &accel.trig);
+
+	delay = accel_next();
+	if (delay >= 0) {
+		k_delayed_work_submit(&accel.work, delay);
+	}
+}
+
+static int accel_trigger_set(struct device *dev,
+			     const struct sensor_trigger *trig,
+			     sensor_trigger_handler_t handler)
+{
+	s32_t delay;
+
+	if (trig->type != SENSOR_TRIG_THRESHOLD) {
+		return -ENOTSUP;
+	}
+
+	k_delayed_work_cancel(&accel.work);
+
+	accel.dev = dev;
+	accel.trig = *trig;
+	accel.handler = handler;
+
+	if (handler == NULL) {
+		return 0;
+	}
+
+	delay = accel_next();
+	if (delay >= 0) {
+		k_delayed_work_submit(&accel.work, delay);
+	}
+
+	return 0;
+}
+
+static int accel_sample_fetch(struct device *dev, enum sensor_channel chan)
+{
+	return 0;
+}
+
+static int accel_channel_get(struct device *dev, enum sensor_channel chan,
+			     struct sensor_value *val)
+{
+	switch (chan) {
+	case SENSOR_CHAN_ACCEL_X:
+	case SENSOR_CHAN_ACCEL_Y:
+	case SENSOR_CHAN_ACCEL_Z:
+		sensor_value_set(val, accel.xyz[chan - SENSOR_CHAN_ACCEL_X]);
+		return 0;
+	case SENSOR_CHAN_ACCEL_XYZ:
+		for (int i = 0; i < ARRAY_SIZE(accel.xyz); i++) {
+			sensor_value_set(&val[i], accel.xyz[i]);
+		}
+		return 0;
+	default:
+		return -ENOTSUP;
+	}
+}
+
+static const struct sensor_driver_api accel_api = {
+	.trigger_set = accel_trigger_set,
+	.sample_fetch = accel_sample_fetch,
+	.channel_get = accel_channel_get,
+};
+
+static int accel_setup(struct device *dev)
+{
+	k_delayed_work_init(&accel.work, accel_work_fn);
+
+	return 0;
+}
+
+DEVICE_AND_API_INIT(sim_accel, CONFIG_ACCELEROMETER_DEV_NAME, accel_setup,
+		    NULL, NULL, POST_KERNEL, CONFIG_SENSOR_INIT_PRIORITY,
+		    &accel_api);
+
+static int env_sample_fetch(struct device *dev, enum sensor_channel chan)
+{
+	char line[LINE_LEN];
+
+	if (env.unread != 0) {
+		return 0;
+	}
+
+	if (!sim_trace_line(&env.trace, line, sizeof(line))) {
+		return -ENODATA;
+	}
+
+	if (sscanf(line, "%lf %lf", &env.temp, &env.humidity) != 2) {
+		LOG_WRN("Malformed environment trace line: %s",
+			log_strdup(line));
+		return -EIO;
+	}
+
+	env.unread = ENV_TEMP | ENV_HUMIDITY;
+
+	return 0;
+}
+
+static int env_channel_get(struct device *dev, enum sensor_channel chan,
+			   struct sensor_value *val)
+{
+	switch (chan) {
+	case SENSOR_CHAN_AMBIENT_TEMP:
+		sensor_value_set(val, env.temp);
+		env.unread &= ~ENV_TEMP;
+		return 0;
+	case SENSOR_CHAN_HUMIDITY:
+		sensor_value_set(val, env.humidity);
+		env.unread &= ~ENV_HUMIDITY;
+		return 0;
+	default:
+		return -ENOTSUP;
+	}
+}
+
+static const struct sensor_driver_api env_api = {
+	.sample_fetch = env_sample_fetch,
+	.channel_get = env_channel_get,
+};
+
+static int env_setup(struct device *dev)
+{
+	ARG_UNUSED(dev);
+
+	return 0;
+}
+
+DEVICE_AND_API_INIT(sim_env, CONFIG_MULTISENSOR_DEV_NAME, env_setup, NULL,
+		    NULL, POST_KERNEL, CONFIG_SENSOR_INIT_PRIORITY, &env_api);
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/* Provisions the credentials of the local broker, which the modem keeps on
+ * the nRF9160.
+ */
+
+#include <zephyr.h>
+#include <init.h>
+#include <net/tls_credentials.h>
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(sim_tls, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+/* mbedTLS takes PEM with the terminating null character. */
+static const char ca_crt[] = {
+#include "sim_ca_crt.inc"
+	0x00
+};
+
+static const char client_crt[] = {
+#include "sim_client_crt.inc"
+	0x00
+};
+
+static const char client_key[] = {
+#include "sim_client_key.inc"
+	0x00
+};
+
+static int sim_tls_setup(struct device *dev)
+{
+	int err;
+
+	ARG_UNUSED(dev);
+
+	err = tls_credential_add(CONFIG_AWS_IOT_SEC_TAG,
+				 TLS_CREDENTIAL_CA_CERTIFICATE, ca_crt,
+				 sizeof(ca_crt));
+	if (err) {
+		LOG_ERR("CA certificate not added, error: %d", err);
+		return err;
+	}
+
+	/* The "server" certificate is the own certificate of either end. */
+	err = tls_credential_add(CONFIG_AWS_IOT_SEC_TAG,
+				 TLS_CREDENTIAL_SERVER_CERTIFICATE,
+				 client_crt, sizeof(client_crt));
+	if (err) {
+		LOG_ERR("Client certificate not added, error: %d", err);
+		return err;
+	}
+
+	err = tls_credential_add(CONFIG_AWS_IOT_SEC_TAG,
+				 TLS_CREDENTIAL_PRIVATE_KEY, client_key,
+				 sizeof(client_key));
+	if (err) {
+		LOG_ERR("Client key not added, error: %d", err);
+	}
+
+	return err;
+}
+
+SYS_INIT(sim_tls_setup, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
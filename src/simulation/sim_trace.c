@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include "sim_trace.h"
+
+bool sim_trace_line(struct sim_trace *trace, char *line, size_t size)
+{
+	size_t skipped = 0;
+
+	while (skipped < trace->len) {
+		size_t len = 0;
+
+		while (trace->pos < trace->len &&
+		       trace->buf[trace->pos] != '\n') {
+			if (trace->buf[trace->pos] != '\r' && len < size - 1) {
+				line[len++] = trace->buf[trace->pos];
+			}
+
+			trace->pos++;
+			skipped++;
+		}
+
+		/* The line break, or the end of a trace without one. */
+		if (trace->pos < trace->len) {
+			trace->pos++;
+			skipped++;
+		}
+
+		if (trace->pos == trace->len) {
+			trace->pos = 0;
+		}
+
+		line[len] = '\0';
+
+		if (len > 0 && line[0] != '#') {
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   Line reader for the trace files built into the simulation.
+ */
+
+#ifndef SIM_TRACE_H__
+#define SIM_TRACE_H__
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct sim_trace {
+	const char *buf;
+	size_t len;
+	size_t pos;
+};
+
+#define SIM_TRACE_INIT(array) { .buf = (array), .len = sizeof(array) }
+
+/**
+ * @brief Get the next line of a trace, starting over at its end. Empty lines
+ *	  and lines starting with '#' are skipped.
+ *
+ * @param trace Trace.
+ * @param line Buffer for the line, without the line break.
+ * @param size Size of the buffer, longer lines are cut.
+ *
+ * @return true if a line was read, false if the trace has none.
+ */
+bool sim_trace_line(struct sim_trace *trace, char *line, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_TRACE_H__ */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+#include <stdio.h>
+#include "stack_monitor.h"
+
+#if defined(CONFIG_SHELL)
+#include <shell/shell.h>
+#endif
+
+#include <logging/log.h>
+LOG_MODULE_REGISTER(stack_monitor, CONFIG_CAT_TRACKER_LOG_LEVEL);
+
+struct thread_list {
+	struct k_thread *thread[CONFIG_STACK_MONITOR_THREADS_MAX];
+	int cnt;
+};
+
+static void thread_collect(const struct k_thread *thread, void *user_data)
+{
+	struct thread_list *list = user_data;
+
+	if (list->cnt < ARRAY_SIZE(list->thread)) {
+		list->thread[list->cnt++] = (struct k_thread *)thread;
+	}
+}
+
+int stack_monitor_get(struct stack_monitor_thread *threads, int max)
+{
+	struct thread_list list = { .cnt = 0 };
+	int cnt = 0;
+
+	/* The thread list is locked while it is walked, the stacks are
+	 * scanned afterwards. The firmware threads never exit.
+	 */
+	k_thread_foreach(thread_collect, &list);
+
+	for (int i = 0; i < list.cnt && cnt < max; i++) {
+		struct k_thread *thread = list.thread[i];
+		const char *name = k_thread_name_get(thread);
+		size_t size = thread->stack_info.size;
+		size_t unused;
+		int err;
+
+		err = k_thread_stack_space_get(thread, &unused);
+		if (err) {
+			LOG_WRN("Stack of thread %p not measured, error: %d",
+				thread, err);
+			continue;
+		}
+
+		if (name != NULL && name[0] != '\0') {
+			snprintf(threads[cnt].name, sizeof(threads[cnt].name),
+				 "%s", name);
+		} else {
+			snprintf(threads[cnt].name, sizeof(threads[cnt].name),
+				 "anon%d", (int)size);
+		}
+
+		threads[cnt].size = size;
+		threads[cnt].used = size - unused;
+		cnt++;
+	}
+
+	return cnt;
+}
+
+#if defined(CONFIG_SHELL)
+static int cmd_stacks(const struct shell *shell, size_t argc, char **argv)
+{
+	struct stack_monitor_thread threads[CONFIG_STACK_MONITOR_THREADS_MAX];
+	int cnt;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	cnt = stack_monitor_get(threads, ARRAY_SIZE(threads));
+
+	shell_print(shell, "%-16s %6s %6s %4s", "Thread", "Size", "Used",
+		    "%");
+
+	for (int i = 0; i < cnt; i++) {
+		shell_print(shell, "%-16s %6d %6d %4d", threads[i].name,
+			    threads[i].size, threads[i].used,
+			    threads[i].used * 100 / threads[i].size);
+	}
+
+	return 0;
+}
+
+SHELL_CMD_REGISTER(stacks, NULL, "Print stack high-water marks", cmd_stacks);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   Stack high-water marks of the firmware threads.
+ */
+
+#ifndef STACK_MONITOR_H__
+#define STACK_MONITOR_H__
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Length of a thread name in the report, NUL included. */
+#define STACK_MONITOR_NAME_LEN 16
+
+/** @brief Stack usage of a thread. */
+struct stack_monitor_thread {
+	/** Thread name, "anon" and the stack size for unnamed threads. */
+	char name[STACK_MONITOR_NAME_LEN];
+	/** Stack size in bytes. */
+	u32_t size;
+	/** Most bytes of the stack used since the thread started. */
+	u32_t used;
+};
+
+/**
+ * @brief Measure the stack high-water marks of the running threads.
+ *
+ * Each stack is scanned for the untouched fill pattern, which takes a
+ * while for large stacks.
+ *
+ * @param threads Measured threads.
+ * @param max Maximum number of threads to measure.
+ *
+ * @return Number of measured threads.
+ */
+int stack_monitor_get(struct stack_monitor_thread *threads, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STACK_MONITOR_H__ */
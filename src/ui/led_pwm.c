@@ -11,6 +11,7 @@
 #include "ui.h"
 #include "led_pwm.h"
 #include "led_effect.h"
+#include "wakeup.h"
 
 struct led {
 	struct device *pwm_dev;
@@ -103,41 +104,90 @@ static void pwm_off(struct led *led)
 	pwm_out(led, &nocolor);
 }
 
-static void work_handler(struct k_work *work)
+/* Color change of the current substep, per channel. */
+static int substep_diff(const struct led *led, size_t i)
 {
-	struct led *led = CONTAINER_OF(work, struct led, work);
 	const struct led_effect_step *effect_step =
-		&leds.effect->steps[leds.effect_step];
-	int substeps_left = effect_step->substep_cnt - leds.effect_substep;
+		&led->effect->steps[led->effect_step];
+	int substeps_left = effect_step->substep_cnt - led->effect_substep;
+
+	return (effect_step->color.c[i] - led->color.c[i]) / substeps_left;
+}
+
+static bool substep_changes(const struct led *led)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(led->color.c); i++) {
+		if (substep_diff(led, i) != 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Moves to the next substep, false at the end of an effect that does not
+ * loop.
+ */
+static bool substep_next(struct led *led)
+{
+	led->effect_substep++;
+	if (led->effect_substep < led->effect->steps[led->effect_step]
+					  .substep_cnt) {
+		return true;
+	}
+
+	led->effect_substep = 0;
+	led->effect_step++;
+
+	if (led->effect_step == led->effect->step_cnt) {
+		if (!led->effect->loop_forever) {
+			return false;
+		}
 
-	for (size_t i = 0; i < ARRAY_SIZE(leds.color.c); i++) {
-		int diff = (effect_step->color.c[i] - leds.color.c[i]) /
-			   substeps_left;
-		leds.color.c[i] += diff;
+		led->effect_step = 0;
 	}
 
-	pwm_out(led, &leds.color);
+	__ASSERT_NO_MSG(led->effect->steps[led->effect_step].substep_cnt > 0);
+
+	return true;
+}
 
-	leds.effect_substep++;
-	if (leds.effect_substep == effect_step->substep_cnt) {
-		leds.effect_substep = 0;
-		leds.effect_step++;
+/* Schedules the next substep that changes the color, sleeping through the
+ * ones before it. Nothing is scheduled when no substep of a whole loop of
+ * the effect changes the color, the LED is static from then on.
+ */
+static void change_schedule(struct led *led, s32_t delay)
+{
+	size_t substeps_left = 0;
 
-		if (leds.effect_step == leds.effect->step_cnt) {
-			if (leds.effect->loop_forever) {
-				leds.effect_step = 0;
-			}
-		} else {
-			__ASSERT_NO_MSG(leds.effect->steps[leds.effect_step]
-						.substep_cnt > 0);
+	for (size_t i = 0; i < led->effect->step_cnt; i++) {
+		substeps_left += led->effect->steps[i].substep_cnt;
+	}
+
+	while (!substep_changes(led)) {
+		if (substeps_left-- == 0 || !substep_next(led)) {
+			return;
 		}
+
+		delay += led->effect->steps[led->effect_step].substep_time;
 	}
 
-	if (leds.effect_step < leds.effect->step_cnt) {
-		s32_t next_delay =
-			leds.effect->steps[leds.effect_step].substep_time;
+	wakeup_work_submit(&led->work, delay, UI_LED_SLACK(delay));
+}
 
-		k_delayed_work_submit(&leds.work, next_delay);
+static void work_handler(struct k_work *work)
+{
+	struct led *led = CONTAINER_OF(work, struct led, work);
+
+	for (size_t i = 0; i < ARRAY_SIZE(led->color.c); i++) {
+		led->color.c[i] += substep_diff(led, i);
+	}
+
+	pwm_out(led, &led->color);
+
+	if (substep_next(led)) {
+		change_schedule(led, led->effect->steps[led->effect_step]
+					     .substep_time);
 	}
 }
 
@@ -156,10 +206,7 @@ static void led_update(struct led *led)
 	__ASSERT_NO_MSG(led->effect->steps);
 
 	if (led->effect->step_cnt > 0) {
-		s32_t next_delay =
-			led->effect->steps[led->effect_step].substep_time;
-
-		k_delayed_work_submit(&led->work, next_delay);
+		change_schedule(led, led->effect->steps[0].substep_time);
 	} else {
 		printk("LED effect with no effect");
 	}
@@ -208,6 +255,7 @@ void ui_leds_stop(void)
 	}
 #endif
 	pwm_off(&leds);
+	memset(&leds.color, 0, sizeof(leds.color));
 }
 
 void ui_led_set_effect(enum ui_led_pattern state)
@@ -8,66 +8,119 @@
 
 #include "ui.h"
 #include "led_pwm.h"
+#include "wakeup.h"
 
 LOG_MODULE_REGISTER(ui, CONFIG_UI_LOG_LEVEL);
 
 static enum ui_led_pattern current_led_state;
+static struct k_delayed_work auto_off_work;
+static bool leds_dark;
+static bool initialized;
 
 #if !defined(CONFIG_UI_LED_USE_PWM)
 static struct k_delayed_work leds_update_work;
+static u8_t current_led_on_mask;
 
-/**@brief Update LEDs state. */
+static void leds_out(u8_t led_on_mask)
+{
+	if (led_on_mask != current_led_on_mask) {
+#if defined(CONFIG_DK_LIBRARY) || defined(CONFIG_SIMULATION)
+		dk_set_leds(led_on_mask);
+#endif
+		current_led_on_mask = led_on_mask;
+	}
+}
+
+/**@brief Update LEDs state. Runs at every blink, and once when a pattern
+ *	  without blinking LEDs is set.
+ */
 static void leds_update(struct k_work *work)
 {
 	static bool led_on;
-	static bool passive_mode;
-	static u8_t current_led_on_mask;
-	u8_t led_on_mask;
+	u8_t led_on_mask = UI_LED_GET_ON(current_led_state);
+	u8_t blink_mask = UI_LED_GET_BLINK(current_led_state);
+	s32_t period;
 
-	if (current_led_state == UI_LED_PASSIVE_MODE) {
-		passive_mode = true;
-	} else {
-		passive_mode = false;
-	}
-
-	led_on_mask = UI_LED_GET_ON(current_led_state);
 	led_on = !led_on;
 
 	if (led_on) {
-		led_on_mask |= UI_LED_GET_BLINK(current_led_state);
+		led_on_mask |= blink_mask;
 	} else {
-		led_on_mask &= ~UI_LED_GET_BLINK(current_led_state);
+		led_on_mask &= ~blink_mask;
 	}
 
-	if (led_on_mask != current_led_on_mask) {
-#if defined(CONFIG_DK_LIBRARY)
-		dk_set_leds(led_on_mask);
-#endif
-		current_led_on_mask = led_on_mask;
+	leds_out(led_on_mask);
+
+	if (blink_mask == 0) {
+		return;
 	}
 
-	if (work) {
-		if (led_on) {
-			k_delayed_work_submit(&leds_update_work,
-					      UI_LED_ON_PERIOD_NORMAL);
-		} else {
-			if (passive_mode) {
-				k_delayed_work_submit(&leds_update_work,
-						      UI_LED_OFF_PERIOD_LONG);
-			} else {
-				k_delayed_work_submit(&leds_update_work,
-						      UI_LED_OFF_PERIOD_NORMAL);
-			}
-		}
+	if (led_on) {
+		period = UI_LED_ON_PERIOD_NORMAL;
+	} else if (current_led_state == UI_LED_PASSIVE_MODE) {
+		period = UI_LED_OFF_PERIOD_LONG;
+	} else {
+		period = UI_LED_OFF_PERIOD_NORMAL;
 	}
+
+	wakeup_work_submit(&leds_update_work, period, UI_LED_SLACK(period));
 }
 #endif /* CONFIG_UI_LED_USE_PWM */
 
+static void auto_off(struct k_work *work)
+{
+	LOG_DBG("LEDs off until the next pattern or button press");
+
+	leds_dark = true;
+#ifdef CONFIG_UI_LED_USE_PWM
+	ui_leds_stop();
+#else
+	k_delayed_work_cancel(&leds_update_work);
+	leds_out(0);
+#endif /* CONFIG_UI_LED_USE_PWM */
+}
+
+/* Restarts the auto-off timeout, true if the LEDs had gone off. */
+static bool auto_off_restart(void)
+{
+	bool was_dark = leds_dark;
+
+	if (CONFIG_UI_LED_AUTO_OFF_SEC == 0) {
+		return false;
+	}
+
+	k_delayed_work_submit(&auto_off_work,
+			      K_SECONDS(CONFIG_UI_LED_AUTO_OFF_SEC));
+	leds_dark = false;
+
+	return was_dark;
+}
+
 void ui_led_set_pattern(enum ui_led_pattern state)
 {
+	bool was_dark;
+
+	if (state == current_led_state) {
+		return;
+	}
+
 	current_led_state = state;
+
+	/* Shown by ui_init(). */
+	if (!initialized) {
+		return;
+	}
+
+	was_dark = auto_off_restart();
 #ifdef CONFIG_UI_LED_USE_PWM
+	if (was_dark) {
+		ui_leds_start();
+	}
+
 	ui_led_set_effect(state);
+#else
+	ARG_UNUSED(was_dark);
+	k_delayed_work_submit(&leds_update_work, K_NO_WAIT);
 #endif /* CONFIG_UI_LED_USE_PWM */
 }
 
@@ -76,6 +129,19 @@ enum ui_led_pattern ui_led_get_pattern(void)
 	return current_led_state;
 }
 
+void ui_led_wake(void)
+{
+	if (!initialized || !auto_off_restart()) {
+		return;
+	}
+
+#ifdef CONFIG_UI_LED_USE_PWM
+	ui_leds_start();
+#else
+	k_delayed_work_submit(&leds_update_work, K_NO_WAIT);
+#endif /* CONFIG_UI_LED_USE_PWM */
+}
+
 int ui_init(void)
 {
 	int err = 0;
@@ -86,6 +152,8 @@ int ui_init(void)
 		LOG_ERR("Error when initializing PWM controlled LEDs");
 		return err;
 	}
+
+	ui_led_set_effect(current_led_state);
 #else
 	err = dk_leds_init();
 	if (err) {
@@ -103,6 +171,10 @@ int ui_init(void)
 	k_delayed_work_submit(&leds_update_work, K_NO_WAIT);
 #endif /* CONFIG_UI_LED_USE_PWM */
 
+	k_delayed_work_init(&auto_off_work, auto_off);
+	initialized = true;
+	auto_off_restart();
+
 	return 0;
 }
 
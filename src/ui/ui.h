@@ -33,6 +33,9 @@ extern "C" {
 #define UI_LED_GET_ON(x) ((x)&0xFF)
 #define UI_LED_GET_BLINK(x) (((x) >> 8) & 0xFF)
 
+/* Blinks may run this much late, to share a wakeup. */
+#define UI_LED_SLACK(period) ((period) / 8)
+
 #ifdef CONFIG_UI_LED_USE_PWM
 
 #define UI_LED_ON_PERIOD_NORMAL 500
@@ -126,6 +129,12 @@ int ui_init(void);
  */
 void ui_led_set_pattern(enum ui_led_pattern pattern);
 
+/**
+ * @brief Turns the LEDs back on after CONFIG_UI_LED_AUTO_OFF_SEC without a
+ *	  new pattern, and restarts that timeout.
+ */
+void ui_led_wake(void);
+
 /**
  * @brief Gets the LED pattern.
  *
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <zephyr.h>
+
+#include "wakeup.h"
+
+/** Pending deadline, in uptime, of the work or thread that owns it. */
+struct deadline {
+	const void *owner;
+	s64_t ts;
+};
+
+static struct deadline deadlines[CONFIG_WAKEUP_DEADLINES_MAX];
+static struct k_spinlock lock;
+
+/* Finds the deadline for a window and records it for the owner, replacing
+ * the one it had. Expired deadlines are freed on the way, a cancelled one
+ * lingers until then and at worst makes others wake up later than needed.
+ */
+static s64_t deadline_take(const void *owner, s64_t now, s32_t delay,
+			   s32_t slack)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	s64_t earliest = now + delay;
+	s64_t latest = earliest + slack;
+	s64_t ts = -1;
+	struct deadline *slot = NULL;
+
+	for (int i = 0; i < ARRAY_SIZE(deadlines); i++) {
+		struct deadline *d = &deadlines[i];
+
+		if (d->owner != NULL && d->ts < now) {
+			d->owner = NULL;
+		}
+
+		if (d->owner == owner) {
+			slot = d;
+			continue;
+		}
+
+		if (d->owner == NULL) {
+			slot = (slot == NULL) ? d : slot;
+			continue;
+		}
+
+		if (d->ts >= earliest && d->ts <= latest && d->ts > ts) {
+			ts = d->ts;
+		}
+	}
+
+	if (ts < 0) {
+		ts = latest - latest % CONFIG_WAKEUP_GRID_MS;
+		ts = MAX(ts, earliest);
+	}
+
+	if (slot != NULL) {
+		slot->owner = owner;
+		slot->ts = ts;
+	}
+
+	k_spin_unlock(&lock, key);
+
+	return ts;
+}
+
+int wakeup_work_submit(struct k_delayed_work *work, s32_t delay, s32_t slack)
+{
+	s64_t now = k_uptime_get();
+
+	if (slack <= 0) {
+		return k_delayed_work_submit(work, delay);
+	}
+
+	return k_delayed_work_submit(
+		work, deadline_take(work, now, delay, slack) - now);
+}
+
+s32_t wakeup_sleep(s32_t delay, s32_t slack)
+{
+	s64_t now = k_uptime_get();
+
+	if (slack <= 0) {
+		return k_sleep(delay);
+	}
+
+	return k_sleep(deadline_take(k_current_get(), now, delay, slack) -
+		       now);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+/**@file
+ *
+ * @brief   Wakeup coalescing of delayed work and sleeps that tolerate
+ *	    running late.
+ */
+
+#ifndef WAKEUP_H__
+#define WAKEUP_H__
+
+#include <zephyr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(CONFIG_WAKEUP_COALESCE)
+/**
+ * @brief Submit delayed work to run between @p delay and @p delay + @p slack
+ *	  from now, at a deadline shared with other work if possible.
+ *
+ * @param work Delayed work, resubmitted if pending.
+ * @param delay Delay in ms.
+ * @param slack Tolerated extra delay in ms.
+ *
+ * @return 0 or a negative error code of k_delayed_work_submit().
+ */
+int wakeup_work_submit(struct k_delayed_work *work, s32_t delay, s32_t slack);
+
+/**
+ * @brief Sleep between @p delay and @p delay + @p slack, waking up at a
+ *	  deadline shared with other work if possible.
+ *
+ * @return Time left to sleep when woken early, in ms.
+ */
+s32_t wakeup_sleep(s32_t delay, s32_t slack);
+#else
+static inline int wakeup_work_submit(struct k_delayed_work *work,
+				     s32_t delay, s32_t slack)
+{
+	ARG_UNUSED(slack);
+
+	return k_delayed_work_submit(work, delay);
+}
+
+static inline s32_t wakeup_sleep(s32_t delay, s32_t slack)
+{
+	ARG_UNUSED(slack);
+
+	return k_sleep(delay);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WAKEUP_H__ */
@@ -8,11 +8,16 @@
 #include <device.h>
 #include <drivers/watchdog.h>
 
+#include "wakeup.h"
+
 #include <logging/log.h>
 LOG_MODULE_REGISTER(watchdog, CONFIG_CAT_TRACKER_LOG_LEVEL);
 
 #define WDT_FEED_WORKER_DELAY_MS                                               \
 	((CONFIG_CAT_TRACKER_WATCHDOG_TIMEOUT_MSEC) / 2)
+/* A late feed still leaves a quarter of the timeout. */
+#define WDT_FEED_WORKER_SLACK_MS                                               \
+	((CONFIG_CAT_TRACKER_WATCHDOG_TIMEOUT_MSEC) / 4)
 
 struct wdt_data_storage {
 	struct device *wdt_drv;
@@ -31,8 +36,9 @@ static void primary_feed_worker(struct k_work *work_desc)
 	if (err) {
 		LOG_ERR("Cannot feed watchdog. Error code: %d", err);
 	} else {
-		k_delayed_work_submit(&wdt_data.system_workqueue_work,
-				      WDT_FEED_WORKER_DELAY_MS);
+		wakeup_work_submit(&wdt_data.system_workqueue_work,
+				   WDT_FEED_WORKER_DELAY_MS,
+				   WDT_FEED_WORKER_SLACK_MS);
 	}
 }
 
@@ -90,8 +96,9 @@ static int watchdog_feed_enable(struct wdt_data_storage *data)
 		return err;
 	}
 
-	err = k_delayed_work_submit(&data->system_workqueue_work,
-				    WDT_FEED_WORKER_DELAY_MS);
+	err = wakeup_work_submit(&data->system_workqueue_work,
+				 WDT_FEED_WORKER_DELAY_MS,
+				 WDT_FEED_WORKER_SLACK_MS);
 	if (err) {
 		LOG_ERR("Cannot start watchdog feed worker!"
 			" Error code: %d",
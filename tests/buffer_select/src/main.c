@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+
+#include "buffer_select.h"
+
+#define IDX_MAX 4
+
+struct entry {
+	s64_t ts;
+	bool queued;
+};
+
+static struct entry buf[8];
+static int idx[IDX_MAX];
+
+#define SELECT(newest_first)                                                   \
+	buffer_select(&buf[0].queued, &buf[0].ts, sizeof(buf[0]),              \
+		      ARRAY_SIZE(buf), idx, IDX_MAX, newest_first)
+
+/** A wrapped circular buffer, entry i was taken at ts[i]. */
+static void setup(void)
+{
+	const s64_t ts[ARRAY_SIZE(buf)] = { 50, 60, 70, 80, 10, 20, 30, 40 };
+
+	for (int i = 0; i < ARRAY_SIZE(buf); i++) {
+		buf[i].ts = ts[i];
+		buf[i].queued = false;
+	}
+
+	memset(idx, 0xff, sizeof(idx));
+}
+
+static void selection_check(int cnt, const int *expected, int expected_cnt)
+{
+	zassert_equal(cnt, expected_cnt, "%d entries selected", cnt);
+
+	for (int i = 0; i < expected_cnt; i++) {
+		zassert_equal(idx[i], expected[i], "Entry %d at %d", idx[i],
+			      i);
+	}
+}
+
+static void test_none_queued(void)
+{
+	setup();
+
+	zassert_equal(SELECT(true), 0, "Entries selected");
+}
+
+static void test_newest_first(void)
+{
+	const int expected[] = { 2, 6, 5 };
+
+	setup();
+	buf[2].queued = true;
+	buf[5].queued = true;
+	buf[6].queued = true;
+
+	selection_check(SELECT(true), expected, ARRAY_SIZE(expected));
+}
+
+static void test_oldest_first(void)
+{
+	const int expected[] = { 5, 6, 2 };
+
+	setup();
+	buf[2].queued = true;
+	buf[5].queued = true;
+	buf[6].queued = true;
+
+	selection_check(SELECT(false), expected, ARRAY_SIZE(expected));
+}
+
+static void test_newest_limited(void)
+{
+	const int expected[] = { 3, 2, 1, 0 };
+
+	setup();
+	for (int i = 0; i < ARRAY_SIZE(buf); i++) {
+		buf[i].queued = true;
+	}
+
+	selection_check(SELECT(true), expected, ARRAY_SIZE(expected));
+}
+
+static void test_oldest_limited(void)
+{
+	const int expected[] = { 4, 5, 6, 7 };
+
+	setup();
+	for (int i = 0; i < ARRAY_SIZE(buf); i++) {
+		buf[i].queued = true;
+	}
+
+	selection_check(SELECT(false), expected, ARRAY_SIZE(expected));
+}
+
+static void test_equal_timestamps_keep_order(void)
+{
+	const int expected[] = { 1, 3, 6 };
+
+	setup();
+	buf[1].queued = true;
+	buf[3].queued = true;
+	buf[6].queued = true;
+	buf[1].ts = buf[3].ts = buf[6].ts = 100;
+
+	selection_check(SELECT(true), expected, ARRAY_SIZE(expected));
+	selection_check(SELECT(false), expected, ARRAY_SIZE(expected));
+}
+
+void test_main(void)
+{
+	ztest_test_suite(buffer_select,
+			 ztest_unit_test(test_none_queued),
+			 ztest_unit_test(test_newest_first),
+			 ztest_unit_test(test_oldest_first),
+			 ztest_unit_test(test_newest_limited),
+			 ztest_unit_test(test_oldest_limited),
+			 ztest_unit_test(test_equal_timestamps_keep_order));
+
+	ztest_run_test_suite(buffer_select);
+}
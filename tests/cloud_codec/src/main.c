@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <cloud_codec.h>
+#include <date_time.h>
+
+static struct cloud_data_cfg cfg;
+
+/* Only the encoders time stamp their output. */
+int date_time_uptime_to_unix_time_ms(s64_t *uptime)
+{
+	return -ENODATA;
+}
+
+static int trkt_decode(const char *value)
+{
+	char input[64];
+
+	snprintf(input, sizeof(input), "{\"state\":{\"cfg\":{\"trkt\":%s}}}",
+		 value);
+
+	return cloud_codec_decode_response(input, &cfg);
+}
+
+static void test_trkt_set(void)
+{
+	cfg.trkt = 10;
+
+	zassert_equal(trkt_decode("50"), 0, "Decoding failed");
+	zassert_equal(cfg.trkt, 50, "Tolerance not set");
+
+	zassert_equal(trkt_decode("0"), 0, "Decoding failed");
+	zassert_equal(cfg.trkt, 0, "Tolerance not disabled");
+
+	zassert_equal(trkt_decode("1000"), 0, "Decoding failed");
+	zassert_equal(cfg.trkt, 1000, "Largest tolerance not set");
+}
+
+static void test_trkt_out_of_range(void)
+{
+	const char *values[] = { "-1", "1001", "2147483647", "\"20\"", "null" };
+
+	for (int i = 0; i < ARRAY_SIZE(values); i++) {
+		cfg.trkt = 10;
+
+		zassert_equal(trkt_decode(values[i]), 0, "Decoding failed");
+		zassert_equal(cfg.trkt, 10, "Tolerance %s accepted",
+			      values[i]);
+	}
+}
+
+static void test_ack_decode(void)
+{
+	struct cloud_data_ack ack;
+	char input[] = "{\"ack\":{\"bat\":[[0,4294967295]]},"
+		       "\"nack\":{\"gps\":[7,[8,9]]}}";
+
+	zassert_equal(cloud_codec_decode_ack(input, &ack), 0,
+		      "Decoding failed");
+	zassert_equal(ack.ack_cnt[CLOUD_DATA_STREAM_BAT], 1, "No ack range");
+	zassert_equal(ack.ack[CLOUD_DATA_STREAM_BAT][0].first, 0, "First");
+	zassert_equal(ack.ack[CLOUD_DATA_STREAM_BAT][0].last, UINT32_MAX,
+		      "Last");
+	zassert_equal(ack.nack_cnt[CLOUD_DATA_STREAM_GPS], 2, "No nack ranges");
+	zassert_equal(ack.nack[CLOUD_DATA_STREAM_GPS][0].last, 7, "Single");
+	zassert_equal(ack.nack[CLOUD_DATA_STREAM_GPS][1].first, 8, "Pair");
+}
+
+static void test_ack_decode_invalid(void)
+{
+	const char *values[] = { "-1", "1.5", "4294967296", "\"5\"", "null",
+				 "[5,\"6\"]", "[-1,5]", "[6,5]", "[5]" };
+
+	for (int i = 0; i < ARRAY_SIZE(values); i++) {
+		struct cloud_data_ack ack;
+		char input[64];
+
+		snprintf(input, sizeof(input), "{\"ack\":{\"gps\":[%s]}}",
+			 values[i]);
+
+		zassert_equal(cloud_codec_decode_ack(input, &ack), -EINVAL,
+			      "Sequence number %s accepted", values[i]);
+	}
+}
+
+void test_main(void)
+{
+	ztest_test_suite(cloud_codec,
+			 ztest_unit_test(test_trkt_set),
+			 ztest_unit_test(test_trkt_out_of_range),
+			 ztest_unit_test(test_ack_decode),
+			 ztest_unit_test(test_ack_decode_invalid));
+
+	ztest_run_test_suite(cloud_codec);
+}
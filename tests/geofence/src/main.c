@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <math.h>
+#include <cloud_codec.h>
+
+#include "geofence.h"
+
+#define LAT0 63.42
+#define LNG0 10.40
+#define METERS_PER_DEGREE 111320.0
+#define DEG_TO_RAD (3.14159265358979 / 180.0)
+#define LNG_SCALE (METERS_PER_DEGREE * cos(LAT0 * DEG_TO_RAD))
+#define RADIUS_M 100
+#define HALF_SIDE_M 100.0
+#define HYST CONFIG_GEOFENCE_HYSTERESIS_M
+
+static struct geofence_evt evts[8];
+static int evt_cnt;
+
+static void evt_handler(const struct geofence_evt *const evt)
+{
+	if (evt_cnt < ARRAY_SIZE(evts)) {
+		evts[evt_cnt] = *evt;
+	}
+
+	evt_cnt++;
+}
+
+/** Evaluate a fix given in meters east and north of LAT0, LNG0. Returns
+ *  the number of events.
+ */
+static int evaluate(double east, double north)
+{
+	evt_cnt = 0;
+
+	return geofence_evaluate(LAT0 + north / METERS_PER_DEGREE,
+				 LNG0 + east / LNG_SCALE);
+}
+
+static struct cloud_data_geofence circle(int id)
+{
+	struct cloud_data_geofence zone = {
+		.id = id,
+		.lat = { LAT0 },
+		.lng = { LNG0 },
+		.radius = RADIUS_M,
+	};
+
+	return zone;
+}
+
+/** Square around LAT0, LNG0. */
+static struct cloud_data_geofence square(int id)
+{
+	struct cloud_data_geofence zone = {
+		.id = id,
+		.vertex_cnt = 4,
+	};
+	const double corners[4][2] = {
+		{ -HALF_SIDE_M, -HALF_SIDE_M },
+		{ HALF_SIDE_M, -HALF_SIDE_M },
+		{ HALF_SIDE_M, HALF_SIDE_M },
+		{ -HALF_SIDE_M, HALF_SIDE_M },
+	};
+
+	for (int i = 0; i < 4; i++) {
+		zone.lng[i] = LNG0 + corners[i][0] / LNG_SCALE;
+		zone.lat[i] = LAT0 + corners[i][1] / METERS_PER_DEGREE;
+	}
+
+	return zone;
+}
+
+static void zone_set(struct cloud_data_geofence zone)
+{
+	zassert_equal(geofence_set(&zone, 1), 0, "Zone not set");
+
+	/* Start out inside. */
+	zassert_equal(evaluate(0.0, 0.0), 1, "No initial event");
+	zassert_equal(evts[0].type, GEOFENCE_EVT_ENTER, "Not entered");
+	zassert_equal(evts[0].id, zone.id, "Wrong zone");
+}
+
+static void test_init_needs_handler(void)
+{
+	zassert_equal(geofence_init(NULL), -EINVAL, "NULL handler taken");
+	zassert_equal(geofence_init(evt_handler), 0, "Handler not taken");
+}
+
+static void test_invalid_zones_rejected(void)
+{
+	struct cloud_data_geofence zones[CONFIG_GEOFENCE_MAX + 1];
+
+	for (int i = 0; i < ARRAY_SIZE(zones); i++) {
+		zones[i] = circle(i);
+	}
+
+	zassert_equal(geofence_set(zones, ARRAY_SIZE(zones)), -ENOMEM,
+		      "Too many zones set");
+
+	zones[0].radius = 0;
+	zassert_equal(geofence_set(zones, 1), -EINVAL, "Empty circle set");
+
+	zones[0] = square(0);
+	zones[0].vertex_cnt = 2;
+	zassert_equal(geofence_set(zones, 1), -EINVAL, "Line set");
+
+	zones[0].vertex_cnt = CONFIG_GEOFENCE_VERTICES_MAX + 1;
+	zassert_equal(geofence_set(zones, 1), -EINVAL,
+		      "Too many vertices set");
+
+	zassert_equal(geofence_set(zones, 0), 0, "Zones not cleared");
+	zassert_equal(geofence_count(), 0, "Zones left");
+}
+
+static void test_initial_state_reported(void)
+{
+	struct cloud_data_geofence zone = circle(1);
+
+	zassert_equal(geofence_set(&zone, 1), 0, "Zone not set");
+	zassert_equal(geofence_count(), 1, "Zone not counted");
+
+	zassert_equal(evaluate(0.0, 1000.0), 1, "No initial event");
+	zassert_equal(evts[0].type, GEOFENCE_EVT_EXIT, "Not outside");
+
+	zassert_equal(evaluate(0.0, 2000.0), 0, "Event without transition");
+}
+
+static void test_circle_hysteresis(void)
+{
+	zone_set(circle(2));
+
+	/* Just across the border, within the hysteresis. */
+	zassert_equal(evaluate(RADIUS_M + HYST / 2, 0.0), 0, "Left early");
+
+	zassert_equal(evaluate(RADIUS_M + 2 * HYST, 0.0), 1, "Not left");
+	zassert_equal(evts[0].type, GEOFENCE_EVT_EXIT, "Not an exit");
+
+	zassert_equal(evaluate(RADIUS_M - HYST / 2, 0.0), 0, "Entered early");
+
+	zassert_equal(evaluate(RADIUS_M - 2 * HYST, 0.0), 1, "Not entered");
+	zassert_equal(evts[0].type, GEOFENCE_EVT_ENTER, "Not an enter");
+}
+
+static void test_polygon_hysteresis(void)
+{
+	zone_set(square(3));
+
+	/* Across the north edge and, outside the box, past a corner. */
+	zassert_equal(evaluate(0.0, HALF_SIDE_M + HYST / 2), 0, "Left early");
+	zassert_equal(evaluate(HALF_SIDE_M + HYST / 2, HALF_SIDE_M), 0,
+		      "Left early at the corner");
+
+	zassert_equal(evaluate(0.0, HALF_SIDE_M + 2 * HYST), 1, "Not left");
+	zassert_equal(evts[0].type, GEOFENCE_EVT_EXIT, "Not an exit");
+
+	zassert_equal(evaluate(0.0, HALF_SIDE_M - HYST / 2), 0,
+		      "Entered early");
+
+	zassert_equal(evaluate(0.0, HALF_SIDE_M - 2 * HYST), 1,
+		      "Not entered");
+	zassert_equal(evts[0].type, GEOFENCE_EVT_ENTER, "Not an enter");
+}
+
+static void test_polygon_concave(void)
+{
+	/* An L, the notch in the north east is outside. */
+	struct cloud_data_geofence zone = {
+		.id = 4,
+		.vertex_cnt = 6,
+	};
+	const double corners[6][2] = {
+		{ 0.0, 0.0 },
+		{ 1000.0, 0.0 },
+		{ 1000.0, 500.0 },
+		{ 500.0, 500.0 },
+		{ 500.0, 1000.0 },
+		{ 0.0, 1000.0 },
+	};
+
+	for (int i = 0; i < 6; i++) {
+		zone.lng[i] = LNG0 + corners[i][0] / LNG_SCALE;
+		zone.lat[i] = LAT0 + corners[i][1] / METERS_PER_DEGREE;
+	}
+
+	zassert_equal(geofence_set(&zone, 1), 0, "Zone not set");
+
+	zassert_equal(evaluate(750.0, 750.0), 1, "No initial event");
+	zassert_equal(evts[0].type, GEOFENCE_EVT_EXIT, "Notch inside");
+
+	zassert_equal(evaluate(250.0, 750.0), 1, "Arm not entered");
+	zassert_equal(evts[0].type, GEOFENCE_EVT_ENTER, "Not an enter");
+}
+
+static void test_state_kept_on_update(void)
+{
+	struct cloud_data_geofence zones[2] = { circle(5), square(6) };
+
+	zone_set(zones[0]);
+
+	/* Zone 5 is unchanged, only the new zone reports its state. */
+	zassert_equal(geofence_set(zones, 2), 0, "Zones not set");
+	zassert_equal(evaluate(0.0, 0.0), 1, "Wrong number of events");
+	zassert_equal(evts[0].id, 6, "Event of the kept zone");
+	zassert_equal(evts[0].type, GEOFENCE_EVT_ENTER, "Not an enter");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(geofence,
+			 ztest_unit_test(test_init_needs_handler),
+			 ztest_unit_test(test_invalid_zones_rejected),
+			 ztest_unit_test(test_initial_state_reported),
+			 ztest_unit_test(test_circle_hysteresis),
+			 ztest_unit_test(test_polygon_hysteresis),
+			 ztest_unit_test(test_polygon_concave),
+			 ztest_unit_test(test_state_kept_on_update));
+
+	ztest_run_test_suite(geofence);
+}
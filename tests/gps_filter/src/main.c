@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <math.h>
+#include <drivers/gps.h>
+
+#include "gps_filter.h"
+
+#define LAT0 63.42
+#define LNG0 10.40
+#define METERS_PER_DEGREE 111320.0
+#define DEG_TO_RAD (3.14159265358979 / 180.0)
+#define LNG_SCALE (METERS_PER_DEGREE * cos(LAT0 * DEG_TO_RAD))
+
+/** Fix at a position given in meters east and north of LAT0, LNG0. */
+static struct gps_pvt fix(double east, double north, float accuracy)
+{
+	struct gps_pvt pvt = {
+		.latitude = LAT0 + north / METERS_PER_DEGREE,
+		.longitude = LNG0 + east / LNG_SCALE,
+		.accuracy = accuracy,
+	};
+
+	return pvt;
+}
+
+static double east_of(const struct gps_pvt *pvt)
+{
+	return (pvt->longitude - LNG0) * LNG_SCALE;
+}
+
+static double north_of(const struct gps_pvt *pvt)
+{
+	return (pvt->latitude - LAT0) * METERS_PER_DEGREE;
+}
+
+/** Feed fixes around the origin, one a second, 5 m off in alternating
+ *  directions. Returns the time of the last fix.
+ */
+static s64_t stationary_feed(int cnt)
+{
+	s64_t ts = 0;
+
+	for (int i = 0; i < cnt; i++) {
+		struct gps_pvt pvt = fix((i % 2) ? 5.0 : -5.0, 0.0, 10.0f);
+
+		ts = i * MSEC_PER_SEC;
+		zassert_equal(gps_filter_update(&pvt, ts), 0,
+			      "Stationary fix %d rejected", i);
+	}
+
+	return ts;
+}
+
+static void test_first_fix_unchanged(void)
+{
+	struct gps_pvt pvt = fix(30.0, -20.0, 8.0f);
+	struct gps_pvt in = pvt;
+
+	gps_filter_reset();
+
+	zassert_equal(gps_filter_update(&pvt, 1000), 0, "First fix rejected");
+	zassert_equal(pvt.latitude, in.latitude, "Latitude changed");
+	zassert_equal(pvt.longitude, in.longitude, "Longitude changed");
+}
+
+static void test_noise_smoothed(void)
+{
+	struct gps_pvt pvt;
+	s64_t ts;
+
+	gps_filter_reset();
+	ts = stationary_feed(20);
+
+	pvt = fix(5.0, 0.0, 10.0f);
+	zassert_equal(gps_filter_update(&pvt, ts + MSEC_PER_SEC), 0,
+		      "Fix rejected");
+	/* The fix is 5 m off, the filtered position is pulled back. */
+	zassert_within(east_of(&pvt), 0.0, 4.0, "East %d cm not smoothed",
+		       (int)(east_of(&pvt) * 100));
+	zassert_within(north_of(&pvt), 0.0, 0.5, "North %d cm off",
+		       (int)(north_of(&pvt) * 100));
+}
+
+static void test_constant_velocity_followed(void)
+{
+	struct gps_pvt pvt;
+
+	gps_filter_reset();
+
+	/* 10 m/s east, the filter has to pick up the velocity. */
+	for (int i = 0; i < 30; i++) {
+		pvt = fix(10.0 * i, 0.0, 5.0f);
+		zassert_equal(gps_filter_update(&pvt, i * MSEC_PER_SEC), 0,
+			      "Fix %d rejected", i);
+	}
+
+	zassert_within(east_of(&pvt), 290.0, 2.0, "East %d m",
+		       (int)east_of(&pvt));
+	zassert_within(north_of(&pvt), 0.0, 0.5, "North %d cm off",
+		       (int)(north_of(&pvt) * 100));
+}
+
+static void test_outlier_rejected(void)
+{
+	struct gps_pvt pvt;
+	s64_t ts;
+
+	gps_filter_reset();
+	ts = stationary_feed(10);
+
+	pvt = fix(1000.0, 0.0, 5.0f);
+	zassert_equal(gps_filter_update(&pvt, ts + MSEC_PER_SEC), -EAGAIN,
+		      "Jump accepted");
+
+	/* The track continues where it was. */
+	pvt = fix(0.0, 0.0, 10.0f);
+	zassert_equal(gps_filter_update(&pvt, ts + 2 * MSEC_PER_SEC), 0,
+		      "Fix after the outlier rejected");
+	zassert_within(east_of(&pvt), 0.0, 5.0, "East %d m",
+		       (int)east_of(&pvt));
+}
+
+static void test_restart_after_rejects(void)
+{
+	struct gps_pvt pvt;
+	struct gps_pvt in;
+	s64_t ts;
+
+	gps_filter_reset();
+	ts = stationary_feed(10);
+
+	for (int i = 1; i < CONFIG_GPS_FILTER_MAX_REJECTS; i++) {
+		pvt = fix(1000.0, 0.0, 5.0f);
+		zassert_equal(gps_filter_update(&pvt, ts + i * MSEC_PER_SEC),
+			      -EAGAIN, "Jump %d accepted", i);
+	}
+
+	/* The device did move, the filter starts over from the last fix. */
+	in = pvt = fix(1000.0, 0.0, 5.0f);
+	zassert_equal(gps_filter_update(&pvt,
+					ts + CONFIG_GPS_FILTER_MAX_REJECTS *
+						     MSEC_PER_SEC),
+		      0, "Filter not restarted");
+	zassert_equal(pvt.latitude, in.latitude, "Latitude changed");
+	zassert_equal(pvt.longitude, in.longitude, "Longitude changed");
+}
+
+static void test_reset_forgets_track(void)
+{
+	struct gps_pvt pvt;
+	struct gps_pvt in;
+	s64_t ts;
+
+	gps_filter_reset();
+	ts = stationary_feed(10);
+	gps_filter_reset();
+
+	in = pvt = fix(5000.0, 5000.0, 5.0f);
+	zassert_equal(gps_filter_update(&pvt, ts + MSEC_PER_SEC), 0,
+		      "Fix after reset rejected");
+	zassert_equal(pvt.latitude, in.latitude, "Latitude changed");
+	zassert_equal(pvt.longitude, in.longitude, "Longitude changed");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(gps_filter,
+			 ztest_unit_test(test_first_fix_unchanged),
+			 ztest_unit_test(test_noise_smoothed),
+			 ztest_unit_test(test_constant_velocity_followed),
+			 ztest_unit_test(test_outlier_rejected),
+			 ztest_unit_test(test_restart_after_rejects),
+			 ztest_unit_test(test_reset_forgets_track));
+
+	ztest_run_test_suite(gps_filter);
+}
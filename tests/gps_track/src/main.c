@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <math.h>
+#include <cloud_codec.h>
+
+#include "gps_track.h"
+
+#define LAT0 63.42
+#define LNG0 10.40
+#define METERS_PER_DEGREE 111320.0
+#define DEG_TO_RAD (3.14159265358979 / 180.0)
+#define LNG_SCALE (METERS_PER_DEGREE * cos(LAT0 * DEG_TO_RAD))
+#define TS0 1600000000000LL
+#define TOLERANCE_M 10
+
+static struct cloud_data_gps buf[CONFIG_GPS_BUFFER_MAX];
+
+/** Queue an unnumbered entry at a position given in meters east and north
+ *  of LAT0, LNG0, taken sec seconds after TS0.
+ */
+static void entry_set(int i, double east, double north, int sec)
+{
+	buf[i] = (struct cloud_data_gps){
+		.gps_ts = TS0 + sec * MSEC_PER_SEC,
+		.lat = LAT0 + north / METERS_PER_DEGREE,
+		.longi = LNG0 + east / LNG_SCALE,
+		.acc = 5.0f,
+		.seq = CLOUD_DATA_SEQ_NONE,
+		.queued = true,
+	};
+}
+
+static int queued_count(void)
+{
+	int cnt = 0;
+
+	for (int i = 0; i < ARRAY_SIZE(buf); i++) {
+		cnt += buf[i].queued ? 1 : 0;
+	}
+
+	return cnt;
+}
+
+static void setup(void)
+{
+	memset(buf, 0, sizeof(buf));
+}
+
+static void test_tolerance_zero_keeps_all(void)
+{
+	setup();
+
+	for (int i = 0; i < 5; i++) {
+		entry_set(i, 0.0, 0.0, i * 60);
+	}
+
+	zassert_equal(gps_track_simplify(buf, ARRAY_SIZE(buf), 0), 0,
+		      "Entries dropped");
+	zassert_equal(queued_count(), 5, "Entries dequeued");
+	zassert_equal(buf[0].dur, 0, "Duration set");
+}
+
+static void test_stay_merged(void)
+{
+	setup();
+
+	/* Five minutes at one spot, within the tolerance, then a move. */
+	for (int i = 0; i < 5; i++) {
+		entry_set(i, (i % 2) ? 3.0 : 0.0, 0.0, i * 60);
+	}
+	entry_set(5, 500.0, 0.0, 360);
+
+	zassert_equal(gps_track_simplify(buf, ARRAY_SIZE(buf), TOLERANCE_M),
+		      4, "Stay not merged");
+	zassert_true(buf[0].queued, "First entry of the stay dequeued");
+	zassert_equal(buf[0].dur, 240, "Duration %d", buf[0].dur);
+	zassert_true(buf[5].queued, "Entry after the stay dequeued");
+
+	for (int i = 1; i < 5; i++) {
+		zassert_false(buf[i].queued, "Entry %d of the stay queued", i);
+	}
+}
+
+static void test_straight_line_reduced(void)
+{
+	setup();
+
+	/* Along a line, with less sideways error than the tolerance. */
+	for (int i = 0; i < 10; i++) {
+		entry_set(i, i * 100.0, (i % 2) ? 4.0 : -4.0, i * 10);
+	}
+
+	zassert_equal(gps_track_simplify(buf, ARRAY_SIZE(buf), TOLERANCE_M),
+		      8, "Line not reduced");
+	zassert_true(buf[0].queued, "Start dequeued");
+	zassert_true(buf[9].queued, "End dequeued");
+}
+
+static void test_corner_kept(void)
+{
+	setup();
+
+	/* East, then north. */
+	for (int i = 0; i < 5; i++) {
+		entry_set(i, i * 100.0, 0.0, i * 10);
+		entry_set(5 + i, 400.0, (i + 1) * 100.0, 50 + i * 10);
+	}
+
+	zassert_equal(gps_track_simplify(buf, ARRAY_SIZE(buf), TOLERANCE_M),
+		      7, "Track not reduced to the corner");
+	zassert_true(buf[0].queued, "Start dequeued");
+	zassert_true(buf[4].queued, "Corner dequeued");
+	zassert_true(buf[9].queued, "End dequeued");
+}
+
+static void test_buffer_order_ignored(void)
+{
+	setup();
+
+	/* A wrapped circular buffer, the oldest entry is in the middle. */
+	for (int i = 0; i < 6; i++) {
+		entry_set((i + 3) % 6, i * 100.0, 0.0, i * 10);
+	}
+
+	zassert_equal(gps_track_simplify(buf, ARRAY_SIZE(buf), TOLERANCE_M),
+		      4, "Line not reduced");
+	zassert_true(buf[3].queued, "Oldest entry dequeued");
+	zassert_true(buf[2].queued, "Newest entry dequeued");
+}
+
+static void test_numbered_entries_kept(void)
+{
+	setup();
+
+	for (int i = 0; i < 6; i++) {
+		entry_set(i, i * 100.0, 0.0, i * 10);
+	}
+
+	/* Published before, in the middle of the line. */
+	buf[2].seq = 7;
+	buf[3].seq = 8;
+
+	zassert_equal(gps_track_simplify(buf, ARRAY_SIZE(buf), TOLERANCE_M),
+		      2, "Wrong number of entries dropped");
+	zassert_true(buf[2].queued, "Numbered entry dequeued");
+	zassert_true(buf[3].queued, "Numbered entry dequeued");
+	zassert_false(buf[1].queued, "Entry on the line queued");
+	zassert_false(buf[4].queued, "Entry on the line queued");
+}
+
+static void test_dequeued_entries_ignored(void)
+{
+	setup();
+
+	for (int i = 0; i < 3; i++) {
+		entry_set(i, i * 100.0, 0.0, i * 10);
+	}
+
+	/* Off the line, but already sent. */
+	entry_set(3, 100.0, 300.0, 15);
+	buf[3].queued = false;
+
+	zassert_equal(gps_track_simplify(buf, ARRAY_SIZE(buf), TOLERANCE_M),
+		      1, "Line not reduced");
+	zassert_false(buf[1].queued, "Middle entry queued");
+	zassert_false(buf[3].queued, "Dequeued entry queued again");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(gps_track,
+			 ztest_unit_test(test_tolerance_zero_keeps_all),
+			 ztest_unit_test(test_stay_merged),
+			 ztest_unit_test(test_straight_line_reduced),
+			 ztest_unit_test(test_corner_kept),
+			 ztest_unit_test(test_buffer_order_ignored),
+			 ztest_unit_test(test_numbered_entries_kept),
+			 ztest_unit_test(test_dequeued_entries_ignored));
+
+	ztest_run_test_suite(gps_track);
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <string.h>
+
+#include "number_format.h"
+
+static char buf[NUMBER_FORMAT_LEN_MAX];
+
+static void fixed_check(s64_t scaled, int decimals, const char *expected)
+{
+	int len = number_format_fixed(buf, sizeof(buf), scaled, decimals);
+
+	zassert_equal(len, strlen(expected), "Length %d for %s", len,
+		      expected);
+	zassert_equal(strcmp(buf, expected), 0, "%s instead of %s", buf,
+		      expected);
+}
+
+static void test_int(void)
+{
+	const struct {
+		s64_t value;
+		const char *str;
+	} cases[] = {
+		{ 0, "0" },
+		{ 7, "7" },
+		{ -42, "-42" },
+		{ 4294967295LL, "4294967295" },
+		{ 1600000000123LL, "1600000000123" },
+		{ INT64_MAX, "9223372036854775807" },
+		{ INT64_MIN, "-9223372036854775808" },
+	};
+
+	for (int i = 0; i < ARRAY_SIZE(cases); i++) {
+		int len = number_format_int(buf, sizeof(buf), cases[i].value);
+
+		zassert_equal(len, strlen(cases[i].str), "Length %d for %s",
+			      len, cases[i].str);
+		zassert_equal(strcmp(buf, cases[i].str), 0,
+			      "%s instead of %s", buf, cases[i].str);
+	}
+}
+
+static void test_fixed(void)
+{
+	fixed_check(63421600, 6, "63.4216");
+	fixed_check(104123456, 7, "10.4123456");
+	fixed_check(-1234, 2, "-12.34");
+	fixed_check(5, 3, "0.005");
+	fixed_check(-5, 3, "-0.005");
+	fixed_check(999999999, 9, "0.999999999");
+	fixed_check(42, 0, "42");
+}
+
+static void test_fixed_trailing_zeros(void)
+{
+	fixed_check(1500, 3, "1.5");
+	fixed_check(2000, 3, "2");
+	fixed_check(-100, 2, "-1");
+	fixed_check(0, 6, "0");
+}
+
+static void test_fixed_longest(void)
+{
+	fixed_check(INT64_MIN, NUMBER_FORMAT_DECIMALS_MAX,
+		    "-9223372036.854775808");
+}
+
+static void test_buffer_too_small(void)
+{
+	char small[7];
+
+	/* "-12.34" and its terminator. */
+	zassert_equal(number_format_fixed(small, 6, -1234, 2), -ENOMEM,
+		      "Written without the terminator");
+	zassert_equal(number_format_fixed(small, 7, -1234, 2), 6,
+		      "Not written");
+	zassert_equal(number_format_int(small, 1, 0), -ENOMEM,
+		      "Written without the terminator");
+}
+
+static void test_decimals_out_of_range(void)
+{
+	zassert_equal(number_format_fixed(buf, sizeof(buf), 1, -1), -EINVAL,
+		      "Negative decimals taken");
+	zassert_equal(number_format_fixed(buf, sizeof(buf), 1,
+					  NUMBER_FORMAT_DECIMALS_MAX + 1),
+		      -EINVAL, "Too many decimals taken");
+}
+
+static void test_scale(void)
+{
+	zassert_equal(number_scale(63.4216, 6), 63421600, "Coordinate");
+	zassert_equal(number_scale(10.4, 1), 104, "One decimal");
+	zassert_equal(number_scale(21.0, 0), 21, "No decimals");
+
+	/* Halves are rounded away from zero. */
+	zassert_equal(number_scale(1.25, 1), 13, "Positive half");
+	zassert_equal(number_scale(-1.25, 1), -13, "Negative half");
+	zassert_equal(number_scale(-0.4, 0), 0, "Small negative");
+
+	/* Decimals are clamped. */
+	zassert_equal(number_scale(2.5, -1), 3, "Negative decimals");
+	zassert_equal(number_scale(1.0, NUMBER_FORMAT_DECIMALS_MAX + 3),
+		      1000000000, "Too many decimals");
+}
+
+void test_main(void)
+{
+	ztest_test_suite(number_format,
+			 ztest_unit_test(test_int),
+			 ztest_unit_test(test_fixed),
+			 ztest_unit_test(test_fixed_trailing_zeros),
+			 ztest_unit_test(test_fixed_longest),
+			 ztest_unit_test(test_buffer_too_small),
+			 ztest_unit_test(test_decimals_out_of_range),
+			 ztest_unit_test(test_scale));
+
+	ztest_run_test_suite(number_format);
+}
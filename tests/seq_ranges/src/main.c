@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2020 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-BSD-5-Clause-Nordic
+ */
+
+#include <ztest.h>
+#include <cloud_codec.h>
+
+#include "seq_ranges.h"
+
+static struct cloud_data_battery buf[10];
+static struct cloud_data_ack ack;
+
+/** Entries 0 to 9 numbered 100 to 109, all published and waiting for an
+ *  acknowledgment.
+ */
+static void setup(void)
+{
+	memset(&ack, 0, sizeof(ack));
+
+	for (int i = 0; i < ARRAY_SIZE(buf); i++) {
+		buf[i] = (struct cloud_data_battery){
+			.seq = 100 + i,
+			.unacked = true,
+		};
+	}
+}
+
+static void range_add(bool nack, enum cloud_data_stream stream, u32_t first,
+		      u32_t last)
+{
+	struct cloud_data_seq_range range = { .first = first, .last = last };
+
+	if (nack) {
+		ack.nack[stream][ack.nack_cnt[stream]++] = range;
+	} else {
+		ack.ack[stream][ack.ack_cnt[stream]++] = range;
+	}
+}
+
+static void test_acked_forgotten(void)
+{
+	setup();
+	range_add(false, CLOUD_DATA_STREAM_BAT, 100, 104);
+	range_add(false, CLOUD_DATA_STREAM_BAT, 107, 107);
+
+	zassert_equal(SEQ_RANGES_APPLY(buf, &ack, CLOUD_DATA_STREAM_BAT), 0,
+		      "Acknowledged entries queued");
+
+	for (int i = 0; i < ARRAY_SIZE(buf); i++) {
+		bool acked = (i <= 4 || i == 7);
+
+		zassert_equal(buf[i].unacked, !acked, "Entry %d", i);
+		zassert_false(buf[i].queued, "Entry %d queued", i);
+	}
+}
+
+static void test_missing_queued(void)
+{
+	setup();
+	range_add(false, CLOUD_DATA_STREAM_BAT, 100, 109);
+	range_add(true, CLOUD_DATA_STREAM_BAT, 102, 103);
+	range_add(true, CLOUD_DATA_STREAM_BAT, 108, 108);
+
+	/* Missing wins over acknowledged. */
+	zassert_equal(SEQ_RANGES_APPLY(buf, &ack, CLOUD_DATA_STREAM_BAT), 3,
+		      "Wrong number of entries queued");
+
+	for (int i = 0; i < ARRAY_SIZE(buf); i++) {
+		bool missing = (i == 2 || i == 3 || i == 8);
+
+		zassert_false(buf[i].unacked, "Entry %d unacked", i);
+		zassert_equal(buf[i].queued, missing, "Entry %d", i);
+	}
+}
+
+static void test_missing_no_longer_buffered(void)
+{
+	setup();
+
+	/* Overwritten in the circular buffer, only 100 and 101 are left. */
+	range_add(true, CLOUD_DATA_STREAM_BAT, 90, 101);
+
+	zassert_equal(SEQ_RANGES_APPLY(buf, &ack, CLOUD_DATA_STREAM_BAT), 2,
+		      "Wrong number of entries queued");
+	zassert_true(buf[0].queued, "Entry 0 not queued");
+	zassert_true(buf[1].queued, "Entry 1 not queued");
+	zassert_false(buf[2].queued, "Entry 2 queued");
+}
+
+static void test_all_missing(void)
+{
+	setup();
+	range_add(true, CLOUD_DATA_STREAM_BAT, 0, UINT32_MAX);
+
+	zassert_equal(SEQ_RANGES_APPLY(buf, &ack, CLOUD_DATA_STREAM_BAT), 10,
+		      "Wrong number of entries queued");
+}
+
+static void test_only_unacked_entries(void)
+{
+	setup();
+	buf[3].unacked = false;
+	buf[5].unacked = false;
+	range_add(true, CLOUD_DATA_STREAM_BAT, 100, 109);
+
+	/* Entries sent again or never published are left alone. */
+	zassert_equal(SEQ_RANGES_APPLY(buf, &ack, CLOUD_DATA_STREAM_BAT), 8,
+		      "Wrong number of entries queued");
+	zassert_false(buf[3].queued, "Entry 3 queued");
+	zassert_false(buf[5].queued, "Entry 5 queued");
+}
+
+static void test_other_stream_ignored(void)
+{
+	setup();
+	range_add(false, CLOUD_DATA_STREAM_GPS, 100, 104);
+	range_add(true, CLOUD_DATA_STREAM_GPS, 105, 109);
+
+	zassert_equal(SEQ_RANGES_APPLY(buf, &ack, CLOUD_DATA_STREAM_BAT), 0,
+		      "Entries queued");
+
+	for (int i = 0; i < ARRAY_SIZE(buf); i++) {
+		zassert_true(buf[i].unacked, "Entry %d acknowledged", i);
+		zassert_false(buf[i].queued, "Entry %d queued", i);
+	}
+}
+
+void test_main(void)
+{
+	ztest_test_suite(seq_ranges,
+			 ztest_unit_test(test_acked_forgotten),
+			 ztest_unit_test(test_missing_queued),
+			 ztest_unit_test(test_missing_no_longer_buffered),
+			 ztest_unit_test(test_all_missing),
+			 ztest_unit_test(test_only_unacked_entries),
+			 ztest_unit_test(test_other_stream_ignored));
+
+	ztest_run_test_suite(seq_ranges);
+}